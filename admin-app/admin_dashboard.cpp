@@ -91,21 +91,14 @@ void AdminDashboard::on_btnRefresh_clicked()
     ui->txtSearchOrigin->clear();
     ui->txtSearchDestination->clear();
 
-    // 马上查航班
-    NetworkManager::instance().sendGetAllFlightsRequest();
-
-    // 2. 延迟查用户
-    QTimer::singleShot(200, [this]()
-    {
-       NetworkManager::instance().sendAdminGetAllUsersRequest();
-    });
-
-    // 3. 延迟查订单
-    QTimer::singleShot(400, [this]()
-    {
-       NetworkManager::instance().sendAdminGetAllBookingsRequest();
-    });
+    // 航班列表回到第一页
+    m_flightSearchActive = false;
+    m_pageCursors = QStringList{QString()};
 
+    // 三个请求同时发出：每个请求都带request_id，响应按id分发，不再需要错开发送
+    requestFlightPage(1);
+    NetworkManager::instance().sendAdminGetAllUsersRequest();
+    NetworkManager::instance().sendAdminGetAllBookingsRequest();
 }
 
 // 点击“删除”按钮
@@ -209,54 +202,70 @@ void AdminDashboard::on_btnEditFlight_clicked()
     }
 }
 
-// 航班数据更新槽函数（接收服务器数据并填表）
-void AdminDashboard::updateFlightTable(const QJsonArray &flights)
+// 辅助函数：按当前查询条件请求第page页（page从1开始）
+void AdminDashboard::requestFlightPage(int page)
 {
-    // 1. 存储所有过滤后的数据
-    m_allFilteredFlights = flights;
+    if (page < 1 || page > m_pageCursors.size())
+        return;
 
-    // 2. 计算分页状态
-    int totalItems = m_allFilteredFlights.size();
-    m_totalPages = qCeil((double)totalItems / m_pageSize);
+    m_requestedPage = page;
+    const QString cursor = m_pageCursors.at(page - 1);
 
-    // 确保当前页码有效
-    m_currentPage = 1;
-    if (m_totalPages == 0) m_currentPage = 0;
+    // 等待响应期间禁用翻页按钮，避免重复请求
+    ui->btnPrevPage->setEnabled(false);
+    ui->btnNextPage->setEnabled(false);
+
+    if (m_flightSearchActive)
+        NetworkManager::instance().sendSearchFlightsRequest(m_searchOrigin, m_searchDestination, m_searchDate, m_pageSize, cursor);
+    else
+        NetworkManager::instance().sendGetAllFlightsRequest(m_pageSize, cursor);
+}
+
+// 航班数据更新槽函数（接收服务器返回的一页数据并填表）
+void AdminDashboard::updateFlightTable(const QJsonArray &flights, const QString &nextCursor)
+{
+    // 1. 存储当前页数据
+    m_pageFlights = flights;
+    m_currentPage = qMax(1, m_requestedPage);
+    m_nextCursor = nextCursor;
+
+    // 2. 记录下一页的cursor（翻回来时可以直接复用）
+    m_pageCursors = m_pageCursors.mid(0, m_currentPage);
+    if (!m_nextCursor.isEmpty())
+        m_pageCursors.append(m_nextCursor);
 
     // 3. 显示当前页
     displayCurrentPageFlights();
 }
 
-// 辅助函数：根据 m_currentPage 和 m_pageSize 填充表格
+// 辅助函数：把当前页航班填入表格
 void AdminDashboard::displayCurrentPageFlights()
 {
     ui->flightTable->setRowCount(0);  // 清空旧数据
 
-    if (m_allFilteredFlights.isEmpty())
+    if (m_pageFlights.isEmpty() && m_currentPage <= 1)
     {
         // 更新分页信息
-        ui->lblPageInfo->setText("Page 0/0 (0 条结果)");
+        ui->lblPageInfo->setText("Page 0 (0 条结果)");
         ui->btnPrevPage->setEnabled(false);
         ui->btnNextPage->setEnabled(false);
         return;
     }
 
-    // 计算起始索引和结束索引
-    int totalItems = m_allFilteredFlights.size();
-    int startIndex = (m_currentPage - 1) * m_pageSize;
-    int endIndex = qMin(startIndex + m_pageSize, totalItems);
-
-    // 更新分页信息
-    ui->lblPageInfo->setText(QString("Page %1/%2 (%3 条结果)").arg(m_currentPage).arg(m_totalPages).arg(totalItems));
+    // 更新分页信息（服务器按cursor分页，不统计总数）
+    ui->lblPageInfo->setText(QString("Page %1 (本页 %2 条%3)")
+                                 .arg(m_currentPage)
+                                 .arg(m_pageFlights.size())
+                                 .arg(m_nextCursor.isEmpty() ? "，已是最后一页" : ""));
 
     // 启用/禁用分页按钮
     ui->btnPrevPage->setEnabled(m_currentPage > 1);
-    ui->btnNextPage->setEnabled(m_currentPage < m_totalPages);
+    ui->btnNextPage->setEnabled(!m_nextCursor.isEmpty());
 
     // 遍历当前页的 JSON 数据并填充表格
-    for (int i = startIndex; i < endIndex; ++i)
+    for (const QJsonValue &value : std::as_const(m_pageFlights))
     {
-        QJsonObject obj = m_allFilteredFlights.at(i).toObject();
+        QJsonObject obj = value.toObject();
         int row = ui->flightTable->rowCount();
         ui->flightTable->insertRow(row);
 
@@ -313,27 +322,30 @@ void AdminDashboard::on_btnSearchFlight_clicked()
     QString destination = ui->txtSearchDestination->text();
     QString date = ui->dtSearchDate->date().toString("yyyy-MM-dd"); // 格式化日期
 
-    // 2. 调用 NetworkManager 发送请求
-    NetworkManager::instance().sendSearchFlightsRequest(origin, destination, date);
+    // 2. 记录搜索条件，从第一页开始向服务器请求
+    m_flightSearchActive = true;
+    m_searchOrigin = origin;
+    m_searchDestination = destination;
+    m_searchDate = date;
+    m_pageCursors = QStringList{QString()};
+    requestFlightPage(1);
 }
 
-// 上一页
+// 上一页：用记录下来的cursor重新向服务器请求
 void AdminDashboard::on_btnPrevPage_clicked()
 {
     if (m_currentPage > 1)
     {
-        m_currentPage--;
-        displayCurrentPageFlights();
+        requestFlightPage(m_currentPage - 1);
     }
 }
 
 // 下一页
 void AdminDashboard::on_btnNextPage_clicked()
 {
-    if (m_currentPage < m_totalPages)
+    if (!m_nextCursor.isEmpty())
     {
-        m_currentPage++;
-        displayCurrentPageFlights();
+        requestFlightPage(m_currentPage + 1);
     }
 }
 
@@ -4,6 +4,7 @@
 #include <QMainWindow>
 #include <QJsonArray>
 #include <QJsonObject>
+#include <QStringList>
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class AdminDashboard; }
@@ -28,7 +29,7 @@ private slots:
     void on_btnNextPage_clicked();   // 下一页
 
     // NetworkManager信号接收槽
-    void updateFlightTable(const QJsonArray &flights);  // 填航班表
+    void updateFlightTable(const QJsonArray &flights, const QString &nextCursor);  // 填航班表（一页）
     void updateUserTable(const QJsonArray &users);  // 填用户表
     void updateBookingTable(const QJsonArray &bookings);  // 填订单表
 
@@ -43,11 +44,19 @@ private slots:
 private:
     Ui::AdminDashboard *ui;
 
-    // 航班分页状态变量
-    QJsonArray m_allFilteredFlights; // 存储服务器返回的所有（最多1000条）过滤后的航班数据
-    int m_currentPage = 1;          // 当前页码
+    // 航班分页状态变量（服务器端keyset分页，每次只向服务器要一页）
+    QJsonArray m_pageFlights;       // 当前页的航班数据
+    QStringList m_pageCursors;      // 每一页对应的请求cursor（下标0为第一页，cursor为空），用于翻回上一页
+    QString m_nextCursor;           // 服务器返回的下一页cursor，为空表示已经是最后一页
+    int m_currentPage = 0;          // 当前页码（从1开始，0表示还没有数据）
+    int m_requestedPage = 0;        // 正在请求的页码
     const int m_pageSize = 50;      // 每页显示的行数
-    int m_totalPages = 0;           // 总页数
+
+    // 当前航班列表的查询条件：全部航班，或按出发地/目的地/日期搜索
+    bool m_flightSearchActive = false;
+    QString m_searchOrigin;
+    QString m_searchDestination;
+    QString m_searchDate;
 
     // 订单管理页面的目标查询用户ID (用户点击查询按钮后设置)
     int m_targetSearchUserId = -1;
@@ -55,7 +64,10 @@ private:
     // 辅助函数：初始化表格表头
     void setupTables();
 
-    // 辅助函数：根据 m_currentPage 和 m_pageSize 填充表格
+    // 辅助函数：按当前查询条件向服务器请求第page页航班
+    void requestFlightPage(int page);
+
+    // 辅助函数：把当前页航班填入表格
     void displayCurrentPageFlights();
 
     // 样式美化函数
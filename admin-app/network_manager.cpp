@@ -1,6 +1,7 @@
 #include "network_manager.h"
 #include <QDebug>
 #include <QRandomGenerator>
+#include <climits>
 
 // 构造函数
 NetworkManager::NetworkManager(QObject *parent) : QObject(parent)
@@ -54,6 +55,13 @@ void NetworkManager::onConnected()
     QString uniqueTag = "admin_" + QString::number(QRandomGenerator::global()->bounded(1000, 9999));
 
     identity["tag"] = uniqueTag;
+    // 告知服务器本客户端的协议版本与支持的编码（按偏好排序）
+    identity["protocol"] = MessageCodec::ProtocolVersion;
+    identity["encodings"] = MessageCodec::supportedEncodings();
+    identity["compressions"] = MessageCodec::supportedCompressions();
+
+    // 注册成功之前一律用json
+    m_encoding = MessageCodec::Encoding::Json;
 
     // 使用新的定长 send 函数发送身份注册包
     send(identity);
@@ -65,6 +73,9 @@ void NetworkManager::onConnected()
 void NetworkManager::onDisconnected()
 {
     qDebug() << "Server disconnected.";
+    // 断开后未完成的请求不会再有响应
+    m_pendingRequests.clear();
+    m_encoding = MessageCodec::Encoding::Json;
 }
 
 // 辅助发送函数：负责打包JSON并写入Socket
@@ -80,19 +91,10 @@ void NetworkManager::send(const QJsonObject& json)
         return;
     }
 
-    // 将 JSON 对象转为 Compact 格式的 QByteArray (Payload)
-    QJsonDocument doc(json);
-    QByteArray payload = doc.toJson(QJsonDocument::Compact);
-
-    // 计算长度并转换为 4 字节大端序 (Big Endian)
-    quint32 len = payload.size();
+    // 拼接 [4字节大端长度] + [按协商的编码（JSON或CBOR）写出的消息]，请求都很小，不压缩
     QByteArray block;
-    block.resize(sizeof(quint32));
-    // 使用 QtEndian 确保字节序与服务器端一致 (服务器是 Big Endian)
-    qToBigEndian(len, reinterpret_cast<uchar*>(block.data()));
-
-    // 拼接 [4字节长度] + [JSON 字节]
-    block.append(payload);
+    MessageCodec::appendFrame(block, json, m_encoding);
+    const qsizetype len = block.size() - FrameDecoder::HeaderSize;
 
     // 发送
     m_socket->write(block);
@@ -101,6 +103,22 @@ void NetworkManager::send(const QJsonObject& json)
     qDebug() << "C2S 发送 (len:" << len << "):" << json;
 }
 
+// 发送业务请求：附带request_id，服务器处理完后原样回显，不再需要靠发送顺序或数据字段猜测响应类型
+void NetworkManager::sendRequest(QJsonObject request, RequestType type)
+{
+    const int requestId = m_nextRequestId;
+    m_nextRequestId = (m_nextRequestId == INT_MAX) ? 1 : m_nextRequestId + 1;
+
+    request["request_id"] = requestId;
+    m_pendingRequests.insert(requestId, type);
+
+    // 兼容旧服务器：记录最近一次列表请求
+    if (type == FlightList || type == UserList || type == BookingList)
+        m_lastRequestType = type;
+
+    send(request);
+}
+
 // 登录请求
 void NetworkManager::sendAdminLoginRequest(const QString& username, const QString& password)
 {
@@ -113,26 +131,32 @@ void NetworkManager::sendAdminLoginRequest(const QString& username, const QStrin
     request["action"] = "login";  // 对应server-app中的handleLogin，表示这是登录操作
     request["data"] = data;
 
-    send(request);
+    sendRequest(request, Login);
 }
 
 // 获取航班
-void NetworkManager::sendGetAllFlightsRequest()
+void NetworkManager::sendGetAllFlightsRequest(int pageSize, const QString& cursor)
 {
-    m_lastRequestType = FlightList;  //记录：上一步的操作是获取航班
+    QJsonObject data;
+    if (pageSize > 0) {
+        data["page_size"] = pageSize;
+    }
+    if (!cursor.isEmpty()) {
+        data["cursor"] = cursor;
+    }
+
     QJsonObject request;
-    // 使用 admin 接口获取所有航班（已在服务端限制1000条）
+    // 使用 admin 接口分页获取所有航班
     request["action"] = "admin_get_all_flights";
-    request["data"] = QJsonObject(); // 这个接口不需要 data 参数
+    request["data"] = data;
 
-    send(request);
+    sendRequest(request, FlightList);
 }
 
 // 航班搜索请求 (调用 handleSearchFlights 接口)
-void NetworkManager::sendSearchFlightsRequest(const QString& origin, const QString& destination, const QString& date)
+void NetworkManager::sendSearchFlightsRequest(const QString& origin, const QString& destination, const QString& date,
+                                              int pageSize, const QString& cursor)
 {
-    m_lastRequestType = FlightList;  //记录：上一步的操作是获取航班
-
     QJsonObject data;
 
     // 仅添加非空字段，让服务器动态构建 SQL
@@ -146,13 +170,18 @@ void NetworkManager::sendSearchFlightsRequest(const QString& origin, const QStri
     if (!date.isEmpty()) {
         data["date"] = date;
     }
-
+    if (pageSize > 0) {
+        data["page_size"] = pageSize;
+    }
+    if (!cursor.isEmpty()) {
+        data["cursor"] = cursor;
+    }
 
     QJsonObject request;
     request["action"] = "search_flights"; // 使用客户端的通用搜索接口
     request["data"] = data;
 
-    send(request);
+    sendRequest(request, FlightList);
 }
 
 // 添加航班(对应handleAdminAddFlight)
@@ -162,7 +191,7 @@ void NetworkManager::sendAdminAddFlightRequest(const QJsonObject& flightData)
     request["action"] = "admin_add_flight";  // 对应server-app中的管理员接口handleAdminAddFlight，表示这是添加航班
     request["data"] = flightData;
 
-    send(request);
+    sendRequest(request, Operation);
 }
 
 // 删除航班(对应handleAdminDeleteFlight)
@@ -175,7 +204,7 @@ void NetworkManager::sendAdminDeleteFlightRequest(int flightId)
     request["action"] = "admin_delete_flight";  // 对应server-app中的管理员接口handleAdminDeleteFlight，表示这是删除航班
     request["data"] = data;
 
-    send(request);
+    sendRequest(request, Operation);
 }
 
 // 修改航班(对应handleAdminUpdateFlight)
@@ -189,29 +218,27 @@ void NetworkManager::sendAdminUpdateFlightRequest(int flightId, const QJsonObjec
     request["action"] = "admin_update_flight";  // 对应server-app中的管理员接口handleAdminUpdateFlight，表示这是修改航班
     request["data"] = data;
 
-    send(request);
+    sendRequest(request, Operation);
 }
 
 // 获取所有用户(对应handleAdminGetAllUsers)
 void NetworkManager::sendAdminGetAllUsersRequest()
 {
-    m_lastRequestType = UserList; //记录：上一步的操作是获取所有用户
     QJsonObject request;
     request["action"] = "admin_get_all_users";  // 对应server-app中的管理员接口handleAdminGetAllUsers，表示这是获取所有用户
     request["data"] = QJsonObject(); // 空数据
 
-    send(request);
+    sendRequest(request, UserList);
 }
 
 // 获取所有订单(对应handleAdminGetAllBookings)
 void NetworkManager::sendAdminGetAllBookingsRequest()
 {
-    m_lastRequestType = BookingList;  // 记录：上一步的操作是获取所有订单
     QJsonObject request;
     request["action"] = "admin_get_all_bookings";  // 对应server-app中的管理员接口handleAdminGetAllBookings，表示这是获取所有订单
     request["data"] = QJsonObject();
 
-    send(request);
+    sendRequest(request, BookingList);
 }
 
 // 取消指定订单（退票）
@@ -224,7 +251,7 @@ void NetworkManager::sendAdminCancelOrderRequest(int bookingId)
     request["action"] = "cancel_order"; // 复用客户端的取消订单接口
     request["data"] = data;
 
-    send(request);
+    sendRequest(request, Operation);
 }
 
 // 拆分出的 JSON 处理逻辑
@@ -237,6 +264,31 @@ void NetworkManager::processJsonResponse(const QJsonObject& response)
     // 打印接收到的信息 (在这里打印，而不是在 onReadyRead)
     qDebug() << "S2C 收到完整 JSON:" << response;
 
+    // tag注册成功的响应：记录服务器选定的编码（旧服务器不返回encoding，继续使用json）
+    if (status == "success" && message == "Tag registered")
+    {
+        if (!MessageCodec::fromName(response["encoding"].toString(), m_encoding))
+            m_encoding = MessageCodec::Encoding::Json;
+        qDebug() << "Tag registered, encoding:" << MessageCodec::name(m_encoding);
+        return;
+    }
+
+    // 新版服务器会回显request_id：直接找到对应的请求类型，响应可以乱序到达
+    const QJsonValue idValue = response.value("request_id");
+    if (!idValue.isUndefined())
+    {
+        auto it = m_pendingRequests.find(idValue.toInt());
+        if (it != m_pendingRequests.end())
+        {
+            RequestType type = it.value();
+            m_pendingRequests.erase(it);
+            dispatchTypedResponse(type, response);
+            return;
+        }
+    }
+
+    // 以下为兼容旧服务器的逻辑：根据上一次请求类型和数据字段猜测响应类型
+
     // 错误处理
     if (status == "error")
     {
@@ -283,7 +335,7 @@ void NetworkManager::processJsonResponse(const QJsonObject& response)
         // 航班列表特征: 有 "flight_number"
         if (m_lastRequestType == FlightList || firstItem.contains("flight_number"))
         {
-            emit allFlightsReceived(arr);
+            emit allFlightsReceived(arr, QString());
             m_lastRequestType = None; // 立即重置
             return;
         }
@@ -306,7 +358,7 @@ void NetworkManager::processJsonResponse(const QJsonObject& response)
         // 收到空数组，依赖 m_lastRequestType
         if (m_lastRequestType == FlightList)
         {
-            emit allFlightsReceived(arr);
+            emit allFlightsReceived(arr, QString());
         }
         else if (m_lastRequestType == UserList)
         {
@@ -329,57 +381,90 @@ void NetworkManager::processJsonResponse(const QJsonObject& response)
     }
 }
 
+// 服务器因限流或过载拒绝请求时会带上retry_after_ms，把建议的等待时间拼到提示信息里
+static QString withRetryHint(const QString& message, const QJsonObject& response)
+{
+    const qint64 retryAfterMs = response["retry_after_ms"].toInteger();
+    if (retryAfterMs <= 0)
+        return message;
+    const qint64 seconds = qMax<qint64>(1, (retryAfterMs + 999) / 1000);
+    return message + QString("（请在 %1 秒后重试）").arg(seconds);
+}
+
+// 已知请求类型时的响应分发
+void NetworkManager::dispatchTypedResponse(RequestType type, const QJsonObject& response)
+{
+    QString status = response["status"].toString();
+    QString message = response["message"].toString();
+    QJsonValue rawData = response["data"];
+
+    if (status == "error")
+    {
+        message = withRetryHint(message, response);
+        if (type == Login)
+            emit loginResult(false, false, message);
+        else
+            emit adminOperationFailed(message);
+        return;
+    }
+
+    switch (type)
+    {
+    case Login:
+        emit loginResult(true, rawData.toObject()["is_admin"].toInt() == 1, message);
+        break;
+    case FlightList:
+        emit allFlightsReceived(rawData.toArray(), response["next_cursor"].toString());
+        break;
+    case UserList:
+        emit allUsersReceived(rawData.toArray());
+        break;
+    case BookingList:
+        emit allBookingsReceived(rawData.toArray());
+        break;
+    case Operation:
+        emit adminOperationSuccess(message);
+        break;
+    case None:
+        break;
+    }
+}
+
 // 信息接收逻辑 - 必须实现定长包处理
 void NetworkManager::onReadyRead()
 {
-    // 1. 读取所有缓冲区数据并追加到 m_readBuffer
-    m_readBuffer.append(m_socket->readAll());
+    // 1. 读取所有缓冲区数据并追加到解码器（解码器只移动读游标，不会每帧搬移整个缓冲区）
+    m_decoder.append(m_socket->readAll());
 
     // 2. 循环解析缓冲区中的所有完整消息
+    QByteArray message;
+    bool compressed = false;
     while (true)
     {
-        // A. 尝试读取长度前缀 (4字节)
-        if (m_expectedLen == 0)
-        {
-            // 如果缓冲区中数据不够 4 字节，等待更多数据
-            if (m_readBuffer.size() < static_cast<int>(sizeof(quint32)))
-                break;
-
-            // 读取 4 字节长度，并转换为本地字节序（服务器端是 Big Endian）
-            quint32 len = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(m_readBuffer.constData()));
+        // A. 取出一帧 (4字节大端长度 + 消息体，长度最高位为压缩标志)
+        FrameDecoder::Status status = m_decoder.next(message, &compressed);
 
-            // 设置期望长度
-            m_expectedLen = len;
-
-            // 从缓冲区移除已读取的 4 字节长度前缀
-            m_readBuffer.remove(0, sizeof(quint32));
-        }
+        // 数据不够一帧，等待更多数据
+        if (status == FrameDecoder::Status::NeedMore)
+            break;
 
-        // B. 检查消息体是否完整
-        if (m_readBuffer.size() < static_cast<int>(m_expectedLen))
+        // 长度前缀异常，之后的数据已经无法对齐，直接丢弃
+        if (status == FrameDecoder::Status::Oversized)
         {
-            // 数据不够一帧，等待更多数据
+            qWarning() << "收到异常的帧长度:" << m_decoder.pendingFrameSize();
+            m_decoder.clear();
             break;
         }
 
-        // C. 取出完整帧 (消息体)
-        QByteArray message = m_readBuffer.left(static_cast<int>(m_expectedLen));
-
-        // D. 从缓冲区移除已处理的帧，并重置期望长度，准备接收下一帧
-        m_readBuffer.remove(0, static_cast<int>(m_expectedLen));
-        m_expectedLen = 0;
-
-        // E. 解析 JSON
-        QJsonDocument doc = QJsonDocument::fromJson(message);
-
-        // 检查是否有解析错误
-        if (doc.isNull() || !doc.isObject())
+        // B. 解码（服务器可能发送JSON或CBOR，按首字节区分；大的响应可能经过压缩）
+        QJsonObject response;
+        if (!MessageCodec::decodeFrame(message, compressed, m_decoder.maxFrameSize(), response))
         {
-            qWarning() << "收到无效的 JSON 格式或数据损坏，消息体：" << message;
+            qWarning() << "收到无效的消息格式或数据损坏，消息体：" << message;
             continue; // 跳过此帧，继续处理下一帧
         }
 
-        // F. 调用 JSON 处理逻辑
-        processJsonResponse(doc.object());
+        // C. 调用 JSON 处理逻辑
+        processJsonResponse(response);
     }
 }
@@ -7,17 +7,22 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QByteArray>
+#include <QHash>
 #include <QtEndian>
+#include "frame_decoder.h"
+#include "message_codec.h"
 
 class NetworkManager : public QObject
 {
     Q_OBJECT
-    // 定义一个枚举，列出所有可能请求列表的操作
+    // 定义一个枚举，列出所有请求的类型（用于把响应分发给对应的信号）
     enum RequestType {
         None,
         FlightList,
         UserList,
-        BookingList
+        BookingList,
+        Login,
+        Operation   // 添加/删除/修改/退票等只关心成功与否的操作
     };
 public:
     // 保证程序里面只有一个networkmanager实例
@@ -35,11 +40,13 @@ public:
     // 登录(对应server-app中的handleLogin)
     void sendAdminLoginRequest(const QString& username, const QString& password);
 
-    // 航班查询(对应server-app中的handleSearchFlights)
-    void sendGetAllFlightsRequest();
+    // 航班查询(对应server-app中的handleAdminGetAllFlights)
+    // pageSize为0时由服务器决定每页行数；cursor为空表示第一页，否则传上一页收到的nextCursor
+    void sendGetAllFlightsRequest(int pageSize = 0, const QString& cursor = QString());
 
-    // 航班搜索（调用 client 端的接口）
-    void sendSearchFlightsRequest(const QString& origin, const QString& destination, const QString& date);
+    // 航班搜索（调用 client 端的接口），分页参数同上
+    void sendSearchFlightsRequest(const QString& origin, const QString& destination, const QString& date,
+                                  int pageSize = 0, const QString& cursor = QString());
 
     // 取消指定订单（退票）
     void sendAdminCancelOrderRequest(int bookingId);
@@ -67,8 +74,8 @@ signals:
     // 登录结果: success判断登录是否成功, isAdmin判断登录的账号是不是管理员, message打印登陆失败的信息
     void loginResult(bool success, bool isAdmin, const QString& message);
 
-    // 收到航班列表(用于刷新航班管理表格)
-    void allFlightsReceived(const QJsonArray& flights);
+    // 收到航班列表(用于刷新航班管理表格)，nextCursor为空表示没有下一页
+    void allFlightsReceived(const QJsonArray& flights, const QString& nextCursor);
 
     // 收到用户列表(用于刷新用户管理表格)
     void allUsersReceived(const QJsonArray& users);
@@ -89,14 +96,25 @@ private:
     const QString SERVER_IP = "43.136.42.69";
     const quint16 SERVER_PORT = 12345; // 对应 Server main.cpp 里的端口
 
-    RequestType m_lastRequestType = None;  // 记录上一次的操作，初始化为None
+    RequestType m_lastRequestType = None;  // 记录上一次的列表操作（仅用于兼容不回显request_id的旧服务器）
 
-    // 客户端接收缓冲区，用于定长消息处理
-    QByteArray m_readBuffer; // [新增]
-    quint32 m_expectedLen = 0; // [新增] 期望接收的下一帧长度
+    // 以request_id为键记录每个已发出请求的类型，服务器会在响应里回显request_id
+    QHash<int, RequestType> m_pendingRequests;
+    int m_nextRequestId = 1;
+
+    // 客户端接收缓冲区，用于定长消息处理（与server-app共用的解码器）
+    FrameDecoder m_decoder{4u * 1024u * 1024u}; // 单帧最大4MB
+
+    // 发送编码：tag注册成功后由服务器告知，之前一律用json
+    MessageCodec::Encoding m_encoding = MessageCodec::Encoding::Json;
 
     // 辅助发送函数 - 现应匹配服务器的定长协议
     void send(const QJsonObject& json);
+    // 发送业务请求：分配request_id并记录请求类型
+    void sendRequest(QJsonObject request, RequestType type);
+
+    // 已知请求类型时，直接把响应分发给对应的信号
+    void dispatchTypedResponse(RequestType type, const QJsonObject& response);
 
     // 辅助处理函数，将 JSON 对象分发给对应的槽
     void processJsonResponse(const QJsonObject& response);
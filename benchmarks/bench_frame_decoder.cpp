@@ -0,0 +1,108 @@
+/*
+拆帧的基准测试：把10000个流水线发送的小帧一次性（或按TCP报文大小分段）交给接收方，
+比较原来onReadyRead里的做法（每取一帧对缓冲区remove两次，剩余数据整体搬移）和FrameDecoder（只移动读游标）。
+原来的做法随积压的帧数平方增长，FrameDecoder是线性的。
+*/
+#include <QtTest>
+#include <QByteArray>
+#include <QtEndian>
+#include "frame_decoder.h"
+
+static constexpr int FrameCount = 10000;
+
+class FrameDecoderBenchmark : public QObject
+{
+    Q_OBJECT
+
+private:
+    QByteArray m_stream;
+
+    // 接收方一次拿到的字节数：0为一次拿到全部数据
+    static void addChunkSizes()
+    {
+        QTest::addColumn<int>("chunkSize");
+        QTest::newRow("all-at-once") << 0;
+        QTest::newRow("1460-byte-segments") << 1460;
+        QTest::newRow("64KiB-reads") << 64 * 1024;
+    }
+
+    QList<QByteArray> chunks(int chunkSize) const
+    {
+        if (chunkSize <= 0)
+            return {m_stream};
+        QList<QByteArray> result;
+        for (qsizetype offset = 0; offset < m_stream.size(); offset += chunkSize)
+            result.append(m_stream.mid(offset, chunkSize));
+        return result;
+    }
+
+private slots:
+    void initTestCase()
+    {
+        // 与search_flights请求大小相当的帧
+        for (int i = 0; i < FrameCount; ++i) {
+            const QByteArray payload = QStringLiteral(
+                R"({"action":"search_flights","request_id":%1,"data":{"origin":"北京","destination":"上海","date":"2025-12-01"}})")
+                .arg(i).toUtf8();
+            uchar header[FrameDecoder::HeaderSize];
+            qToBigEndian(static_cast<quint32>(payload.size()), header);
+            m_stream.append(reinterpret_cast<const char *>(header), FrameDecoder::HeaderSize);
+            m_stream.append(payload);
+        }
+    }
+
+    void legacyRemove_data() { addChunkSizes(); }
+    void legacyRemove()
+    {
+        QFETCH(int, chunkSize);
+        const QList<QByteArray> input = chunks(chunkSize);
+        int frames = 0;
+
+        QBENCHMARK {
+            QByteArray recvBuf;
+            quint32 expectedLen = 0;
+            frames = 0;
+            for (const QByteArray &chunk : input) {
+                recvBuf.append(chunk);
+                while (true) {
+                    if (expectedLen == 0) {
+                        if (recvBuf.size() < static_cast<int>(sizeof(quint32)))
+                            break;
+                        expectedLen = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(recvBuf.constData()));
+                        recvBuf.remove(0, sizeof(quint32));
+                    }
+                    if (recvBuf.size() < static_cast<qsizetype>(expectedLen))
+                        break;
+                    QByteArray frame = recvBuf.left(expectedLen);
+                    recvBuf.remove(0, expectedLen);
+                    expectedLen = 0;
+                    frames += frame.isEmpty() ? 0 : 1;
+                }
+            }
+        }
+        QCOMPARE(frames, FrameCount);
+    }
+
+    void frameDecoder_data() { addChunkSizes(); }
+    void frameDecoder()
+    {
+        QFETCH(int, chunkSize);
+        const QList<QByteArray> input = chunks(chunkSize);
+        int frames = 0;
+
+        QBENCHMARK {
+            FrameDecoder decoder;
+            frames = 0;
+            for (const QByteArray &chunk : input) {
+                decoder.append(chunk);
+                QByteArray frame;
+                while (decoder.next(frame) == FrameDecoder::Status::Frame)
+                    frames += frame.isEmpty() ? 0 : 1;
+            }
+        }
+        QCOMPARE(frames, FrameCount);
+    }
+};
+
+QTEST_GUILESS_MAIN(FrameDecoderBenchmark)
+#include "bench_frame_decoder.moc"
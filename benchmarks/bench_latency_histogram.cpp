@@ -0,0 +1,89 @@
+/*
+耗时直方图的基准测试：每条请求要记录四个阶段，记录必须足够便宜。
+分别测单线程记录、多个线程同时记录同一个直方图（与多个Reactor、工作线程同时记录同一个action相同），
+以及admin_get_server_stats读取时的快照加百分位数计算。
+*/
+#include <QtTest>
+#include <QRandomGenerator>
+#include <QThread>
+#include <QVector>
+#include <memory>
+#include <vector>
+#include "latency_histogram.h"
+
+static constexpr int SampleCount = 100000;
+
+class LatencyHistogramBenchmark : public QObject
+{
+    Q_OBJECT
+
+private:
+    QVector<quint64> m_samples;
+
+private slots:
+    void initTestCase()
+    {
+        // 大部分在几百微秒，少量长尾
+        QRandomGenerator random(42);
+        m_samples.reserve(SampleCount);
+        for (int i = 0; i < SampleCount; ++i) {
+            const quint64 base = 50 + random.bounded(500);
+            m_samples.append(i % 100 == 0 ? base * 100 : base);
+        }
+    }
+
+    void recordSingleThread()
+    {
+        LatencyHistogram histogram;
+        QBENCHMARK {
+            for (quint64 us : std::as_const(m_samples))
+                histogram.record(us);
+        }
+        QVERIFY(histogram.snapshot().count >= static_cast<quint64>(SampleCount));
+    }
+
+    void recordContended_data()
+    {
+        QTest::addColumn<int>("threads");
+        QTest::newRow("2") << 2;
+        QTest::newRow("4") << 4;
+        QTest::newRow("8") << 8;
+    }
+    void recordContended()
+    {
+        QFETCH(int, threads);
+        LatencyHistogram histogram;
+
+        // 每个线程记录全部样本
+        QBENCHMARK {
+            std::vector<std::unique_ptr<QThread>> workers;
+            for (int t = 0; t < threads; ++t) {
+                workers.emplace_back(QThread::create([this, &histogram]() {
+                    for (quint64 us : std::as_const(m_samples))
+                        histogram.record(us);
+                }));
+                workers.back()->start();
+            }
+            for (const std::unique_ptr<QThread>& worker : workers)
+                worker->wait();
+        }
+        QVERIFY(histogram.snapshot().count >= static_cast<quint64>(SampleCount) * threads);
+    }
+
+    void snapshotPercentiles()
+    {
+        LatencyHistogram histogram;
+        for (quint64 us : std::as_const(m_samples))
+            histogram.record(us);
+
+        quint64 total = 0;
+        QBENCHMARK {
+            const LatencyHistogram::Snapshot snapshot = histogram.snapshot();
+            total = snapshot.percentileUs(50) + snapshot.percentileUs(90) + snapshot.percentileUs(99) + snapshot.percentileUs(99.9);
+        }
+        QVERIFY(total > 0);
+    }
+};
+
+QTEST_GUILESS_MAIN(LatencyHistogramBenchmark)
+#include "bench_latency_histogram.moc"
@@ -0,0 +1,79 @@
+/*
+消息编码的基准测试：一个1000行的admin_get_all_flights响应，
+比较json和cbor两种编码的payload大小（开始时输出）以及编码、解码的耗时。
+编码走MessageCodec::appendFrame（与服务器发送响应相同），解码走MessageCodec::decode（与接收请求相同）。
+*/
+#include <QtTest>
+#include <QByteArray>
+#include <QJsonArray>
+#include <QJsonObject>
+#include "message_codec.h"
+
+Q_DECLARE_METATYPE(MessageCodec::Encoding)
+
+static constexpr int RowCount = 1000;
+
+class MessageCodecBenchmark : public QObject
+{
+    Q_OBJECT
+
+private:
+    QJsonObject m_response;
+
+    static void addEncodings()
+    {
+        QTest::addColumn<MessageCodec::Encoding>("encoding");
+        QTest::newRow("json") << MessageCodec::Encoding::Json;
+        QTest::newRow("cbor") << MessageCodec::Encoding::Cbor;
+    }
+
+private slots:
+    void initTestCase()
+    {
+        QJsonArray flights;
+        for (int i = 0; i < RowCount; ++i) {
+            flights.append(QJsonObject{
+                {"flight_id", i + 1}, {"flight_number", QString("CA%1").arg(1000 + i)}, {"model", "A320"},
+                {"origin", "北京"}, {"destination", "广州"},
+                {"departure_time", "2025-12-01 08:00:00"}, {"arrival_time", "2025-12-01 11:20:00"},
+                {"total_seats", 180}, {"remaining_seats", 180 - i % 180},
+                {"price", 1380.5 + i}, {"is_deleted", 0}});
+        }
+        m_response = QJsonObject{{"status", "success"}, {"message", "查询所有航班成功"},
+                                 {"action", "admin_get_all_flights"}, {"data", flights}};
+
+        for (MessageCodec::Encoding encoding : {MessageCodec::Encoding::Json, MessageCodec::Encoding::Cbor}) {
+            qInfo().noquote() << MessageCodec::name(encoding) << "payload字节数:"
+                              << MessageCodec::encode(m_response, encoding).size();
+        }
+    }
+
+    void encode_data() { addEncodings(); }
+    void encode()
+    {
+        QFETCH(MessageCodec::Encoding, encoding);
+        QByteArray out;
+
+        QBENCHMARK {
+            out.resize(0);
+            MessageCodec::appendFrame(out, m_response, encoding);
+        }
+        QVERIFY(out.size() > FrameDecoder::HeaderSize);
+    }
+
+    void decode_data() { addEncodings(); }
+    void decode()
+    {
+        QFETCH(MessageCodec::Encoding, encoding);
+        const QByteArray payload = MessageCodec::encode(m_response, encoding);
+        QJsonObject message;
+
+        QBENCHMARK {
+            QVERIFY(MessageCodec::decode(payload, message));
+        }
+        QCOMPARE(message.value("data").toArray().size(), RowCount);
+    }
+};
+
+QTEST_GUILESS_MAIN(MessageCodecBenchmark)
+#include "bench_message_codec.moc"
@@ -0,0 +1,173 @@
+/*
+SQLite参数组合的基准测试：legacy（SQLite默认的回滚日志、每次提交fsync）、fast（WAL + NORMAL）、durable（WAL + FULL），
+每种组合各建一个临时数据库，比较
+  bookFlight：原来每张订单一个写事务（查余票、插入订单、扣座位、提交）的吞吐，每轮100张订单；
+  searchFlights：航班查询（Sql::SearchFlightsRoute，与服务器相同的语句和索引）在5万个航班上的耗时。
+参数的设置方式与DatabaseManager::configureConnection相同，表结构是createTables和版本1迁移中与这两个操作有关的部分。
+*/
+#include <QtTest>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include <QDateTime>
+#include <limits>
+#include "database_manager.h"
+#include "sql_statements.h"
+
+static constexpr int FlightCount = 50000;
+static constexpr int BookingsPerRound = 100;
+
+class SqliteProfileBenchmark : public QObject
+{
+    Q_OBJECT
+
+private:
+    QTemporaryDir m_dir;
+
+    static void addProfiles()
+    {
+        QTest::addColumn<QString>("profile");
+        for (const DatabaseProfile& profile : {DatabaseProfile::legacy(), DatabaseProfile::fast(), DatabaseProfile::durable()})
+            QTest::newRow(qPrintable(profile.name)) << profile.name;
+    }
+
+    // 按参数组合打开一个新的数据库并建好航班数据
+    QSqlDatabase open(const QString& name)
+    {
+        DatabaseProfile profile;
+        if (!DatabaseProfile::fromName(name, profile))
+            return {};
+
+        const QString connection = QTest::currentTestFunction() + QStringLiteral("_") + name;
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connection);
+        db.setDatabaseName(m_dir.filePath(connection + ".db"));
+        db.setConnectOptions(QString("QSQLITE_BUSY_TIMEOUT=%1").arg(profile.busyTimeoutMs));
+        if (!db.open())
+            return db;
+
+        QSqlQuery query(db);
+        const QStringList setup = {
+            QString("PRAGMA journal_mode = %1;").arg(profile.journalMode),
+            "PRAGMA foreign_keys = ON;",
+            QString("PRAGMA synchronous = %1;").arg(profile.synchronous),
+            QString("PRAGMA mmap_size = %1;").arg(profile.mmapSize),
+            QString("PRAGMA cache_size = %1;").arg(-profile.cacheSizeKiB),
+            QString("PRAGMA temp_store = %1;").arg(profile.tempStore),
+            "CREATE TABLE Flight ("
+            "flight_id INTEGER PRIMARY KEY AUTOINCREMENT, flight_number TEXT NOT NULL, model TEXT,"
+            "origin TEXT NOT NULL, destination TEXT NOT NULL,"
+            "departure_time DATETIME NOT NULL, arrival_time DATETIME NOT NULL,"
+            "total_seats INTEGER NOT NULL, remaining_seats INTEGER NOT NULL, price REAL NOT NULL,"
+            "is_deleted INTEGER NOT NULL DEFAULT 0, departure_epoch INTEGER, arrival_epoch INTEGER);",
+            "CREATE TABLE Booking ("
+            "booking_id INTEGER PRIMARY KEY AUTOINCREMENT, user_id INTEGER NOT NULL, flight_id INTEGER NOT NULL,"
+            "booking_time DATETIME DEFAULT CURRENT_TIMESTAMP, status TEXT NOT NULL,"
+            "FOREIGN KEY (flight_id) REFERENCES Flight (flight_id));",
+            "CREATE INDEX idx_flight_route_epoch ON Flight (origin, destination, departure_epoch) WHERE is_deleted = 0;"
+        };
+        for (const QString& sql : setup) {
+            if (!query.exec(sql))
+                qWarning() << sql << query.lastError().text();
+        }
+
+        // 10个城市两两之间的航班，起飞时间分布在60天里
+        static const char* const cities[] = {"北京", "上海", "广州", "深圳", "成都", "重庆", "杭州", "武汉", "西安", "南京"};
+        const QDateTime start = QDate(2025, 12, 1).startOfDay(Qt::UTC);
+        db.transaction();
+        query.prepare("INSERT INTO Flight (flight_number, model, origin, destination, departure_time, arrival_time,"
+                      " total_seats, remaining_seats, price, departure_epoch, arrival_epoch)"
+                      " VALUES (?, 'A320', ?, ?, ?, ?, 100000, 100000, 980.0, ?, ?)");
+        for (int i = 0; i < FlightCount; ++i) {
+            const QDateTime departure = start.addSecs(static_cast<qint64>(i) * 60 * 60 * 24 * 60 / FlightCount);
+            const QDateTime arrival = departure.addSecs(2 * 60 * 60);
+            query.bindValue(0, QString("MU%1").arg(i));
+            query.bindValue(1, QString::fromUtf8(cities[i % 10]));
+            query.bindValue(2, QString::fromUtf8(cities[(i / 10 + i + 1) % 10]));
+            query.bindValue(3, departure.toString("yyyy-MM-dd HH:mm:ss"));
+            query.bindValue(4, arrival.toString("yyyy-MM-dd HH:mm:ss"));
+            query.bindValue(5, departure.toSecsSinceEpoch());
+            query.bindValue(6, arrival.toSecsSinceEpoch());
+            query.exec();
+        }
+        db.commit();
+        query.exec("ANALYZE;");
+        return db;
+    }
+
+private slots:
+    void initTestCase()
+    {
+        QVERIFY(m_dir.isValid());
+    }
+
+    void bookFlight_data() { addProfiles(); }
+    void bookFlight()
+    {
+        QFETCH(QString, profile);
+        QSqlDatabase db = open(profile);
+        QVERIFY2(db.isOpen(), qPrintable(db.lastError().text()));
+
+        QSqlQuery seats(db);
+        seats.prepare("SELECT remaining_seats FROM Flight WHERE flight_id = ?");
+        QSqlQuery insert(db);
+        insert.prepare("INSERT INTO Booking (user_id, flight_id, status) VALUES (1, ?, 'confirmed')");
+        QSqlQuery take(db);
+        take.prepare("UPDATE Flight SET remaining_seats = remaining_seats - 1 WHERE flight_id = ? AND remaining_seats > 0");
+
+        int flightId = 0;
+        QBENCHMARK {
+            for (int i = 0; i < BookingsPerRound; ++i) {
+                flightId = flightId % FlightCount + 1;
+                QVERIFY(db.transaction());
+                seats.bindValue(0, flightId);
+                QVERIFY(seats.exec() && seats.next());
+                seats.finish();
+                insert.bindValue(0, flightId);
+                QVERIFY(insert.exec());
+                take.bindValue(0, flightId);
+                QVERIFY(take.exec());
+                QVERIFY(db.commit());
+            }
+        }
+    }
+
+    void searchFlights_data() { addProfiles(); }
+    void searchFlights()
+    {
+        QFETCH(QString, profile);
+        QSqlDatabase db = open(profile);
+        QVERIFY2(db.isOpen(), qPrintable(db.lastError().text()));
+
+        QSqlQuery query(db);
+        query.setForwardOnly(true);
+        QVERIFY(query.prepare(QString::fromUtf8(sqlText(Sql::SearchFlightsRoute))));
+        const qint64 dayBegin = QDate(2025, 12, 15).startOfDay(Qt::UTC).toSecsSinceEpoch();
+
+        int rows = 0;
+        QBENCHMARK {
+            query.bindValue(":origin", QStringLiteral("北京"));
+            query.bindValue(":destination", QStringLiteral("上海"));
+            query.bindValue(":day_begin", dayBegin);
+            query.bindValue(":day_end", dayBegin + 24 * 60 * 60);
+            query.bindValue(":after_epoch", std::numeric_limits<qint64>::min());
+            query.bindValue(":after_id", 0);
+            query.bindValue(":limit", 51);
+            QVERIFY(query.exec());
+            rows = 0;
+            while (query.next())
+                ++rows;
+            query.finish();
+        }
+        QVERIFY(rows > 0);
+    }
+
+    void cleanupTestCase()
+    {
+        for (const QString& name : QSqlDatabase::connectionNames())
+            QSqlDatabase::removeDatabase(name);
+    }
+};
+
+QTEST_GUILESS_MAIN(SqliteProfileBenchmark)
+#include "bench_sqlite_profile.moc"
@@ -0,0 +1,172 @@
+/*
+写出合并的基准测试：一个连接上流水线到达的N条search_flights请求，
+比较原来的sendJsonResponse（每条响应单独拼长度头、单独write一次）和现在的做法
+（同一轮事件循环里的响应用MessageCodec::appendFrame直接写进发送缓冲，flushConnection时整体write一次）。
+两种做法都直接对socketpair调用write(2)，与epoll传输层一样；除了耗时，还从 /proc/self/io 的syscw
+读出一轮实际发生的write系统调用次数（只有Linux提供，其他平台只输出耗时）。
+*/
+#include <QtTest>
+#include <QByteArray>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtEndian>
+#include "message_codec.h"
+
+#ifdef Q_OS_UNIX
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+class WriteCoalescingBenchmark : public QObject
+{
+    Q_OBJECT
+
+private:
+    QJsonObject m_response;
+    int m_fds[2]{-1, -1};
+
+    static void addPipelineDepths()
+    {
+        QTest::addColumn<int>("responses");
+        QTest::newRow("1") << 1;
+        QTest::newRow("10") << 10;
+        QTest::newRow("50") << 50;
+    }
+
+    // 当前进程累计的write类系统调用次数，读不到时返回-1
+    static qint64 writeSyscalls()
+    {
+        QFile io(QStringLiteral("/proc/self/io"));
+        if (!io.open(QIODevice::ReadOnly))
+            return -1;
+        for (const QByteArray &line : io.readAll().split('\n')) {
+            if (line.startsWith("syscw:"))
+                return line.mid(6).trimmed().toLongLong();
+        }
+        return -1;
+    }
+
+    void writeAll(const QByteArray &data)
+    {
+#ifdef Q_OS_UNIX
+        const char *p = data.constData();
+        qsizetype left = data.size();
+        while (left > 0) {
+            const ssize_t n = ::write(m_fds[0], p, static_cast<size_t>(left));
+            if (n <= 0)
+                QFAIL("write failed");
+            p += n;
+            left -= n;
+        }
+#else
+        Q_UNUSED(data);
+#endif
+    }
+
+    // 接收端把这一轮写出的数据全部读走，避免socket缓冲写满
+    void drain(qsizetype bytes)
+    {
+#ifdef Q_OS_UNIX
+        char buf[64 * 1024];
+        while (bytes > 0) {
+            const ssize_t n = ::read(m_fds[1], buf, sizeof(buf));
+            if (n <= 0)
+                QFAIL("read failed");
+            bytes -= n;
+        }
+#else
+        Q_UNUSED(bytes);
+#endif
+    }
+
+    // 原来的做法：每条响应一个新的QByteArray，单独write
+    qsizetype sendPerResponse(int responses)
+    {
+        qsizetype total = 0;
+        for (int i = 0; i < responses; ++i) {
+            const QByteArray payload = QJsonDocument(m_response).toJson(QJsonDocument::Compact);
+            QByteArray block;
+            block.resize(sizeof(quint32));
+            qToBigEndian(static_cast<quint32>(payload.size()), reinterpret_cast<uchar *>(block.data()));
+            block.append(payload);
+            writeAll(block);
+            total += block.size();
+        }
+        return total;
+    }
+
+    // 现在的做法：长度头原地写进发送缓冲，整轮只write一次
+    qsizetype sendCoalesced(int responses, QByteArray &sendBuf)
+    {
+        sendBuf.resize(0);
+        for (int i = 0; i < responses; ++i)
+            MessageCodec::appendFrame(sendBuf, m_response, MessageCodec::Encoding::Json);
+        writeAll(sendBuf);
+        return sendBuf.size();
+    }
+
+private slots:
+    void initTestCase()
+    {
+#ifdef Q_OS_UNIX
+        QVERIFY(::socketpair(AF_UNIX, SOCK_STREAM, 0, m_fds) == 0);
+#else
+        QSKIP("需要socketpair");
+#endif
+        // 一页search_flights的结果
+        QJsonArray flights;
+        for (int i = 0; i < 5; ++i) {
+            flights.append(QJsonObject{
+                {"flight_id", 1000 + i}, {"flight_number", QString("MU%1").arg(5100 + i)},
+                {"origin", "北京"}, {"destination", "上海"},
+                {"departure_time", "2025-12-01 08:00:00"}, {"arrival_time", "2025-12-01 10:15:00"},
+                {"remaining_seats", 120 - i}, {"price", 1280.0}});
+        }
+        m_response = QJsonObject{{"status", "success"}, {"message", "查询成功"},
+                                 {"action", "search_flights"}, {"data", flights}};
+    }
+
+    void cleanupTestCase()
+    {
+#ifdef Q_OS_UNIX
+        ::close(m_fds[0]);
+        ::close(m_fds[1]);
+#endif
+    }
+
+    void perResponseWrite_data() { addPipelineDepths(); }
+    void perResponseWrite()
+    {
+        QFETCH(int, responses);
+
+        const qint64 before = writeSyscalls();
+        drain(sendPerResponse(responses));
+        if (before >= 0)
+            qInfo() << "write系统调用次数:" << writeSyscalls() - before;
+
+        QBENCHMARK {
+            drain(sendPerResponse(responses));
+        }
+    }
+
+    void coalescedWrite_data() { addPipelineDepths(); }
+    void coalescedWrite()
+    {
+        QFETCH(int, responses);
+        QByteArray sendBuf;
+
+        const qint64 before = writeSyscalls();
+        drain(sendCoalesced(responses, sendBuf));
+        if (before >= 0)
+            qInfo() << "write系统调用次数:" << writeSyscalls() - before;
+
+        QBENCHMARK {
+            drain(sendCoalesced(responses, sendBuf));
+        }
+    }
+};
+
+QTEST_GUILESS_MAIN(WriteCoalescingBenchmark)
+#include "bench_write_coalescing.moc"
@@ -6,9 +6,10 @@
 #include <QDateTime>
 #include <QRandomGenerator>
 #include <QtEndian>
+#include <climits>
 
 NetworkManager::NetworkManager(QObject *parent)
-    : QObject(parent), m_socket(nullptr), m_tagRegistered(false), m_reconnectPending(false), m_lastPort(0)
+    : QObject(parent), m_socket(nullptr), m_tagRegistered(false), m_decoder(MaxFrameSize), m_encoding(MessageCodec::Encoding::Json), m_reconnectPending(false), m_lastPort(0)
 {
     m_socket = new QTcpSocket(this);
 
@@ -32,53 +33,43 @@ void NetworkManager::connectToServer(const QString &host, quint16 port)
 // 当收到服务器数据时 (JSON解析)
 void NetworkManager::onReadyRead()
 {
-    m_receiveBuffer.append(m_socket->readAll());
+    m_decoder.append(m_socket->readAll());
     processLengthPrefixedBuffer();
 }
 
 void NetworkManager::processLengthPrefixedBuffer()
 {
-    const int headerSize = static_cast<int>(sizeof(quint32));
-    const quint32 maxFrameSize = 4u * 1024u * 1024u;
+    QByteArray payload;
+    bool compressed = false;
 
     while (true)
     {
-        if (m_receiveBuffer.size() < headerSize)
+        FrameDecoder::Status status = m_decoder.next(payload, &compressed);
+        if (status == FrameDecoder::Status::NeedMore)
         {
             return;
         }
 
-        quint32 frameLength = qFromBigEndian<quint32>(
-            reinterpret_cast<const uchar *>(m_receiveBuffer.constData()));
-
-        if (frameLength == 0 || frameLength > maxFrameSize)
+        if (status == FrameDecoder::Status::Oversized || payload.isEmpty())
         {
-            qWarning() << "收到异常的帧长度:" << frameLength;
+            qWarning() << "收到异常的帧长度:"
+                       << (status == FrameDecoder::Status::Oversized ? m_decoder.pendingFrameSize() : 0u);
             emit generalError("收到异常的服务器响应 (帧长度)");
-            m_receiveBuffer.clear();
-            return;
-        }
-
-        const int totalNeeded = headerSize + static_cast<int>(frameLength);
-        if (m_receiveBuffer.size() < totalNeeded)
-        {
+            m_decoder.clear();
             return;
         }
 
-        QByteArray payload = m_receiveBuffer.mid(headerSize, frameLength);
-        m_receiveBuffer.remove(0, totalNeeded);
-
-        qDebug() << "收到服务器响应:" << payload;
-
-        QJsonDocument jsonDoc = QJsonDocument::fromJson(payload);
-        if (jsonDoc.isNull() || !jsonDoc.isObject())
+        // 服务器可能发送JSON或CBOR（按首字节区分），大的响应可能经过压缩
+        QJsonObject response;
+        if (!MessageCodec::decodeFrame(payload, compressed, MaxFrameSize, response))
         {
-            qWarning() << "收到无效的JSON响应 (非JSON)";
-            emit generalError("收到无效的服务器响应 (非JSON)");
+            qWarning() << "收到无效的服务器响应:" << payload;
+            emit generalError("收到无效的服务器响应 (无法解析)");
             continue;
         }
 
-        handleResponseObject(jsonDoc.object());
+        qDebug() << "收到服务器响应:" << response;
+        handleResponseObject(response);
     }
 }
 
@@ -92,8 +83,18 @@ void NetworkManager::handleResponseObject(const QJsonObject &response)
         if (status == "success")
         {
             m_tagRegistered = true;
-            qInfo() << "Tag注册成功";
+            // 旧服务器不返回encoding，继续使用json
+            if (!MessageCodec::fromName(response.value("encoding").toString(), m_encoding))
+            {
+                m_encoding = MessageCodec::Encoding::Json;
+            }
+            qInfo() << "Tag注册成功，编码:" << MessageCodec::name(m_encoding);
             emit tagRegistered();
+            // 重连后服务器端的订阅已经丢失，重新订阅
+            if (!m_subscribedFlights.isEmpty())
+            {
+                subscribeFlightsRequest(m_subscribedFlights);
+            }
         }
         else
         {
@@ -109,7 +110,8 @@ void NetworkManager::handleResponseObject(const QJsonObject &response)
         action = response.value("action").toString();
     }
 
-    QJsonObject requestPayload = detachPendingPayload(action);
+    const PendingRequest pending = detachPendingRequest(response, action);
+    const QJsonObject requestPayload = pending.payload;
 
     if (action.isEmpty())
     {
@@ -128,7 +130,13 @@ void NetworkManager::handleResponseObject(const QJsonObject &response)
     if (status == "error")
     {
         qWarning() << "服务器返回错误:" << message << " (Action: " << action << ")";
-        emitActionFailed(action, message);
+        // 限流或过载：请求没有被处理，可以安全地重发
+        const qint64 retryAfterMs = response.value("retry_after_ms").toInteger();
+        if (retryAfterMs > 0 && scheduleRetry(pending, retryAfterMs))
+        {
+            return;
+        }
+        emitActionFailed(action, message, retryAfterMs);
         return;
     }
 
@@ -156,6 +164,15 @@ void NetworkManager::handleResponseObject(const QJsonObject &response)
     {
         emit cancelOrderSuccess(message);
     }
+    else if (action == "subscribe_flights")
+    {
+        // 订阅成功时服务器返回这些航班当前的余票，和推送一样处理
+        emit seatUpdates(response.value("data").toObject().value("flights").toArray());
+    }
+    else if (action == "seat_update")
+    {
+        emit seatUpdates(response.value("data").toArray());
+    }
     else if (action == "update_profile")
     {
         QJsonObject userData = response.value("data").toObject();
@@ -204,8 +221,9 @@ void NetworkManager::onConnected()
 {
     qInfo() << "已连接到服务器!";
     emit connected();
-    m_receiveBuffer.clear();
+    m_decoder.clear();
     m_pendingRequests.clear();
+    m_encoding = MessageCodec::Encoding::Json;
 
     // 连接成功后自动发送tag注册
     QString tag = generateUniqueTag();
@@ -217,7 +235,8 @@ void NetworkManager::onDisconnected()
     qWarning() << "与服务器断开连接";
     m_tagRegistered = false; // 重置tag注册状态
     m_pendingRequests.clear();
-    m_receiveBuffer.clear();
+    m_decoder.clear();
+    m_encoding = MessageCodec::Encoding::Json;
     m_clientTag.clear();
     emit disconnected();
 
@@ -245,9 +264,12 @@ void NetworkManager::sendTagRegistration(const QString &tag)
 
     QJsonObject request;
     request["tag"] = tag;
+    // 告知服务器本客户端的协议版本与支持的编码（按偏好排序）
+    request["protocol"] = MessageCodec::ProtocolVersion;
+    request["encodings"] = MessageCodec::supportedEncodings();
+    request["compressions"] = MessageCodec::supportedCompressions();
 
-    QJsonDocument doc(request);
-    writeFramedJson(doc);
+    writeFrame(request);
     qDebug() << "发送tag注册请求:" << tag;
 }
 
@@ -265,7 +287,7 @@ QString NetworkManager::generateUniqueTag() const
 }
 
 // 发送JSON的通用函数
-void NetworkManager::sendJsonRequest(const QJsonObject &request)
+void NetworkManager::sendJsonRequest(const QJsonObject &request, int attempts)
 {
     QString actionName = request.value("action").toString();
 
@@ -283,33 +305,62 @@ void NetworkManager::sendJsonRequest(const QJsonObject &request)
         return;
     }
 
-    QJsonDocument doc(request);
-    writeFramedJson(doc);
-    qDebug() << "发送JSON请求:" << request;
+    // 为每个请求分配request_id，服务器会在响应中原样回显，据此匹配响应
+    const int requestId = m_nextRequestId;
+    m_nextRequestId = (m_nextRequestId == INT_MAX) ? 1 : m_nextRequestId + 1;
+
+    QJsonObject framed = request;
+    framed["request_id"] = requestId;
+
+    writeFrame(framed);
+    qDebug() << "发送JSON请求:" << framed;
 
     if (!actionName.isEmpty())
     {
-        PendingRequest pending{actionName, request.value("data").toObject()};
-        m_pendingRequests.enqueue(pending);
+        PendingRequest pending{actionName, request.value("data").toObject(), attempts};
+        m_pendingRequests.insert(requestId, pending);
     }
 }
 
-void NetworkManager::writeFramedJson(const QJsonDocument &document)
+void NetworkManager::writeFrame(const QJsonObject &message)
 {
-    QByteArray payload = document.toJson(QJsonDocument::Compact);
-
-    quint32 length = static_cast<quint32>(payload.size());
-
+    // 长度头+按协商的编码写出的消息（请求都很小，不压缩）
     QByteArray frame;
-    frame.resize(sizeof(quint32));
-    qToBigEndian(length, reinterpret_cast<uchar *>(frame.data()));
-    frame.append(payload);
+    MessageCodec::appendFrame(frame, message, m_encoding);
 
     m_socket->write(frame);
 }
 
-void NetworkManager::emitActionFailed(const QString &action, const QString &message)
+bool NetworkManager::scheduleRetry(const PendingRequest &pending, qint64 retryAfterMs)
+{
+    if (pending.action.isEmpty() || pending.attempts >= MaxAutoRetries || retryAfterMs > MaxAutoRetryDelayMs)
+    {
+        return false;
+    }
+
+    // 加一点随机抖动，避免大量客户端在同一时刻重试
+    const qint64 delay = retryAfterMs + QRandomGenerator::global()->bounded(0, 250);
+    qInfo() << "服务器繁忙，" << delay << "ms 后重发:" << pending.action;
+
+    QJsonObject request;
+    request["action"] = pending.action;
+    request["data"] = pending.payload;
+    const int attempts = pending.attempts + 1;
+    QTimer::singleShot(delay, this, [this, request, attempts]()
+                       { sendJsonRequest(request, attempts); });
+    return true;
+}
+
+void NetworkManager::emitActionFailed(const QString &action, const QString &rawMessage, qint64 retryAfterMs)
 {
+    QString message = rawMessage;
+    if (retryAfterMs > 0)
+    {
+        // 向上取整到秒，至少1秒
+        const qint64 seconds = qMax<qint64>(1, (retryAfterMs + 999) / 1000);
+        message += QString("（请在 %1 秒后重试）").arg(seconds);
+    }
+
     if (action == "login")
     {
         emit loginFailed(message);
@@ -338,6 +389,11 @@ void NetworkManager::emitActionFailed(const QString &action, const QString &mess
     {
         emit profileUpdateFailed(message);
     }
+    else if (action == "subscribe_flights")
+    {
+        // 订阅失败不影响查询结果，只是余票不会自动更新
+        qWarning() << "订阅航班余票失败:" << message;
+    }
     else if (!action.isEmpty())
     {
         emit generalError(message);
@@ -348,30 +404,52 @@ void NetworkManager::emitActionFailed(const QString &action, const QString &mess
     }
 }
 
-QJsonObject NetworkManager::detachPendingPayload(QString &action)
+NetworkManager::PendingRequest NetworkManager::detachPendingRequest(const QJsonObject &response, QString &action)
 {
-    QJsonObject payload;
-    QQueue<PendingRequest> updated;
-    bool removed = false;
+    PendingRequest request;
 
-    while (!m_pendingRequests.isEmpty())
+    // 服务器回显了request_id：直接按id取出
+    const QJsonValue idValue = response.value("request_id");
+    if (!idValue.isUndefined())
     {
-        PendingRequest current = m_pendingRequests.dequeue();
-        if (!removed && (action.isEmpty() || current.action == action))
+        auto it = m_pendingRequests.find(idValue.toInt());
+        if (it == m_pendingRequests.end())
+        {
+            return request;
+        }
+        if (action.isEmpty())
+        {
+            action = it->action;
+        }
+        request = it.value();
+        m_pendingRequests.erase(it);
+        return request;
+    }
+
+    // 旧版服务器不回显request_id：退回按发送顺序匹配（取同一action中最早发送的请求）
+    auto match = m_pendingRequests.end();
+    for (auto it = m_pendingRequests.begin(); it != m_pendingRequests.end(); ++it)
+    {
+        if (!action.isEmpty() && it->action != action)
         {
-            if (action.isEmpty())
-            {
-                action = current.action;
-            }
-            payload = current.payload;
-            removed = true;
             continue;
         }
-        updated.enqueue(current);
+        if (match == m_pendingRequests.end() || it.key() < match.key())
+        {
+            match = it;
+        }
     }
 
-    m_pendingRequests = updated;
-    return payload;
+    if (match != m_pendingRequests.end())
+    {
+        if (action.isEmpty())
+        {
+            action = match->action;
+        }
+        request = match.value();
+        m_pendingRequests.erase(match);
+    }
+    return request;
 }
 
 // 构建各种请求 (给UI调用)
@@ -477,3 +555,25 @@ void NetworkManager::cancelOrderRequest(int bookingId)
 
     sendJsonRequest(request);
 }
+
+void NetworkManager::subscribeFlightsRequest(const QList<int> &flightIds)
+{
+    m_subscribedFlights = flightIds;
+
+    // 还没连上时只记下来，tag注册成功后会自动发送
+    if (!m_tagRegistered)
+        return;
+
+    QJsonArray ids;
+    for (int flightId : flightIds)
+        ids.append(flightId);
+
+    QJsonObject data;
+    data["flight_ids"] = ids;
+
+    QJsonObject request;
+    request["action"] = "subscribe_flights";
+    request["data"] = data;
+
+    sendJsonRequest(request);
+}
@@ -11,9 +11,12 @@
 #include <QJsonDocument>
 #include <QJsonArray>
 #include <QDebug>
-#include <QQueue>
+#include <QHash>
 #include <QByteArray>
 #include <QStringList>
+#include <QList>
+#include "frame_decoder.h"
+#include "message_codec.h"
 
 class NetworkManager : public QObject
 {
@@ -43,6 +46,8 @@ public:
     void getMyOrdersRequest(int userId);
     void cancelOrderRequest(int bookingId);
     void updateProfileRequest(int userId, const QString &username, const QString &password);
+    // 订阅这些航班的余票变化（替换之前的订阅，空列表表示取消订阅），断线重连后会自动重新订阅
+    void subscribeFlightsRequest(const QList<int> &flightIds);
     // ... (注意，每个action都对应一个发送函数，如果后续要新增这里也要加)
 
 signals:
@@ -66,6 +71,8 @@ signals:
     void cancelOrderFailed(const QString &message);
     void profileUpdateSuccess(const QString &message, const QJsonObject &userData);
     void profileUpdateFailed(const QString &message);
+    // 余票变化：[{flight_id, remaining_seats}, ...]，来自订阅成功时的快照或服务器推送的seat_update
+    void seatUpdates(const QJsonArray &updates);
     // ... (如果后续要加加在这里)
     void generalError(const QString &message);
 
@@ -86,21 +93,33 @@ private:
     {
         QString action;
         QJsonObject payload;
+        int attempts = 0; // 因服务器繁忙（retry_after_ms）已经自动重发的次数
     };
 
+    // 服务器因限流或过载拒绝请求时（请求没有被处理），等待retry_after_ms后自动重发一次；等待太久则直接报错
+    static constexpr int MaxAutoRetries = 1;
+    static constexpr qint64 MaxAutoRetryDelayMs = 5000;
+
     QTcpSocket *m_socket;
     bool m_tagRegistered;
     QString m_clientTag;
-    QQueue<PendingRequest> m_pendingRequests;
-    QByteArray m_receiveBuffer;
+    QHash<int, PendingRequest> m_pendingRequests; // 以request_id为键的待响应请求
+    QList<int> m_subscribedFlights; // 当前订阅的航班，重连后重新订阅
+    int m_nextRequestId = 1;
+    static constexpr quint32 MaxFrameSize = 4u * 1024u * 1024u; // 单帧最大4MB
+    FrameDecoder m_decoder;
+    MessageCodec::Encoding m_encoding; // tag注册成功后由服务器告知的发送编码，之前一律用json
     bool m_reconnectPending;
     QString m_lastHost;
     quint16 m_lastPort;
 
-    void sendJsonRequest(const QJsonObject &request);
-    void writeFramedJson(const QJsonDocument &document);
-    void emitActionFailed(const QString &action, const QString &message);
-    QJsonObject detachPendingPayload(QString &action);
+    void sendJsonRequest(const QJsonObject &request, int attempts = 0);
+    void writeFrame(const QJsonObject &message);
+    // retryAfterMs > 0 表示服务器繁忙，提示信息中会带上建议的等待时间
+    void emitActionFailed(const QString &action, const QString &message, qint64 retryAfterMs = 0);
+    PendingRequest detachPendingRequest(const QJsonObject &response, QString &action);
+    // 服务器给出了retry_after_ms时尝试自动重发，已安排重发返回true
+    bool scheduleRetry(const PendingRequest &pending, qint64 retryAfterMs);
     void processLengthPrefixedBuffer();
     void handleResponseObject(const QJsonObject &response);
     void reconnectToLastEndpoint();
@@ -329,6 +329,14 @@ Rectangle {
                     
                     // 正确访问模型数据 - QVariantList 的每个元素作为 modelData
                     property var flightData: modelData || {}
+                    // 余票优先使用服务器推送的最新值，推送只更新这个绑定，不重建列表
+                    property bool hasSeats: flightData && flightData.remaining_seats !== undefined
+                    property int remainingSeats: {
+                        if (!flightData) return 0
+                        var pushed = bridge && bridge.seatCounts ? bridge.seatCounts[String(flightData.flight_id)] : undefined
+                        if (pushed !== undefined) return pushed
+                        return flightData.remaining_seats !== undefined ? flightData.remaining_seats : 0
+                    }
                     
                     MouseArea {
                         anchors.fill: parent
@@ -384,23 +392,21 @@ Rectangle {
                             spacing: 5
                             
                             Text {
-                                text: "剩余座位: " + (flightData && flightData.remaining_seats !== undefined ? flightData.remaining_seats : 0)
+                                text: "剩余座位: " + remainingSeats
                                 font.pixelSize: 14
                                 color: "#666"
                             }
                             
                             Text {
-                                visible: flightData && flightData.remaining_seats !== undefined
+                                visible: hasSeats
                                 text: {
-                                    if (!flightData || flightData.remaining_seats === undefined) return ""
-                                    var seats = flightData.remaining_seats
-                                    return seats > 10 ? "充足" : seats > 0 ? "紧张" : "售罄"
+                                    if (!hasSeats) return ""
+                                    return remainingSeats > 10 ? "充足" : remainingSeats > 0 ? "紧张" : "售罄"
                                 }
                                 font.pixelSize: 12
                                 color: {
-                                    if (!flightData || flightData.remaining_seats === undefined) return "#666"
-                                    var seats = flightData.remaining_seats
-                                    return seats > 10 ? "#4CAF50" : seats > 0 ? "#FF9800" : "#f44336"
+                                    if (!hasSeats) return "#666"
+                                    return remainingSeats > 10 ? "#4CAF50" : remainingSeats > 0 ? "#FF9800" : "#f44336"
                                 }
                             }
                         }
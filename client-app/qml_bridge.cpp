@@ -2,6 +2,7 @@
 #include <QDebug>
 #include <QVariant>
 #include <QDate>
+#include <QHash>
 
 QmlBridge::QmlBridge(QObject *parent)
     : QObject(parent)
@@ -15,6 +16,7 @@ QmlBridge::QmlBridge(QObject *parent)
     connect(&nm, &NetworkManager::registerFailed, this, &QmlBridge::onRegisterFailed);
     connect(&nm, &NetworkManager::searchResults, this, &QmlBridge::onSearchResults);
     connect(&nm, &NetworkManager::searchFailed, this, &QmlBridge::onSearchFailed);
+    connect(&nm, &NetworkManager::seatUpdates, this, &QmlBridge::onSeatUpdates);
     connect(&nm, &NetworkManager::bookingSuccess, this, &QmlBridge::onBookingSuccess);
     connect(&nm, &NetworkManager::bookingFailed, this, &QmlBridge::onBookingFailed);
     connect(&nm, &NetworkManager::myOrdersResult, this, &QmlBridge::onMyOrdersResult);
@@ -193,7 +195,22 @@ QVariantList QmlBridge::jsonArrayToVariantList(const QJsonArray &jsonArray)
 void QmlBridge::onSearchResults(const QJsonArray &flights)
 {
     m_searchResults = jsonArrayToVariantList(flights);
+    m_seatCounts.clear();
     emit searchResultsChanged();
+    emit seatCountsChanged();
+
+    // 订阅结果中的航班，之后余票变化由服务器推送，不用反复刷新查询
+    QList<int> flightIds;
+    for (const QJsonValue &value : flights)
+    {
+        const int flightId = value.toObject().value("flight_id").toInt();
+        if (flightId > 0)
+        {
+            flightIds.append(flightId);
+        }
+    }
+    NetworkManager::instance().subscribeFlightsRequest(flightIds);
+
     emit searchComplete();
     if (m_searchInProgress)
     {
@@ -202,6 +219,38 @@ void QmlBridge::onSearchResults(const QJsonArray &flights)
     }
 }
 
+void QmlBridge::onSeatUpdates(const QJsonArray &updates)
+{
+    if (updates.isEmpty())
+    {
+        return;
+    }
+
+    QHash<int, int> seats;
+    for (const QJsonValue &value : updates)
+    {
+        const QJsonObject update = value.toObject();
+        const int flightId = update.value("flight_id").toInt();
+        const int remaining = update.value("remaining_seats").toInt();
+        seats.insert(flightId, remaining);
+        m_seatCounts.insert(QString::number(flightId), remaining);
+    }
+
+    // 同步修改查询结果里的余票（预订对话框从这里取数据），但不发出searchResultsChanged，避免列表重建
+    for (QVariant &item : m_searchResults)
+    {
+        QVariantMap flight = item.toMap();
+        auto it = seats.constFind(flight.value("flight_id").toInt());
+        if (it != seats.constEnd())
+        {
+            flight["remaining_seats"] = it.value();
+            item = flight;
+        }
+    }
+
+    emit seatCountsChanged();
+}
+
 void QmlBridge::onSearchFailed(const QString &message)
 {
     if (m_searchInProgress)
@@ -6,6 +6,7 @@
 #include <QJsonArray>
 #include <QString>
 #include <QVariantList>
+#include <QVariantMap>
 #include "network_manager.h"
 #include "app_session.h"
 
@@ -22,6 +23,8 @@ class QmlBridge : public QObject
     // 搜索相关
     Q_PROPERTY(QVariantList searchResults READ searchResults NOTIFY searchResultsChanged)
     Q_PROPERTY(bool searchInProgress READ searchInProgress NOTIFY searchInProgressChanged)
+    // 服务器推送的最新余票（航班id字符串 -> 剩余座位），列表中的航班据此原地刷新，不重建整个列表
+    Q_PROPERTY(QVariantMap seatCounts READ seatCounts NOTIFY seatCountsChanged)
 
     // 订单相关
     Q_PROPERTY(QVariantList myOrders READ myOrders NOTIFY myOrdersChanged)
@@ -36,6 +39,7 @@ public:
     bool isLoggedIn() const { return AppSession::instance().userId() > 0; }
     bool isAdmin() const { return AppSession::instance().isAdmin(); }
     QVariantList searchResults() const { return m_searchResults; }
+    QVariantMap seatCounts() const { return m_seatCounts; }
     QVariantList myOrders() const { return m_myOrders; }
     bool searchInProgress() const { return m_searchInProgress; }
     bool ordersInProgress() const { return m_ordersInProgress; }
@@ -74,6 +78,7 @@ signals:
     void isLoggedInChanged();
     void isAdminChanged();
     void searchResultsChanged();
+    void seatCountsChanged();
     void myOrdersChanged();
 
     // 操作结果信号
@@ -106,6 +111,7 @@ private slots:
     void onRegisterSuccess(const QString &message);
     void onRegisterFailed(const QString &message);
     void onSearchResults(const QJsonArray &flights);
+    void onSeatUpdates(const QJsonArray &updates);
     void onBookingSuccess(const QJsonObject &bookingData);
     void onBookingFailed(const QString &message);
     void onMyOrdersResult(const QJsonArray &orders);
@@ -120,6 +126,7 @@ private slots:
 
 private:
     QVariantList m_searchResults;
+    QVariantMap m_seatCounts;
     QVariantList m_myOrders;
     bool m_searchInProgress{false};
     bool m_ordersInProgress{false};
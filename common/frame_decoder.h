@@ -0,0 +1,107 @@
+/*
+该文件实现server-app、client-app、admin-app共用的定长帧解码器
+协议格式：[4字节大端长度][payload]
+长度的最高位是压缩标志（见CompressedFlag），低31位才是payload的长度；只有双方在握手时协商了压缩才会置位。
+用法：收到数据后调用append()，然后循环调用next()取出完整帧，直到返回NeedMore。
+
+与直接对QByteArray调用remove(0, n)相比，这里只移动读游标，不会每取一帧就搬移整个缓冲区；
+已读部分在下一次append()时才整体丢弃（已读字节不少于未读字节时才搬移，摊还下来每个字节只搬移常数次）。
+next()返回的帧通过QByteArray::fromRawData直接指向内部缓冲区，不发生拷贝，
+所以它只在下一次append()/clear()之前有效，需要长期保存时请自行拷贝。
+*/
+#ifndef FRAME_DECODER_H
+#define FRAME_DECODER_H
+
+#include <QByteArray>
+#include <QtEndian>
+
+class FrameDecoder
+{
+public:
+    enum class Status {
+        NeedMore,   // 数据不够一帧，等待更多数据
+        Frame,      // 取出了一帧
+        Oversized   // 长度前缀超过上限，连接应当被视为异常
+    };
+
+    static constexpr qsizetype HeaderSize = sizeof(quint32);
+    static constexpr quint32 CompressedFlag = 0x80000000u; // 长度头最高位：payload经过压缩
+    static constexpr quint32 LengthMask = 0x7FFFFFFFu;
+
+    // maxFrameSize 为 0 表示不限制帧长度
+    explicit FrameDecoder(quint32 maxFrameSize = 0) : m_maxFrameSize(maxFrameSize) {}
+
+    void setMaxFrameSize(quint32 maxFrameSize) { m_maxFrameSize = maxFrameSize; }
+    quint32 maxFrameSize() const { return m_maxFrameSize; }
+
+    // 追加收到的数据，之前next()返回的帧随之失效
+    void append(const QByteArray &data)
+    {
+        compact();
+        m_buf.append(data);
+    }
+
+    // 尝试取出下一帧，compressed不为空时返回该帧的压缩标志
+    Status next(QByteArray &frame, bool *compressed = nullptr)
+    {
+        if (available() < HeaderSize)
+            return Status::NeedMore;
+
+        const quint32 header = qFromBigEndian<quint32>(
+            reinterpret_cast<const uchar *>(m_buf.constData() + m_readPos));
+        const quint32 len = header & LengthMask;
+
+        // 在缓冲整帧之前就检查长度，超长的帧不会被继续接收
+        if (m_maxFrameSize > 0 && len > m_maxFrameSize)
+            return Status::Oversized;
+
+        if (available() - HeaderSize < static_cast<qsizetype>(len))
+            return Status::NeedMore;
+
+        frame = QByteArray::fromRawData(m_buf.constData() + m_readPos + HeaderSize, static_cast<qsizetype>(len));
+        m_readPos += HeaderSize + static_cast<qsizetype>(len);
+        if (compressed)
+            *compressed = (header & CompressedFlag) != 0;
+        return Status::Frame;
+    }
+
+    // 还未被取走的字节数（包括不完整的帧）
+    qsizetype available() const { return m_buf.size() - m_readPos; }
+
+    // 如果下一帧的长度前缀已经到达，返回该帧的长度，否则返回0
+    quint32 pendingFrameSize() const
+    {
+        if (available() < HeaderSize)
+            return 0;
+        return qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(m_buf.constData() + m_readPos)) & LengthMask;
+    }
+
+    void clear()
+    {
+        m_buf.clear();
+        m_readPos = 0;
+    }
+
+private:
+    QByteArray m_buf;
+    qsizetype m_readPos{0};
+    quint32 m_maxFrameSize{0};
+
+    // 丢弃已读部分
+    void compact()
+    {
+        if (m_readPos == 0)
+            return;
+
+        if (m_readPos == m_buf.size()) {
+            // 全部读完：保留容量，不搬移数据
+            m_buf.resize(0);
+            m_readPos = 0;
+        } else if (m_readPos >= available()) {
+            m_buf.remove(0, m_readPos);
+            m_readPos = 0;
+        }
+    }
+};
+
+#endif // FRAME_DECODER_H
@@ -0,0 +1,275 @@
+/*
+该文件实现server-app、client-app、admin-app共用的消息编解码
+帧内容（[4字节长度]之后的payload）可以是两种编码之一：
+  json：原有的紧凑JSON文本
+  cbor：二进制CBOR（RFC 8949），同样表示一个JSON对象，体积更小、编解码更快
+编码在tag注册时协商：客户端在注册包里带上 "protocol" 和按偏好排序的 "encodings"，
+服务器选出第一个自己支持的编码，在注册成功的响应（固定为json）里通过 "encoding" 告知，之后双方都使用该编码发送。
+接收方不依赖协商结果：JSON对象去掉开头的空白和UTF-8 BOM之后总是以'{'开头，CBOR的map首字节是0xA0~0xBF，按首字节即可区分，
+所以协商完成前后到达的帧都能正确解析，不带encodings的旧客户端也会一直使用json。
+
+压缩同样在tag注册时协商（"compressions" / "compression"）：协商了zlib的连接上，编码后超过阈值的帧
+用zlib（qCompress格式）压缩并在长度头上置压缩标志，小帧和压缩后没有变小的帧保持原样。
+appendFrame()/decodeFrame()负责整帧的组装与拆解，三个程序都通过它们收发消息。
+*/
+#ifndef MESSAGE_CODEC_H
+#define MESSAGE_CODEC_H
+
+#include <QByteArray>
+#include <QString>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonValue>
+#include <QCborStreamWriter>
+#include <QCborValue>
+#include <QCborMap>
+#include <QtEndian>
+#include "frame_decoder.h"
+
+class MessageCodec
+{
+public:
+    enum class Encoding {
+        Json,
+        Cbor
+    };
+
+    enum class Compression {
+        None,
+        Zlib
+    };
+
+    // 协议版本：tag注册时交换，以后协议有不兼容的改动时递增
+    static constexpr int ProtocolVersion = 1;
+
+    // zlib压缩级别：1最快，对重复键名很多的JSON/CBOR已经有很好的压缩率
+    static constexpr int ZlibLevel = 1;
+
+    static QString name(Encoding encoding)
+    {
+        return encoding == Encoding::Cbor ? QStringLiteral("cbor") : QStringLiteral("json");
+    }
+
+    static bool fromName(const QString &name, Encoding &encoding)
+    {
+        if (name == QLatin1String("cbor")) {
+            encoding = Encoding::Cbor;
+            return true;
+        }
+        if (name == QLatin1String("json")) {
+            encoding = Encoding::Json;
+            return true;
+        }
+        return false;
+    }
+
+    // 客户端在tag注册包中提供的编码列表（按偏好排序）
+    static QJsonArray supportedEncodings()
+    {
+        return QJsonArray{name(Encoding::Cbor), name(Encoding::Json)};
+    }
+
+    // 服务器端：从客户端提供的列表中选出第一个支持的编码，都不支持时使用json
+    static Encoding negotiate(const QJsonArray &offered)
+    {
+        for (const QJsonValue &value : offered) {
+            Encoding encoding;
+            if (fromName(value.toString(), encoding))
+                return encoding;
+        }
+        return Encoding::Json;
+    }
+
+    static QString compressionName(Compression compression)
+    {
+        return compression == Compression::Zlib ? QStringLiteral("zlib") : QStringLiteral("none");
+    }
+
+    static bool compressionFromName(const QString &name, Compression &compression)
+    {
+        if (name == QLatin1String("zlib")) {
+            compression = Compression::Zlib;
+            return true;
+        }
+        if (name == QLatin1String("none")) {
+            compression = Compression::None;
+            return true;
+        }
+        return false;
+    }
+
+    // 客户端在tag注册包中提供的压缩算法列表（按偏好排序）
+    static QJsonArray supportedCompressions()
+    {
+        return QJsonArray{compressionName(Compression::Zlib)};
+    }
+
+    // 服务器端：选出第一个支持的压缩算法，都不支持时不压缩
+    static Compression negotiateCompression(const QJsonArray &offered)
+    {
+        for (const QJsonValue &value : offered) {
+            Compression compression;
+            if (compressionFromName(value.toString(), compression))
+                return compression;
+        }
+        return Compression::None;
+    }
+
+    // 把一整帧（长度头+payload）追加到out末尾
+    // compressThreshold：payload不小于该字节数时尝试压缩，0 表示不压缩
+    static void appendFrame(QByteArray &out, const QJsonObject &message, Encoding encoding,
+                            Compression compression = Compression::None, qsizetype compressThreshold = 0)
+    {
+        // 先占好长度头的位置，消息直接编码到后面，最后回填长度
+        const qsizetype offset = out.size();
+        out.resize(offset + FrameDecoder::HeaderSize);
+        encodeInto(out, message, encoding);
+
+        quint32 header = static_cast<quint32>(out.size() - offset - FrameDecoder::HeaderSize);
+
+        if (compression == Compression::Zlib && compressThreshold > 0 && static_cast<qsizetype>(header) >= compressThreshold) {
+            const uchar *payload = reinterpret_cast<const uchar *>(out.constData() + offset + FrameDecoder::HeaderSize);
+            QByteArray packed = qCompress(payload, static_cast<qsizetype>(header), ZlibLevel);
+            // 压缩后没有变小就按原样发送
+            if (!packed.isEmpty() && packed.size() < static_cast<qsizetype>(header)) {
+                out.truncate(offset + FrameDecoder::HeaderSize);
+                out.append(packed);
+                header = static_cast<quint32>(packed.size()) | FrameDecoder::CompressedFlag;
+            }
+        }
+
+        qToBigEndian(header, reinterpret_cast<uchar *>(out.data() + offset));
+    }
+
+    // 解码FrameDecoder取出的一帧；maxSize限制解压后的长度（0 表示不限制），防止压缩炸弹
+    static bool decodeFrame(const QByteArray &payload, bool compressed, quint32 maxSize, QJsonObject &message)
+    {
+        if (!compressed)
+            return decode(payload, message);
+
+        // qCompress格式：[4字节大端原始长度][zlib数据]，先检查原始长度再解压
+        if (payload.size() < static_cast<qsizetype>(sizeof(quint32)))
+            return false;
+        const quint32 rawSize = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(payload.constData()));
+        if (maxSize > 0 && rawSize > maxSize)
+            return false;
+
+        QByteArray raw = qUncompress(payload);
+        if (raw.isEmpty())
+            return false;
+        return decode(raw, message);
+    }
+
+    // 把消息编码后追加到out末尾（不会清空out，方便直接写进发送缓冲）
+    static void encodeInto(QByteArray &out, const QJsonObject &message, Encoding encoding)
+    {
+        if (encoding == Encoding::Json) {
+            out.append(QJsonDocument(message).toJson(QJsonDocument::Compact));
+            return;
+        }
+
+        // 直接流式写出，不构造中间的QCborValue
+        QCborStreamWriter writer(&out);
+        writeObject(writer, message);
+    }
+
+    static QByteArray encode(const QJsonObject &message, Encoding encoding)
+    {
+        QByteArray out;
+        encodeInto(out, message, encoding);
+        return out;
+    }
+
+    // 按首字节判断编码并解码，payload不是一个对象时返回false
+    static bool decode(const QByteArray &payload, QJsonObject &message)
+    {
+        if (payload.isEmpty())
+            return false;
+
+        // 空白和BOM的字节都不可能是CBOR map的首字节，跳过它们不会把CBOR误判成JSON
+        const qsizetype start = jsonStart(payload);
+        if (start < payload.size() && payload.at(start) == '{') {
+            QJsonDocument doc = QJsonDocument::fromJson(
+                QByteArray::fromRawData(payload.constData() + start, payload.size() - start));
+            if (doc.isNull() || !doc.isObject())
+                return false;
+            message = doc.object();
+            return true;
+        }
+
+        QCborParserError error;
+        QCborValue value = QCborValue::fromCbor(payload, &error);
+        if (error.error != QCborError::NoError || !value.isMap())
+            return false;
+        message = value.toMap().toJsonObject();
+        return true;
+    }
+
+private:
+    // JSON文本第一个有效字符的位置：跳过UTF-8 BOM和RFC 8259允许的空白
+    static qsizetype jsonStart(const QByteArray &payload)
+    {
+        qsizetype pos = 0;
+        if (payload.startsWith("\xEF\xBB\xBF"))
+            pos = 3;
+        while (pos < payload.size()) {
+            const char c = payload.at(pos);
+            if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+                break;
+            ++pos;
+        }
+        return pos;
+    }
+
+    static void writeObject(QCborStreamWriter &writer, const QJsonObject &object)
+    {
+        writer.startMap(object.size());
+        for (auto it = object.constBegin(); it != object.constEnd(); ++it) {
+            writer.append(QStringView(it.key()));
+            writeValue(writer, it.value());
+        }
+        writer.endMap();
+    }
+
+    static void writeValue(QCborStreamWriter &writer, const QJsonValue &value)
+    {
+        switch (value.type()) {
+        case QJsonValue::Bool:
+            writer.append(value.toBool());
+            break;
+        case QJsonValue::Double: {
+            // 整数按CBOR整数写出（更短，解码后仍是整数）
+            const double d = value.toDouble();
+            const qint64 i = value.toInteger();
+            if (static_cast<double>(i) == d)
+                writer.append(i);
+            else
+                writer.append(d);
+            break;
+        }
+        case QJsonValue::String: {
+            const QString text = value.toString();
+            writer.append(QStringView(text));
+            break;
+        }
+        case QJsonValue::Array: {
+            const QJsonArray array = value.toArray();
+            writer.startArray(array.size());
+            for (const QJsonValue &element : array)
+                writeValue(writer, element);
+            writer.endArray();
+            break;
+        }
+        case QJsonValue::Object:
+            writeObject(writer, value.toObject());
+            break;
+        case QJsonValue::Null:
+        case QJsonValue::Undefined:
+            writer.appendNull();
+            break;
+        }
+    }
+};
+
+#endif // MESSAGE_CODEC_H
@@ -0,0 +1,75 @@
+/*
+该文件定义服务器的action注册表
+每个action在TcpServer构造时登记一次：处理函数、读/写类型、是否需要管理员权限、限流类别。
+handleRequest按action名字做一次哈希查找就能拿到处理函数和这些元数据，
+线程池、限流、统计等模块也都可以直接根据元数据做决定，不用再各自比较字符串。
+注册只在启动阶段（单线程）进行，之后注册表只读，可以在任意线程中查询；命中计数使用原子变量。
+*/
+#ifndef ACTION_REGISTRY_H
+#define ACTION_REGISTRY_H
+
+#include <QString>
+#include <QHash>
+#include <QList>
+#include <QJsonObject>
+#include <QAtomicInteger>
+#include <deque>
+
+class TcpServer;
+
+struct ActionSpec {
+    enum class Access {
+        Read,    // 只读数据库
+        Write,   // 会修改数据库
+        Journal, // 在内存库存上完成，修改追加到订单日志，由后台按顺序写回数据库（见booking_journal.h）；请求本身只读数据库
+        Memory   // 不访问数据库，只修改服务器进程内的状态（例如日志级别），不借数据库租约
+    };
+
+    // 限流类别：每个类别有自己的令牌桶预算（见rate_limiter.h），新增类别时加在Account之前
+    enum class RateClass {
+        Unlimited,  // 不限流（管理员接口）
+        Query,      // 查询类：查航班、查订单、订阅
+        Booking,    // 订票、退票
+        Account     // 注册、登录、修改资料
+    };
+
+    // 所有处理函数统一签名：输入请求中的data，返回完整响应
+    using Handler = QJsonObject (TcpServer::*)(const QJsonObject&);
+
+    QString name;
+    Handler handler{nullptr};
+    Access access{Access::Read};
+    bool requiresAdmin{false};
+    RateClass rateClass{RateClass::Unlimited};
+};
+
+class ActionRegistry
+{
+public:
+    // 登记一个action（只能在启动阶段调用），返回它的下标
+    int add(const ActionSpec& spec)
+    {
+        const int index = m_specs.size();
+        m_specs.append(spec);
+        m_hits.emplace_back(0);
+        m_index.insert(spec.name, index);
+        return index;
+    }
+
+    // 按名字查找，找不到返回-1
+    int indexOf(const QString& name) const { return m_index.value(name, -1); }
+
+    const ActionSpec& at(int index) const { return m_specs.at(index); }
+    int size() const { return m_specs.size(); }
+
+    void recordHit(int index) { m_hits[index].fetchAndAddRelaxed(1); }
+    quint64 hits(int index) const { return m_hits[index].loadRelaxed(); }
+
+private:
+    QHash<QString, int> m_index;
+    QList<ActionSpec> m_specs;
+    // QAtomicInteger不能拷贝/移动，用deque保证扩容时元素地址不变
+    std::deque<QAtomicInteger<quint64>> m_hits;
+};
+
+#endif // ACTION_REGISTRY_H
@@ -0,0 +1,236 @@
+#include "async_logger.h"
+#include <QThread>
+#include <QDateTime>
+#include <algorithm>
+#include <cstdio>
+
+QAtomicInt AsyncLogger::s_level{static_cast<int>(LogLevel::Info)};
+
+// 接管Qt消息前的处理函数，Fatal消息仍然交给它（需要同步输出并终止程序）
+static QtMessageHandler s_previousHandler = nullptr;
+
+static void qtMessageHandler(QtMsgType type, const QMessageLogContext& context, const QString& message)
+{
+    LogLevel level = LogLevel::Debug;
+    switch (type) {
+    case QtDebugMsg:    level = LogLevel::Debug; break;
+    case QtInfoMsg:     level = LogLevel::Info; break;
+    case QtWarningMsg:  level = LogLevel::Warning; break;
+    case QtCriticalMsg: level = LogLevel::Critical; break;
+    case QtFatalMsg:
+        AsyncLogger::instance().stop();
+        if (s_previousHandler)
+            s_previousHandler(type, context, message);
+        return;
+    }
+    if (AsyncLogger::enabled(level))
+        AsyncLogger::instance().log(level, message);
+}
+
+AsyncLogger& AsyncLogger::instance()
+{
+    static AsyncLogger logger;
+    return logger;
+}
+
+AsyncLogger::AsyncLogger()
+{
+    m_clock.start();
+    m_startEpochMs = QDateTime::currentMSecsSinceEpoch();
+}
+
+AsyncLogger::~AsyncLogger()
+{
+    stop();
+    qDeleteAll(m_rings);
+}
+
+AsyncLogger::RingHolder::~RingHolder()
+{
+    if (ring)
+        ring->retired.storeRelease(1);
+}
+
+QString AsyncLogger::levelName(LogLevel level)
+{
+    switch (level) {
+    case LogLevel::Debug:    return QStringLiteral("debug");
+    case LogLevel::Info:     return QStringLiteral("info");
+    case LogLevel::Warning:  return QStringLiteral("warning");
+    case LogLevel::Critical: return QStringLiteral("critical");
+    case LogLevel::Off:      break;
+    }
+    return QStringLiteral("off");
+}
+
+bool AsyncLogger::levelFromName(const QString& name, LogLevel& level)
+{
+    for (LogLevel candidate : {LogLevel::Debug, LogLevel::Info, LogLevel::Warning, LogLevel::Critical, LogLevel::Off}) {
+        if (name.compare(levelName(candidate), Qt::CaseInsensitive) == 0) {
+            level = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+void AsyncLogger::start()
+{
+    if (m_state.loadAcquire() != static_cast<int>(State::Buffering))
+        return;
+
+    m_state.storeRelease(static_cast<int>(State::Running));
+    m_writer = QThread::create([this]() { writerLoop(); });
+    m_writer->setObjectName(QStringLiteral("async-logger"));
+    m_writer->start(QThread::LowPriority);
+
+    s_previousHandler = qInstallMessageHandler(qtMessageHandler);
+}
+
+void AsyncLogger::stop()
+{
+    if (m_state.fetchAndStoreOrdered(static_cast<int>(State::Stopped)) == static_cast<int>(State::Stopped))
+        return;
+
+    if (m_writer) {
+        m_wake.wakeAll();
+        m_writer->wait();
+        delete m_writer;
+        m_writer = nullptr;
+    }
+    // 写线程退出后剩下的（以及从没start过时缓冲的）日志在这里写出
+    drainAll();
+    qInstallMessageHandler(s_previousHandler);
+}
+
+void AsyncLogger::log(LogLevel level, QString text)
+{
+    Record record{m_clock.nsecsElapsed(), level, std::move(text)};
+
+    if (m_state.loadAcquire() == static_cast<int>(State::Stopped)) {
+        writeOut(format(record, reinterpret_cast<quintptr>(QThread::currentThreadId())));
+        return;
+    }
+
+    Ring* ring = ringOfCurrentThread();
+    const quint32 tail = ring->tail.loadRelaxed();
+    if (tail - ring->head.loadAcquire() == Ring::Capacity) {
+        m_dropped.fetchAndAddRelaxed(1);
+        return;
+    }
+    ring->records[tail & (Ring::Capacity - 1)] = std::move(record);
+    ring->tail.storeRelease(tail + 1);
+
+    // 警告以上的日志尽快写出，其余的等定时写出
+    if (level >= LogLevel::Warning)
+        m_wake.wakeOne();
+}
+
+AsyncLogger::Ring* AsyncLogger::ringOfCurrentThread()
+{
+    thread_local RingHolder holder;
+    if (!holder.ring) {
+        Ring* ring = new Ring;
+        ring->threadId = reinterpret_cast<quintptr>(QThread::currentThreadId());
+        QMutexLocker locker(&m_ringsMutex);
+        m_rings.append(ring);
+        holder.ring = ring;
+    }
+    return holder.ring;
+}
+
+void AsyncLogger::writerLoop()
+{
+    while (m_state.loadAcquire() == static_cast<int>(State::Running)) {
+        drainAll();
+        QMutexLocker locker(&m_wakeMutex);
+        // 没有加锁唤醒，可能错过一次wakeOne，最多晚FlushIntervalMs写出
+        m_wake.wait(&m_wakeMutex, FlushIntervalMs);
+    }
+}
+
+void AsyncLogger::drainAll()
+{
+    QList<Ring*> rings;
+    {
+        QMutexLocker locker(&m_ringsMutex);
+        rings = m_rings;
+    }
+
+    struct Entry {
+        Record record;
+        quintptr threadId;
+    };
+    QList<Entry> entries;
+    QList<Ring*> finished;
+
+    for (Ring* ring : std::as_const(rings)) {
+        // 先看retired再读：看到retired之后所属线程不会再写入，读空就可以释放
+        const bool retired = ring->retired.loadAcquire();
+        quint32 head = ring->head.loadRelaxed();
+        const quint32 tail = ring->tail.loadAcquire();
+        for (; head != tail; ++head) {
+            Record& record = ring->records[head & (Ring::Capacity - 1)];
+            entries.append({std::move(record), ring->threadId});
+            record.text = QString();
+        }
+        ring->head.storeRelease(head);
+        if (retired)
+            finished.append(ring);
+    }
+
+    if (!finished.isEmpty()) {
+        QMutexLocker locker(&m_ringsMutex);
+        for (Ring* ring : std::as_const(finished))
+            m_rings.removeOne(ring);
+        qDeleteAll(finished);
+    }
+
+    const quint64 dropped = m_dropped.loadRelaxed();
+    if (entries.isEmpty() && dropped == m_reportedDropped)
+        return;
+
+    // 各线程的缓冲各自有序，合并后按时间排序
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const Entry& a, const Entry& b) { return a.record.timeNs < b.record.timeNs; });
+
+    QByteArray out;
+    for (const Entry& entry : std::as_const(entries))
+        out += format(entry.record, entry.threadId);
+    if (dropped != m_reportedDropped) {
+        out += format({m_clock.nsecsElapsed(), LogLevel::Warning,
+                       QStringLiteral("日志缓冲已满，丢弃了 %1 条日志").arg(dropped - m_reportedDropped)}, 0);
+        m_reportedDropped = dropped;
+    }
+    writeOut(out);
+}
+
+QByteArray AsyncLogger::format(const Record& record, quintptr threadId) const
+{
+    static const char levels[] = {'D', 'I', 'W', 'C', '-'};
+    const QDateTime time = QDateTime::fromMSecsSinceEpoch(m_startEpochMs + record.timeNs / 1000000);
+
+    QByteArray line = time.toString(QStringLiteral("yyyy-MM-dd hh:mm:ss.zzz")).toUtf8();
+    line += ' ';
+    line += levels[static_cast<int>(record.level)];
+    line += " [";
+    line += QByteArray::number(static_cast<qulonglong>(threadId), 16);
+    line += "] ";
+    line += record.text.toUtf8();
+    line += '\n';
+    return line;
+}
+
+void AsyncLogger::writeOut(const QByteArray& bytes)
+{
+    std::fwrite(bytes.constData(), 1, static_cast<size_t>(bytes.size()), stderr);
+    std::fflush(stderr);
+}
+
+LogLine::~LogLine()
+{
+    // QDebug在每个参数后面加空格，去掉最后一个
+    if (m_text.endsWith(QLatin1Char(' ')))
+        m_text.chop(1);
+    AsyncLogger::instance().log(m_level, std::move(m_text));
+}
@@ -0,0 +1,141 @@
+/*
+该文件实现服务器的异步日志
+热路径上原来直接用qDebug()打印整条请求/响应，即使没人看输出，也要在Reactor线程里格式化并同步写终端。
+现在所有日志都通过下面的LOG_*宏输出：
+  1. 级别低于当前日志级别时，整条语句（包括 << 后面的参数）都不会执行，只有一次比较的开销；
+  2. 需要输出时在调用线程里格式化成一行文字，放进该线程自己的环形缓冲（单生产者单消费者，无锁），
+     缓冲满了就丢弃并计数，绝不阻塞调用线程；
+  3. 后台写线程定期（或者遇到警告以上级别时立即）把所有线程的缓冲按时间顺序合并后一次写到标准错误。
+日志级别可以在运行时修改（启动参数 --log-level，或管理员接口 admin_set_log_level）。
+Qt自己输出的qDebug/qWarning等消息也会被接管，经过同样的级别过滤和异步写出。
+用法：LOG_INFO() << "新客户端连接:" << peer;
+*/
+#ifndef ASYNC_LOGGER_H
+#define ASYNC_LOGGER_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QDebug>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <array>
+
+class QThread;
+
+enum class LogLevel : int {
+    Debug,
+    Info,
+    Warning,
+    Critical,
+    Off
+};
+
+class AsyncLogger
+{
+public:
+    static AsyncLogger& instance();
+
+    // 热路径上的级别判断：一次原子读加一次比较
+    static bool enabled(LogLevel level) { return static_cast<int>(level) >= s_level.loadRelaxed(); }
+
+    static void setLevel(LogLevel level) { s_level.storeRelaxed(static_cast<int>(level)); }
+    static LogLevel level() { return static_cast<LogLevel>(s_level.loadRelaxed()); }
+    static QString levelName(LogLevel level);
+    static bool levelFromName(const QString& name, LogLevel& level);
+
+    // 启动后台写线程并接管Qt的消息输出；启动之前记录的日志会在启动后写出
+    void start();
+    // 写出剩余的日志并停止写线程，之后的日志直接同步写出（程序退出前调用）
+    void stop();
+
+    // 记录一条已经格式化好的日志（任意线程）
+    void log(LogLevel level, QString text);
+
+    // 因缓冲已满被丢弃的日志条数
+    quint64 dropped() const { return m_dropped.loadRelaxed(); }
+
+    ~AsyncLogger();
+
+private:
+    struct Record {
+        qint64 timeNs{0};       // m_clock
+        LogLevel level{LogLevel::Info};
+        QString text;
+    };
+
+    // 每个线程一个环形缓冲：只有所属线程写入（tail），只有写线程读取（head）
+    struct Ring {
+        static constexpr quint32 Capacity = 1024;   // 必须是2的幂
+        std::array<Record, Capacity> records;
+        QAtomicInteger<quint32> head{0};
+        QAtomicInteger<quint32> tail{0};
+        QAtomicInt retired{0};      // 所属线程已经退出，读空后由写线程释放
+        quintptr threadId{0};
+    };
+
+    // 线程退出时把自己的缓冲标记为retired
+    struct RingHolder {
+        Ring* ring{nullptr};
+        ~RingHolder();
+    };
+
+    enum class State {
+        Buffering,  // 还没有start()，先存进缓冲
+        Running,
+        Stopped     // stop()之后同步写出
+    };
+
+    static constexpr int FlushIntervalMs = 50;
+    static QAtomicInt s_level;
+
+    AsyncLogger();
+
+    QElapsedTimer m_clock;
+    qint64 m_startEpochMs{0};       // m_clock起点对应的时间（epoch毫秒），用于输出时间戳
+
+    QMutex m_ringsMutex;            // 只在线程第一次记录日志、写线程取缓冲列表时使用
+    QList<Ring*> m_rings;
+
+    QMutex m_wakeMutex;
+    QWaitCondition m_wake;
+    QAtomicInt m_state{static_cast<int>(State::Buffering)};
+    QThread* m_writer{nullptr};
+
+    QAtomicInteger<quint64> m_dropped{0};
+    quint64 m_reportedDropped{0};   // 仅写线程使用
+
+    Ring* ringOfCurrentThread();
+    void writerLoop();
+    // 把所有缓冲中的日志按时间排序后写出（只能在写线程中调用，stop()时写线程已结束也可以调用）
+    void drainAll();
+    QByteArray format(const Record& record, quintptr threadId) const;
+    void writeOut(const QByteArray& bytes);
+};
+
+// 收集一条日志：QDebug写进m_text，整条语句结束时（QDebug先析构）交给AsyncLogger
+class LogLine
+{
+public:
+    explicit LogLine(LogLevel level) : m_level(level) {}
+    ~LogLine();
+
+    QDebug stream() { return QDebug(&m_text); }
+
+private:
+    LogLevel m_level;
+    QString m_text;
+};
+
+// 级别不够时跳过整条语句（包括参数的求值与格式化）
+#define LOG_AT(level) \
+    if (!AsyncLogger::enabled(level)) {} else LogLine(level).stream()
+
+#define LOG_DEBUG()    LOG_AT(LogLevel::Debug)
+#define LOG_INFO()     LOG_AT(LogLevel::Info)
+#define LOG_WARN()     LOG_AT(LogLevel::Warning)
+#define LOG_CRITICAL() LOG_AT(LogLevel::Critical)
+
+#endif // ASYNC_LOGGER_H
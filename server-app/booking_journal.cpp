@@ -0,0 +1,606 @@
+#include "booking_journal.h"
+#include "database_manager.h"
+#include "async_logger.h"
+#include <QThread>
+#include <QDateTime>
+#include <utility>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// 写回失败（例如磁盘满、数据库被锁）后多久重试
+static constexpr int RETRY_DELAY_MS = 200;
+// 日志文件打不开时，后台线程多久重试一次（追加时也会重试）
+static constexpr int REOPEN_RETRY_MS = 1000;
+
+// SQLITE_CONSTRAINT：扩展错误码的低8位也是它
+static bool isConstraintError(const QSqlError& error)
+{
+    return (error.nativeErrorCode().toInt() & 0xff) == 19;
+}
+
+static int syncHandle(int handle)
+{
+#ifdef Q_OS_WIN
+    return _commit(handle);
+#else
+    return ::fsync(handle);
+#endif
+}
+
+static int duplicateHandle(int handle)
+{
+#ifdef Q_OS_WIN
+    return _dup(handle);
+#else
+    return ::dup(handle);
+#endif
+}
+
+static void closeHandle(int handle)
+{
+#ifdef Q_OS_WIN
+    _close(handle);
+#else
+    ::close(handle);
+#endif
+}
+
+BookingJournal::~BookingJournal()
+{
+    close();
+}
+
+bool BookingJournal::open(const QString& path, bool syncEachAppend)
+{
+    if (m_thread)
+        return true;
+    m_path = path;
+    m_applyingPath = path + ".applying";
+    m_syncEachAppend = syncEachAppend;
+
+    // 1. 重放上次没有写回的记录：*.applying 比日志文件早
+    // 此时内存库存还没有加载（之后从数据库加载），被拒绝的记录不需要再修正内存
+    QList<Entry> entries;
+    QList<Entry> rejected;
+    if (!readFile(m_applyingPath, entries) || !readFile(m_path, entries))
+        return false;
+    if (!entries.isEmpty()) {
+        if (!apply(entries, rejected)) {
+            LOG_CRITICAL() << "重放订单日志失败:" << m_path;
+            return false;
+        }
+        LOG_INFO() << "已重放订单日志中的" << entries.size() << "条记录，其中被拒绝" << rejected.size() << "条";
+    }
+    QFile::remove(m_applyingPath);
+    QFile::remove(m_path);
+
+    // 2. 订单号从数据库中的最大值继续分配
+    {
+        DatabaseLease lease(DatabaseManager::Role::Write);
+        CachedQuery query(Sql::BookingMaxId);
+        if (!query->exec() || !query->next()) {
+            LOG_CRITICAL() << "读取最大订单号失败:" << query->lastError().text();
+            return false;
+        }
+        m_lastBookingId = query->value(0).toInt();
+    }
+
+    // 3. 打开新的日志文件
+    m_file.setFileName(m_path);
+    m_fileSize = 0;
+    m_syncedSize = 0;
+    m_synced = 0;
+    m_withdrawn.clear();
+    if (!reopenFile())
+        return false;
+
+    m_stopping = false;
+    m_thread = QThread::create([this]() { run(); });
+    m_thread->setObjectName(QStringLiteral("booking-journal"));
+    m_thread->start();
+    LOG_INFO() << "订单日志:" << m_path << (m_syncEachAppend ? "（每次追加fsync）" : "（不fsync）");
+    return true;
+}
+
+void BookingJournal::close()
+{
+    if (!m_thread)
+        return;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        m_queued.wakeAll();
+    }
+    m_thread->wait();
+    delete m_thread;
+    m_thread = nullptr;
+
+    QMutexLocker locker(&m_mutex);
+    m_file.close();
+}
+
+int BookingJournal::book(int userId, int flightId)
+{
+    Entry entry;
+    entry.kind = 'B';
+    entry.userId = userId;
+    entry.flightId = flightId;
+    entry.bookingTime = QDateTime::currentDateTimeUtc().toString("yyyy-MM-dd HH:mm:ss");
+
+    quint64 seq = 0;
+    {
+        QMutexLocker locker(&m_mutex);
+        entry.bookingId = m_lastBookingId + 1;
+        if (!append(entry))
+            return 0;
+        m_lastBookingId = entry.bookingId;
+        seq = m_appended;
+        m_pending.insert(entry.bookingId, {flightId, false, seq, userId, entry.bookingTime});
+    }
+    // 没有落盘的订单已经撤销，调用方把座位还回去
+    if (m_syncEachAppend && !syncTo(seq))
+        return 0;
+    return entry.bookingId;
+}
+
+BookingJournal::CancelResult BookingJournal::cancel(int bookingId, int& flightId, QString& error)
+{
+    CancelResult result = CancelResult::Failed;
+    quint64 seq = 0;
+    for (;;) {
+        quint64 seen = 0;
+        {
+            QMutexLocker locker(&m_mutex);
+            auto it = m_pending.find(bookingId);
+            if (it != m_pending.end()) {
+                result = appendCancel(it, flightId, error, seq);
+                break;
+            }
+            seen = m_appended;
+        }
+
+        // 不在内存中的订单已经写回数据库。查询时不持锁，订票不需要等这次数据库读；
+        // Journal请求的读连接不开快照事务，每次查询读到的都是最新提交的数据
+        bool found = false;
+        bool cancelled = false;
+        int storedFlightId = 0;
+        {
+            CachedQuery query(Sql::CancelSelectBooking);
+            query->bindValue(":booking_id", bookingId);
+            if (!query->exec()) {
+                error = "订单查询失败：" + query->lastError().text();
+                return CancelResult::Failed;
+            }
+            found = query->next();
+            if (found) {
+                cancelled = query->value("status").toString() == "cancelled";
+                storedFlightId = query->value("flight_id").toInt();
+            }
+        }
+
+        QMutexLocker locker(&m_mutex);
+        auto it = m_pending.find(bookingId);
+        if (it != m_pending.end()) {
+            // 查询期间有人对这张订单退票
+            result = appendCancel(it, flightId, error, seq);
+            break;
+        }
+        // 查询期间后台线程写回了第一次检查之后追加的记录（其中可能有这张订单的退票），查询结果可能已经过时，重新查
+        if (m_applied > seen)
+            continue;
+        if (!found)
+            return CancelResult::NotFound;
+        if (cancelled)
+            return CancelResult::AlreadyCancelled;
+        it = m_pending.insert(bookingId, {storedFlightId, false, 0});
+        result = appendCancel(it, flightId, error, seq);
+        break;
+    }
+
+    if (result == CancelResult::Ok && m_syncEachAppend && !syncTo(seq)) {
+        error = "订单日志fsync失败";
+        return CancelResult::Failed;
+    }
+    return result;
+}
+
+QList<BookingJournal::PendingBooking> BookingJournal::pendingBookings() const
+{
+    QList<PendingBooking> result;
+    QMutexLocker locker(&m_mutex);
+    result.reserve(m_pending.size());
+    for (auto it = m_pending.constBegin(); it != m_pending.constEnd(); ++it) {
+        if (!it->rejected)
+            result.append({it.key(), it->userId, it->flightId, it->bookingTime, it->cancelled});
+    }
+    return result;
+}
+
+quint64 BookingJournal::appended() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_appended;
+}
+
+quint64 BookingJournal::applied() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_applied;
+}
+
+quint64 BookingJournal::batches() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_batches;
+}
+
+QByteArray BookingJournal::encode(const Entry& entry)
+{
+    if (entry.kind == 'B') {
+        return QString("B\t%1\t%2\t%3\t%4\n").arg(entry.bookingId).arg(entry.userId)
+                                              .arg(entry.flightId).arg(entry.bookingTime).toUtf8();
+    }
+    return QString("C\t%1\t%2\n").arg(entry.bookingId).arg(entry.flightId).toUtf8();
+}
+
+bool BookingJournal::decode(const QByteArray& line, Entry& entry)
+{
+    const QList<QByteArray> fields = line.split('\t');
+    bool ok = false;
+    if (fields.size() == 5 && fields[0] == "B") {
+        entry.kind = 'B';
+        entry.bookingId = fields[1].toInt(&ok);
+        entry.userId = fields[2].toInt();
+        entry.flightId = fields[3].toInt();
+        entry.bookingTime = QString::fromUtf8(fields[4]);
+    } else if (fields.size() == 3 && fields[0] == "C") {
+        entry.kind = 'C';
+        entry.bookingId = fields[1].toInt(&ok);
+        entry.flightId = fields[2].toInt();
+    }
+    return ok && entry.bookingId > 0 && entry.flightId > 0;
+}
+
+bool BookingJournal::readFile(const QString& path, QList<Entry>& entries)
+{
+    QFile file(path);
+    if (!file.exists())
+        return true;
+    if (!file.open(QIODevice::ReadOnly)) {
+        LOG_CRITICAL() << "读取订单日志失败:" << path << file.errorString();
+        return false;
+    }
+
+    const QByteArray content = file.readAll();
+    qsizetype start = 0;
+    for (;;) {
+        const qsizetype end = content.indexOf('\n', start);
+        if (end < 0)
+            break;
+        Entry entry;
+        if (decode(content.mid(start, end - start), entry))
+            entries.append(entry);
+        else
+            LOG_WARN() << "订单日志中有无法解析的记录，已跳过:" << path;
+        start = end + 1;
+    }
+    // 写入时中断（崩溃、磁盘满）留下的半行：这条记录没有确认给客户端
+    if (start < content.size())
+        LOG_WARN() << "订单日志末尾的记录不完整，已忽略:" << path;
+    return true;
+}
+
+bool BookingJournal::apply(const QList<Entry>& entries, QList<Entry>& rejected)
+{
+    rejected.clear();
+    DatabaseLease lease(DatabaseManager::Role::Write);
+    QSqlDatabase db = DatabaseManager::instance().database();
+    if (!db.transaction()) {
+        LOG_WARN() << "订单写回无法开启事务:" << db.lastError().text();
+        return false;
+    }
+
+    auto retryLater = [&](const QSqlError& error) {
+        LOG_WARN() << "订单写回失败，稍后重试:" << error.text();
+        db.rollback();
+        return false;
+    };
+
+    for (const Entry& entry : entries) {
+        // 订单行和余票一起写回：任何一步失败都回滚到这条记录之前
+        CachedQuery savepoint(Sql::JournalSavepoint);
+        if (!savepoint->exec())
+            return retryLater(savepoint->lastError());
+
+        const bool isBooking = entry.kind == 'B';
+        bool ok = true;
+        QSqlError error;
+        {
+            // 写回是幂等的：重放时已经写回过的记录不会再改动余票
+            CachedQuery change(isBooking ? Sql::JournalInsertBooking : Sql::JournalCancelBooking);
+            change->bindValue(":booking_id", entry.bookingId);
+            if (isBooking) {
+                change->bindValue(":user_id", entry.userId);
+                change->bindValue(":flight_id", entry.flightId);
+                change->bindValue(":booking_time", entry.bookingTime);
+            }
+            ok = change->exec();
+            if (!ok) {
+                error = change->lastError();
+            } else if (change->numRowsAffected() > 0) {
+                CachedQuery seats(isBooking ? Sql::JournalTakeSeat : Sql::JournalReturnSeat);
+                seats->bindValue(":flight_id", entry.flightId);
+                ok = seats->exec();
+                if (!ok)
+                    error = seats->lastError();
+            }
+        }
+
+        if (!ok) {
+            CachedQuery rollback(Sql::JournalRollbackTo);
+            rollback->exec();
+            CachedQuery release(Sql::JournalRelease);
+            release->exec();
+            // 约束错误（例如订单引用的用户或航班不存在）重试也不会成功，撤销这条记录；其他错误整批重来
+            if (!isConstraintError(error))
+                return retryLater(error);
+            LOG_WARN() << "订单写回被约束拒绝，已撤销:" << entry.kind << entry.bookingId << error.text();
+            rejected.append(entry);
+            continue;
+        }
+
+        CachedQuery release(Sql::JournalRelease);
+        if (!release->exec())
+            return retryLater(release->lastError());
+    }
+
+    if (!db.commit()) {
+        LOG_WARN() << "订单写回提交失败，稍后重试:" << db.lastError().text();
+        db.rollback();
+        return false;
+    }
+    return true;
+}
+
+// 持有m_mutex
+BookingJournal::CancelResult BookingJournal::appendCancel(QHash<int, Pending>::iterator it, int& flightId,
+                                                          QString& error, quint64& seq)
+{
+    if (it->cancelled)
+        return CancelResult::AlreadyCancelled;
+
+    Entry entry;
+    entry.kind = 'C';
+    entry.bookingId = it.key();
+    entry.flightId = it->flightId;
+    entry.previousSeq = it->lastSeq;
+    if (!append(entry)) {
+        if (it->lastSeq == 0)
+            m_pending.erase(it);
+        error = "订单日志不可用";
+        return CancelResult::Failed;
+    }
+    flightId = entry.flightId;
+    seq = m_appended;
+    it->cancelled = true;
+    it->lastSeq = seq;
+    return CancelResult::Ok;
+}
+
+// 持有m_mutex
+bool BookingJournal::append(Entry entry)
+{
+    // 上次写失败或者换文件时没能打开：在这里重新打开，不用等后台线程
+    if (!m_file.isOpen() && !reopenFile())
+        return false;
+
+    const QByteArray line = encode(entry);
+    if (m_file.write(line) != line.size()) {
+        LOG_WARN() << "写订单日志失败:" << m_file.errorString();
+        // 可能留下了半行：截掉它；截不掉就关闭文件，重新打开时再截，半行之后不会再追加记录
+        if (!m_file.resize(m_fileSize))
+            m_file.close();
+        return false;
+    }
+    m_fileSize += line.size();
+    entry.seq = ++m_appended;
+    m_queue.append(entry);
+    m_queued.wakeOne();
+    return true;
+}
+
+// 持有m_mutex
+bool BookingJournal::reopenFile()
+{
+    // 不经过QFile的缓冲，write返回时数据已经交给操作系统
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered)) {
+        LOG_WARN() << "打开订单日志失败:" << m_path << m_file.errorString();
+        return false;
+    }
+    if (m_file.size() > m_fileSize && !m_file.resize(m_fileSize)) {
+        LOG_WARN() << "截断订单日志失败:" << m_path << m_file.errorString();
+        m_file.close();
+        return false;
+    }
+    m_fileSize = m_file.size();
+    m_syncedSize = qMin(m_syncedSize, m_fileSize);
+    return true;
+}
+
+// 持有m_syncMutex和m_mutex
+void BookingJournal::withdrawUnsynced(QList<std::pair<int, int>>& corrections)
+{
+    // m_synced之后的记录都还在队列里：换文件之前要先fsync，换文件也要持有m_syncMutex
+    // 从后往前撤销，同一张订单的退票先于订票恢复
+    while (!m_queue.isEmpty() && m_queue.constLast().seq > m_synced) {
+        const Entry entry = m_queue.takeLast();
+        m_withdrawn.insert(entry.seq);
+        auto it = m_pending.find(entry.bookingId);
+        if (it == m_pending.end())
+            continue;
+        if (entry.kind == 'C' && it->rejected) {
+            // 订票已经被数据库拒绝，座位留给这次退票还；退票撤销了，这里补回
+            corrections.append({entry.flightId, 1});
+        }
+        // 撤销订票，或者撤销退票后订单已经没有要写回的记录
+        if (entry.kind == 'B' || entry.previousSeq <= m_applied) {
+            m_pending.erase(it);
+        } else {
+            it->cancelled = false;
+            it->lastSeq = entry.previousSeq;
+        }
+    }
+
+    // 文件中只留下已经落盘的部分，崩溃后重放时不会出现回复过失败的记录
+    m_fileSize = m_syncedSize;
+    if (m_file.isOpen() && !m_file.resize(m_fileSize)) {
+        LOG_WARN() << "截断订单日志失败:" << m_path << m_file.errorString();
+        m_file.close();
+    }
+}
+
+// 组fsync：排队等锁的线程拿到锁时，前一个线程的fsync通常已经覆盖了它们的记录
+bool BookingJournal::syncTo(quint64 seq)
+{
+    QList<std::pair<int, int>> corrections;
+    {
+        QMutexLocker syncLocker(&m_syncMutex);
+        if (m_withdrawn.remove(seq))
+            return false;
+        if (m_synced >= seq)
+            return true;
+
+        quint64 target = 0;
+        qint64 targetSize = 0;
+        int handle = -1;
+        {
+            QMutexLocker locker(&m_mutex);
+            if (m_file.isOpen() || reopenFile()) {
+                target = m_appended;
+                targetSize = m_fileSize;
+                // fsync时不持有m_mutex，append在这期间可能关闭m_file：用复制的句柄
+                handle = duplicateHandle(m_file.handle());
+            }
+        }
+        // 持有m_syncMutex时后台线程不会换文件，复制的句柄对应的就是当前文件
+        const bool synced = handle >= 0 && syncHandle(handle) == 0;
+        if (handle >= 0)
+            closeHandle(handle);
+
+        QMutexLocker locker(&m_mutex);
+        if (synced) {
+            m_synced = target;
+            m_syncedSize = targetSize;
+            return true;
+        }
+        LOG_WARN() << "订单日志fsync失败，撤销还没落盘的记录:" << m_path;
+        withdrawUnsynced(corrections);
+        m_withdrawn.remove(seq);
+    }
+    if (m_onRejected) {
+        for (const auto& [flightId, seatDelta] : std::as_const(corrections))
+            m_onRejected(flightId, seatDelta);
+    }
+    return false;
+}
+
+void BookingJournal::run()
+{
+    for (;;) {
+        {
+            QMutexLocker locker(&m_mutex);
+            while (m_queue.isEmpty() && !m_stopping) {
+                if (m_file.isOpen()) {
+                    m_queued.wait(&m_mutex);
+                } else {
+                    // 日志文件打不开（写失败后关闭、换文件时打开失败）：定时重试
+                    m_queued.wait(&m_mutex, REOPEN_RETRY_MS);
+                    if (!m_file.isOpen() && !m_stopping)
+                        reopenFile();
+                }
+            }
+            if (m_queue.isEmpty())
+                break;
+        }
+
+        // 换文件：排队中的记录都在当前文件里，把它改名为 *.applying，之后的追加写进新文件
+        QList<Entry> batch;
+        quint64 lastSeq = 0;
+        QList<std::pair<int, int>> corrections;
+        {
+            QMutexLocker syncLocker(&m_syncMutex);
+            QMutexLocker locker(&m_mutex);
+            // 还没fsync的记录在这里fsync，失败时撤销（追加它们的线程还在等syncTo）
+            if (m_syncEachAppend && m_synced < m_appended) {
+                if ((m_file.isOpen() || reopenFile()) && syncHandle(m_file.handle()) == 0) {
+                    m_synced = m_appended;
+                } else {
+                    LOG_WARN() << "订单日志fsync失败，撤销还没落盘的记录:" << m_path;
+                    withdrawUnsynced(corrections);
+                }
+            }
+            m_file.close();
+            if (QFile::rename(m_path, m_applyingPath))
+                m_fileSize = 0;
+            else
+                LOG_WARN() << "订单日志改名失败，写回后保留原文件:" << m_path;
+            m_synced = m_appended;
+            m_syncedSize = m_fileSize;
+            if (!reopenFile())
+                LOG_CRITICAL() << "重新打开订单日志失败，稍后重试:" << m_path;
+            batch.swap(m_queue);
+            lastSeq = m_appended;
+        }
+
+        // 失败时稍后重试；停止时还没成功就放弃，文件留给下次启动重放
+        QList<Entry> rejected;
+        bool applied = apply(batch, rejected);
+        while (!applied) {
+            {
+                QMutexLocker locker(&m_mutex);
+                if (m_stopping)
+                    break;
+            }
+            QThread::msleep(RETRY_DELAY_MS);
+            applied = apply(batch, rejected);
+        }
+        if (!applied)
+            break;
+        QFile::remove(m_applyingPath);
+
+        // 被拒绝的记录已经回复过客户端，也已经改过内存库存：按m_pending中订单的最新状态算出要补回的座位
+        {
+            QMutexLocker locker(&m_mutex);
+            m_applied = lastSeq;
+            ++m_batches;
+            for (const Entry& entry : std::as_const(rejected)) {
+                auto it = m_pending.find(entry.bookingId);
+                if (entry.kind == 'B') {
+                    // 订单没有写进数据库，座位还回去；已经退过票的订单退票时已经还过了
+                    if (it == m_pending.end() || !it->cancelled)
+                        corrections.append({entry.flightId, 1});
+                    if (it != m_pending.end())
+                        it->rejected = true;
+                } else {
+                    // 退票没有写进数据库，订单仍然有效：退票时还回去的座位重新扣掉
+                    corrections.append({entry.flightId, -1});
+                    if (it != m_pending.end())
+                        it->cancelled = false;
+                }
+            }
+            for (const Entry& entry : std::as_const(batch)) {
+                auto it = m_pending.find(entry.bookingId);
+                if (it != m_pending.end() && it->lastSeq <= lastSeq)
+                    m_pending.erase(it);
+            }
+        }
+        if (m_onRejected) {
+            for (const auto& [flightId, seatDelta] : std::as_const(corrections))
+                m_onRejected(flightId, seatDelta);
+        }
+    }
+}
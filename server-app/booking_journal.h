@@ -0,0 +1,151 @@
+/*
+该文件实现订单日志（write-behind）
+订票、退票不再在请求里写数据库：余票在内存库存（seat_inventory.h）上扣减之后，
+订单以一行文本追加到数据库旁边的日志文件里就算成功，后台线程再按日志的顺序把它们成批写回SQLite。
+  1. 日志是只追加的顺序文件：durable/legacy参数组合（synchronous=FULL）下每次追加都fsync（同时到达的追加共用一次fsync），
+     fast下只写到操作系统，与WAL + synchronous=NORMAL的保证相同（进程崩溃不丢，断电可能丢最近的几条）；
+     fsync失败时还没落盘的记录全部从文件（截断）和写回队列中撤销，这些订票/退票返回失败；
+     写失败留下的半行同样截掉，截不掉就关闭文件，之后的追加和后台线程都会重新打开，不需要重启服务；
+  2. 订单号在内存中分配（启动时取数据库中的最大值），客户端立即拿到booking_id；
+  3. 后台线程每轮把当前日志换成 *.applying，开一个事务写回其中的所有记录，提交后删除该文件；
+  4. 写回是幂等的（按booking_id插入或忽略、只取消confirmed的订单，余票随之加减），
+     启动时先重放残留的 *.applying 和日志文件，再从数据库加载内存库存，所以崩溃后不会丢单，也不会重复扣座位；
+  5. 每条记录的订单行和余票在一个保存点里写回。被约束拒绝（重试也不会成功）的记录整条撤销，
+     再通过setOnRejected登记的回调把它在内存库存上的修改撤销，内存和数据库不会不一致。
+还没写回的订单记在内存里，退票先查这里，不在内存里的再（不持锁）查数据库；
+查询订单的接口不等待写回，而是把pendingBookings()合并进数据库的查询结果，所以能立即看到刚下的单和刚退的票。
+*/
+#ifndef BOOKING_JOURNAL_H
+#define BOOKING_JOURNAL_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QSet>
+#include <QWaitCondition>
+#include <functional>
+#include <utility>
+
+class QThread;
+
+class BookingJournal
+{
+public:
+    enum class CancelResult {
+        Ok,
+        NotFound,
+        AlreadyCancelled,
+        Failed
+    };
+
+    // 一张还没完全写回数据库的订单
+    struct PendingBooking {
+        int bookingId{0};
+        int userId{0};          // 订票记录已经写回、只有退票还没写回时为0（订单行已经在数据库里）
+        int flightId{0};
+        QString bookingTime;    // 同上，为空
+        bool cancelled{false};
+    };
+
+    BookingJournal() = default;
+    ~BookingJournal();
+
+    BookingJournal(const BookingJournal&) = delete;
+    BookingJournal& operator=(const BookingJournal&) = delete;
+
+    // open之前设置：记录被数据库拒绝时在后台线程中调用，seatDelta是要在内存库存上补回的座位数
+    // （订票被拒绝时为1，退票被拒绝时为-1；已经退票的订单被拒绝时退票已经还过座位，不再调用）
+    // 这样的订单的退票因为fsync失败被撤销时，退票时没有还的座位也通过它补回（在fsync的线程中调用）
+    void setOnRejected(std::function<void(int flightId, int seatDelta)> onRejected) { m_onRejected = std::move(onRejected); }
+
+    // 启动时在主线程调用：重放上次没有写回的日志、确定下一个订单号，然后开始接收新的记录
+    // syncEachAppend为true时每次追加都fsync
+    bool open(const QString& path, bool syncEachAppend);
+    // 写回所有已经追加的记录后停止后台线程
+    void close();
+    bool isOpen() const { return m_thread != nullptr; }
+
+    // 任意线程：记录一张新订单（座位已经在内存库存上扣过），返回订单号；日志不可用时返回0
+    int book(int userId, int flightId);
+    // 任意线程：记录一次退票，成功时flightId为订单所属的航班（调用方负责归还座位）
+    CancelResult cancel(int bookingId, int& flightId, QString& error);
+    // 任意线程：当前还没写回的订单（被数据库拒绝的订票不包括在内）
+    // 要在查询数据库之前调用：之后才写回的订单两边都有，按booking_id以数据库的行为准、再用这里的退票状态修正
+    QList<PendingBooking> pendingBookings() const;
+
+    quint64 appended() const;
+    quint64 applied() const;
+    quint64 batches() const;
+
+private:
+    struct Entry {
+        char kind{0};           // 'B'：订票，'C'：退票
+        int bookingId{0};
+        int userId{0};
+        int flightId{0};
+        QString bookingTime;    // 与 CURRENT_TIMESTAMP 格式相同的UTC时间
+        quint64 seq{0};         // 记录的序号（这一项和下一项只在内存中，不写进文件）
+        quint64 previousSeq{0}; // 退票记录：追加之前订单的lastSeq，撤销时恢复
+    };
+
+    // 还没写回数据库的订单（以及已经写回、但退票还没写回的订单）
+    struct Pending {
+        int flightId{0};
+        bool cancelled{false};
+        quint64 lastSeq{0};     // 最后一条相关记录的序号，写回到这里之后移除
+        int userId{0};          // 以下两项只有订票记录还没写回时才有
+        QString bookingTime;
+        bool rejected{false};   // 订票记录被数据库拒绝（等它之后的退票记录写回后移除）
+    };
+
+    static QByteArray encode(const Entry& entry);
+    static bool decode(const QByteArray& line, Entry& entry);
+    // 把一个日志文件中的所有完整记录追加到entries（最后一行不完整时忽略），文件存在但读不出来时返回false
+    static bool readFile(const QString& path, QList<Entry>& entries);
+    // 在当前线程的写连接上用一个事务写回一批记录，被约束拒绝的记录放进rejected
+    static bool apply(const QList<Entry>& entries, QList<Entry>& rejected);
+
+    // 以下需要持有m_mutex
+    bool append(Entry entry);
+    // 打开日志文件并截掉m_fileSize之后的内容（写失败留下的半行、撤销的记录）
+    bool reopenFile();
+    // 为m_pending中的订单追加一条退票记录，成功时seq为这条记录的序号
+    CancelResult appendCancel(QHash<int, Pending>::iterator it, int& flightId, QString& error, quint64& seq);
+
+    // 需要同时持有m_syncMutex和m_mutex：fsync失败后撤销m_synced之后的所有记录，
+    // 要在内存库存上补回的座位放进corrections
+    void withdrawUnsynced(QList<std::pair<int, int>>& corrections);
+
+    // 返回false时这条记录没有落盘，已经被撤销
+    bool syncTo(quint64 seq);
+    void run();
+
+    QString m_path;
+    QString m_applyingPath;
+    bool m_syncEachAppend{false};
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_queued;        // 有新记录，或者要停止
+    QFile m_file;
+    qint64 m_fileSize{0};           // 文件中完整记录的字节数
+    QList<Entry> m_queue;
+    QHash<int, Pending> m_pending;
+    int m_lastBookingId{0};
+    quint64 m_appended{0};
+    quint64 m_applied{0};
+    quint64 m_batches{0};
+    bool m_stopping{false};
+
+    QMutex m_syncMutex;             // 一次只有一个线程fsync；换文件、撤销记录时也要持有（先于m_mutex加锁）
+    quint64 m_synced{0};            // 以下三项由m_syncMutex保护（修改时同时持有m_mutex）：已经落盘的最后一条记录
+    qint64 m_syncedSize{0};         // 落盘的部分在当前文件中的字节数
+    QSet<quint64> m_withdrawn;      // 已经撤销、追加它的线程还没在syncTo中取走结果的记录
+
+    QThread* m_thread{nullptr};
+    std::function<void(int, int)> m_onRejected;
+};
+
+#endif // BOOKING_JOURNAL_H
@@ -0,0 +1,663 @@
+#include "client_reactor.h"
+#include "tcp_server.h"
+#include "async_logger.h"
+#include <utility>
+
+// 时间轮：100ms一个tick，512个槽（转一圈约51秒，更长的定时器记录圈数）
+static constexpr int TimerTickMs = 100;
+static constexpr int TimerSlots = 512;
+
+// 无效帧只记录长度和开头这么多字节（十六进制）：整帧可能有1MiB，也可能带着密码
+static constexpr qsizetype InvalidFrameLogBytes = 64;
+
+ClientReactor::ClientReactor(TcpServer *server, int index)
+    : QObject(nullptr), m_server(server), m_index(index), m_timers(TimerSlots, TimerTickMs)
+{
+    // QTimer作为子对象会随Reactor一起moveToThread，但要在Reactor线程里启动（见addConnection）
+    m_tickTimer = new QTimer(this);
+    m_tickTimer->setInterval(TimerTickMs);
+    connect(m_tickTimer, &QTimer::timeout, this, &ClientReactor::onTick);
+    m_clock.start();
+}
+
+// 接管新的客户端连接
+void ClientReactor::addConnection(qintptr socketDescriptor)
+{
+    // 传输层要在Reactor线程中创建（epoll实现的QSocketNotifier属于创建它的线程）
+    if (!m_transport)
+        m_transport = Transport::create(m_server->transportKind(), this, this);
+
+    Connection* connection = m_transport->adopt(socketDescriptor);
+    if (!connection)
+        return;
+    LOG_INFO() << "新客户端连接:" << connection->peerAddress().toString() << "Reactor:" << m_index;
+
+    if (!m_tickTimer->isActive())
+        m_tickTimer->start();
+
+    ClientInfo info;
+    info.decoder.setMaxFrameSize(m_server->maxFrameSize());
+    info.gauges = m_server->connections().add(m_index, connection->peerAddress().toString());
+    info.lastActivityMs = m_clock.elapsed();
+
+    // 在规定时间内没有发送tag则断开连接
+    if (m_server->handshakeTimeoutMs() > 0)
+        info.handshakeTimer = m_timers.arm(m_server->handshakeTimeoutMs(), {connection, TimerKind::Handshake, 0});
+    // 长时间没有收到任何数据则回收连接
+    if (m_server->idleTimeoutMs() > 0)
+        info.idleTimer = m_timers.arm(m_server->idleTimeoutMs(), {connection, TimerKind::Idle, 0});
+
+    // 之后连接上的数据、断开、写出进度都由传输层回调onConnectionReadable等函数
+    clients.insert(connection, info);
+}
+
+// 时间轮前进一格
+void ClientReactor::onTick()
+{
+    m_timers.advance([this](const TimerEvent& event) { onTimerExpired(event); });
+}
+
+void ClientReactor::onTimerExpired(const TimerEvent& event)
+{
+    // 断开时会取消所有定时器，这里只是防御
+    auto it = clients.find(event.connection);
+    if (it == clients.end())
+        return;
+
+    Connection* connection = event.connection;
+    ClientInfo &info = *it;
+
+    switch (event.kind) {
+    case TimerKind::Handshake:
+        info.handshakeTimer = Timers::InvalidTimer;
+        if (info.tag.isEmpty()) {
+            LOG_WARN() << "客户端未在规定时间内发送tag，断开连接:" << connection->peerAddress().toString();
+            connection->close();
+        }
+        break;
+
+    case TimerKind::Idle: {
+        info.idleTimer = Timers::InvalidTimer;
+        // 收到数据时只更新时间戳，不重新挂定时器；到期时再检查，没到真正的期限就按剩余时间重挂
+        const qint64 idleFor = m_clock.elapsed() - info.lastActivityMs;
+        const qint64 timeout = m_server->idleTimeoutMs();
+        if (idleFor < timeout) {
+            info.idleTimer = m_timers.arm(timeout - idleFor, {connection, TimerKind::Idle, 0});
+        } else {
+            LOG_INFO() << "连接空闲超时，断开:" << info.tag << connection->peerAddress().toString();
+            connection->close();
+        }
+        break;
+    }
+
+    case TimerKind::Request: {
+        auto req = info.inFlight.find(event.requestSeq);
+        if (req == info.inFlight.end())
+            return;
+
+        // 工作线程仍在处理，结果回来时会因为找不到记录而被丢弃
+        QJsonObject timeout{{"status", "error"},
+                            {"message", "请求处理超时"},
+                            {"data", QJsonValue()},
+                            {"action", req->action}};
+        if (!req->requestId.isUndefined())
+            timeout["request_id"] = req->requestId;
+        const bool ordered = req->ordered;
+        const quint64 traceId = req->traceId;
+        info.inFlight.erase(req);
+
+        LOG_WARN() << "请求处理超时:" << timeout["action"].toString() << "客户端:" << info.tag;
+        sendResponse(connection, timeout, traceId);
+        finishInFlight(connection, ordered);
+        break;
+    }
+    }
+}
+
+void ClientReactor::cancelTimers(ClientInfo& info)
+{
+    m_timers.cancel(info.handshakeTimer);
+    m_timers.cancel(info.idleTimer);
+    for (const InFlightRequest& req : std::as_const(info.inFlight))
+        m_timers.cancel(req.deadline);
+    info.handshakeTimer = info.idleTimer = Timers::InvalidTimer;
+    info.inFlight.clear();
+}
+
+// 处理客户端发送的数据
+void ClientReactor::onConnectionReadable(Connection* connection)
+{
+    processIncoming(connection);
+}
+
+void ClientReactor::processIncoming(Connection* connection)
+{
+    auto it = clients.find(connection);
+    // 暂停期间不读数据：数据留在内核缓冲里，由TCP流控限制对端继续发送
+    if (it == clients.end() || it->readPaused)
+        return;
+
+    ClientInfo &info = *it;
+
+    // 追加收到的数据到缓冲
+    const QByteArray data = connection->readAll();
+    if (!data.isEmpty()) {
+        info.lastActivityMs = m_clock.elapsed();
+        info.gauges->bytesIn.fetchAndAddRelaxed(data.size());
+        info.gauges->touch();
+    }
+    info.decoder.append(data);
+
+    // 循环解析，可能一次解析多条消息；处理过程中如果触发了背压就停下，剩余的帧留在缓冲里
+    QByteArray frame;
+    bool compressed = false;
+    while (!info.readPaused) {
+        FrameDecoder::Status status = info.decoder.next(frame, &compressed);
+        if (status == FrameDecoder::Status::NeedMore)
+            break;
+
+        if (status == FrameDecoder::Status::Oversized) {
+            // 在缓冲整帧之前就拒绝，避免一个客户端占用大量内存
+            LOG_WARN() << "帧长度超过上限，断开连接:" << connection->peerAddress().toString()
+                       << "长度:" << info.decoder.pendingFrameSize();
+            QJsonObject error{{"status", "error"}, {"message", "Frame too large"}};
+            sendResponse(connection, error);
+            info.decoder.clear();
+            flushConnection(connection);
+            connection->close();
+            return;
+        }
+
+        // 解码（JSON或CBOR，按首字节区分；带压缩标志的先解压，解压后同样受单帧上限约束）
+        QJsonObject request;
+        const qint64 parseStartNs = m_clock.nsecsElapsed();
+        if (!MessageCodec::decodeFrame(frame, compressed, m_server->maxFrameSize(), request)) {
+            LOG_WARN() << "收到无效的消息格式:" << connection->peerAddress().toString()
+                       << "长度:" << frame.size()
+                       << "开头:" << frame.first(qMin(frame.size(), InvalidFrameLogBytes)).toHex(' ');
+            QJsonObject error{{"status", "error"}, {"message", "Invalid JSON format"}};
+            sendResponse(connection, error);
+            continue; // 继续处理后续帧
+        }
+
+        LOG_DEBUG() << "解析请求:" << request;
+
+        const qint64 parseUs = (m_clock.nsecsElapsed() - parseStartNs) / 1000;
+        ServerStats::ActionStats& stats = m_server->stats().of(m_server->actions().indexOf(request.value("action").toString()));
+        stats.phase(ServerStats::Phase::Parse).record(parseUs);
+        stats.bytesIn.fetchAndAddRelaxed(frame.size() + FrameDecoder::HeaderSize);
+
+        // 首次解析tag
+        if (info.tag.isEmpty())
+        {
+            if (!request.contains("tag") || !request["tag"].isString()) {
+                QJsonObject error{{"status", "error"}, {"message", "Missing or invalid tag"}};
+                sendResponse(connection, error);
+                flushConnection(connection);
+                connection->close();
+                return;
+            }
+
+            QString tag = request["tag"].toString();
+
+            // 检查 tag 是否重复并绑定（tag在所有Reactor之间共享，由连接注册表按tag索引）
+            if (!m_server->connections().claimTag(info.gauges, tag)) {
+                QJsonObject error{{"status", "error"}, {"message", "Tag already in use"}};
+                sendResponse(connection, error);
+                flushConnection(connection);
+                connection->close();
+                return;
+            }
+
+            // 绑定 tag
+            info.tag = tag;
+            m_timers.cancel(info.handshakeTimer);
+            info.handshakeTimer = Timers::InvalidTimer;
+            LOG_INFO() << "客户端注册tag成功:" << tag;
+
+            // 协商编码：客户端按偏好列出支持的编码，旧客户端不带这个字段，继续使用json
+            MessageCodec::Encoding encoding = MessageCodec::negotiate(request["encodings"].toArray());
+            // 服务器关闭了压缩（阈值为0）时不同意任何压缩算法
+            MessageCodec::Compression compression = m_server->compressThreshold() > 0
+                ? MessageCodec::negotiateCompression(request["compressions"].toArray())
+                : MessageCodec::Compression::None;
+
+            // 回复注册成功（这条响应本身仍用json，客户端收到后再切换）
+            QJsonObject success{{"status", "success"},
+                                {"message", "Tag registered"},
+                                {"protocol", MessageCodec::ProtocolVersion},
+                                {"encoding", MessageCodec::name(encoding)},
+                                {"compression", MessageCodec::compressionName(compression)}};
+            sendResponse(connection, success);
+            info.encoding = encoding;
+            info.compression = compression;
+            LOG_INFO() << "协商编码:" << MessageCodec::name(encoding)
+                    << "压缩:" << MessageCodec::compressionName(compression)
+                    << "客户端协议版本:" << request["protocol"].toInt(0);
+            continue;
+        }
+
+        // 按采样率决定是否追踪这条请求，被选中时先补记解码的span
+        const quint64 traceId = RequestTracer::instance().sample();
+        if (traceId) {
+            const qint64 nowUs = RequestTracer::instance().nowUs();
+            RequestTracer::instance().record(traceId, "parse", nowUs - parseUs, nowUs, request.value("action").toString());
+        }
+
+        // 解析正常业务
+        dispatchRequest(connection, request, traceId);
+    }
+
+    info.gauges->inboundBytes.storeRelaxed(info.decoder.available() + connection->bytesAvailable());
+}
+
+// 当客户端断开连接时
+void ClientReactor::onConnectionClosed(Connection* connection)
+{
+    auto it = clients.find(connection);
+    if (it != clients.end()) {
+        LOG_INFO() << "客户端断开连接: " << it->tag;
+        m_server->connections().remove(it->gauges);
+        cancelTimers(*it);
+        clearSubscriptions(connection, *it);
+        clients.erase(it);
+    }
+
+    connection->deleteLater();
+}
+
+// 用来发送JSON响应的辅助函数：只追加到发送缓冲，真正的write在flushPending中进行
+void ClientReactor::sendResponse(Connection* connection, const QJsonObject& response, quint64 traceId)
+{
+    auto it = clients.find(connection);
+    if (it == clients.end())
+        return;
+
+    ClientInfo &info = *it;
+
+    // 整帧（长度头+编码后的消息，超过阈值时压缩）直接写进发送缓冲
+    const qint64 serializeStartNs = m_clock.nsecsElapsed();
+    const qsizetype bufferedBefore = info.sendBuf.size();
+    MessageCodec::appendFrame(info.sendBuf, response, info.encoding, info.compression, m_server->compressThreshold());
+    const qint64 queuedNs = m_clock.nsecsElapsed();
+
+    const int actionIndex = m_server->actions().indexOf(response.value("action").toString());
+    ServerStats::ActionStats& stats = m_server->stats().of(actionIndex);
+    stats.phase(ServerStats::Phase::Serialize).record((queuedNs - serializeStartNs) / 1000);
+    stats.requests.fetchAndAddRelaxed(1);
+    if (response.value("status").toString() == QLatin1String("error"))
+        stats.errors.fetchAndAddRelaxed(1);
+    stats.bytesOut.fetchAndAddRelaxed(info.sendBuf.size() - bufferedBefore);
+    qint64 traceQueuedUs = 0;
+    if (traceId) {
+        traceQueuedUs = RequestTracer::instance().nowUs();
+        RequestTracer::instance().record(traceId, "serialize", traceQueuedUs - (queuedNs - serializeStartNs) / 1000, traceQueuedUs);
+    }
+    info.queuedResponses.append({actionIndex, queuedNs, traceId, traceQueuedUs});
+    LOG_DEBUG() << "发送响应:" << response;
+
+    if (!info.flushQueued) {
+        info.flushQueued = true;
+        m_dirty.append(connection);
+    }
+    if (!m_flushScheduled) {
+        m_flushScheduled = true;
+        // 排在当前这批事件之后执行，这一轮里产生的响应都会被合并
+        QMetaObject::invokeMethod(this, [this]() { flushPending(); }, Qt::QueuedConnection);
+    }
+
+    // 背压检查要把还没写出的部分也算上
+    const qint64 pending = info.sendBuf.size() + connection->bytesToWrite();
+    const qint64 high = m_server->writeHighWatermark();
+    if (high > 0 && pending > high && !info.readPaused)
+        pauseReading(connection, info);
+}
+
+void ClientReactor::flushPending()
+{
+    m_flushScheduled = false;
+
+    const QList<Connection*> dirty = std::exchange(m_dirty, {});
+    for (Connection* connection : dirty)
+        flushConnection(connection);
+}
+
+void ClientReactor::flushConnection(Connection* connection)
+{
+    // 连接可能已经断开（onConnectionClosed中已从clients移除）
+    auto it = clients.find(connection);
+    if (it == clients.end())
+        return;
+
+    it->flushQueued = false;
+    if (it->sendBuf.isEmpty())
+        return;
+
+    // 整个缓冲交给传输层，一次write
+    it->gauges->bytesOut.fetchAndAddRelaxed(it->sendBuf.size());
+    it->gauges->touch();
+    connection->write(std::exchange(it->sendBuf, QByteArray()));
+
+    const qint64 writtenNs = m_clock.nsecsElapsed();
+    for (const QueuedResponse& queued : std::as_const(it->queuedResponses)) {
+        m_server->stats().record(queued.actionIndex, ServerStats::Phase::Write, (writtenNs - queued.queuedNs) / 1000);
+        if (queued.traceId)
+            RequestTracer::instance().record(queued.traceId, "write", queued.traceQueuedUs, RequestTracer::instance().nowUs());
+    }
+    it->queuedResponses.clear();
+
+    const qint64 pending = connection->bytesToWrite();
+    it->gauges->outboundBytes.storeRelaxed(pending);
+    if (pending > it->gauges->peakOutboundBytes.loadRelaxed())
+        it->gauges->peakOutboundBytes.storeRelaxed(pending);
+}
+
+void ClientReactor::onConnectionWritten(Connection* connection)
+{
+    auto it = clients.find(connection);
+    if (it == clients.end())
+        return;
+
+    const qint64 pending = connection->bytesToWrite();
+    it->gauges->outboundBytes.storeRelaxed(pending);
+
+    if (it->readPaused && pending + it->sendBuf.size() <= m_server->writeLowWatermark())
+        resumeReading(connection, *it);
+}
+
+void ClientReactor::pauseReading(Connection* connection, ClientInfo& info)
+{
+    info.readPaused = true;
+    info.gauges->readPaused.storeRelaxed(1);
+    info.gauges->pauseCount.fetchAndAddRelaxed(1);
+    // 不再从传输层读数据，未读数据留在内核里
+    connection->setReadPaused(true);
+    LOG_WARN() << "客户端发送缓冲超过高水位，暂停读取:" << info.tag
+               << "待发送:" << info.sendBuf.size() + connection->bytesToWrite();
+}
+
+void ClientReactor::resumeReading(Connection* connection, ClientInfo& info)
+{
+    info.readPaused = false;
+    info.gauges->readPaused.storeRelaxed(0);
+    connection->setReadPaused(false);
+    LOG_INFO() << "客户端发送缓冲已回落，恢复读取:" << info.tag;
+
+    // 暂停期间已经到达的数据不一定会再次通知，这里主动处理一次
+    processIncoming(connection);
+}
+
+// 分发一条业务请求
+// 请求被拒绝（限流、过载）时的响应，带上建议的重试等待时间
+static QJsonObject retryLaterResponse(const QJsonObject& request, const QString& message, qint64 retryAfterMs)
+{
+    QJsonObject response{{"status", "error"},
+                         {"message", message},
+                         {"data", QJsonValue()},
+                         {"action", request["action"].toString()},
+                         {"retry_after_ms", retryAfterMs}};
+    if (request.contains("request_id"))
+        response["request_id"] = request["request_id"];
+    return response;
+}
+
+bool ClientReactor::admitRequest(Connection* connection, const QJsonObject& request)
+{
+    // 未知的action不限流，交给路由器直接回复错误
+    const QString action = request["action"].toString();
+    const int index = m_server->actions().indexOf(action);
+    if (index < 0)
+        return true;
+
+    ClientInfo &info = clients[connection];
+    const qint64 retryAfter = m_server->rateLimiter().acquire(m_server->actions().at(index).rateClass,
+                                                              info.tag, info.userId, connection->peerAddress());
+    if (retryAfter == 0)
+        return true;
+
+    info.gauges->rateLimited.fetchAndAddRelaxed(1);
+    sendResponse(connection, retryLaterResponse(request, "请求过于频繁，请稍后再试", retryAfter));
+    return false;
+}
+
+void ClientReactor::dispatchRequest(Connection* connection, const QJsonObject& request, quint64 traceId)
+{
+    // 没有线程池时在Reactor线程中同步处理
+    if (!m_server->workerPool()) {
+        if (!admitRequest(connection, request))
+            return;
+        const qint64 startedUs = m_clock.nsecsElapsed() / 1000;
+        QJsonObject response;
+        {
+            TraceScope trace(traceId);
+            response = m_server->handleRequest(request, sessionOf(connection));
+        }
+        clients[connection].gauges->recordRequest(m_clock.nsecsElapsed() / 1000 - startedUs);
+        updateSession(connection, response);
+        updateSubscriptions(connection, response);
+        sendResponse(connection, response, traceId);
+        return;
+    }
+
+    // 带request_id的请求：客户端可以按id匹配响应，允许乱序完成，直接并发处理
+    if (request.contains("request_id")) {
+        if (admitRequest(connection, request))
+            submitToPool(connection, request, false, traceId);
+        return;
+    }
+
+    // 没有request_id的请求：客户端只能按顺序匹配响应，同一连接上逐条处理
+    // 限流检查放到轮到它时再做，被拒绝的回复也不会跑到前面请求的响应之前
+    clients[connection].pendingRequests.enqueue({request, traceId});
+    startNextRequest(connection);
+}
+
+void ClientReactor::startNextRequest(Connection* connection)
+{
+    ClientInfo &info = clients[connection];
+    while (!info.busy && !info.pendingRequests.isEmpty()) {
+        const QueuedRequest queued = info.pendingRequests.dequeue();
+        if (!admitRequest(connection, queued.request))
+            continue;
+
+        info.busy = submitToPool(connection, queued.request, true, queued.traceId);
+    }
+}
+
+bool ClientReactor::submitToPool(Connection* connection, const QJsonObject& request, bool ordered, quint64 traceId)
+{
+    QPointer<Connection> guard(connection);
+    TcpServer *server = m_server;
+    // 登录状态在提交时拷贝一份，工作线程不访问clients
+    SessionInfo session = sessionOf(connection);
+
+    // 登记为处理中的请求，并挂上处理期限
+    ClientInfo &info = clients[connection];
+    const quint64 seq = info.nextRequestSeq++;
+    InFlightRequest inFlight;
+    inFlight.ordered = ordered;
+    inFlight.startedUs = m_clock.nsecsElapsed() / 1000;
+    inFlight.action = request["action"].toString();
+    inFlight.requestId = request.value("request_id");
+    inFlight.traceId = traceId;
+    if (server->requestTimeoutMs() > 0)
+        inFlight.deadline = m_timers.arm(server->requestTimeoutMs(), {connection, TimerKind::Request, seq});
+    info.inFlight.insert(seq, inFlight);
+
+    const qint64 traceQueuedUs = traceId ? RequestTracer::instance().nowUs() : 0;
+
+    // 开启组提交时，写请求直接交给写线程：和同一批的其他写请求一起提交，提交之后才回复
+    GroupCommitWriter *writer = server->groupCommit();
+    if (writer && server->isWriteAction(inFlight.action)) {
+        GroupCommitWriter::Task task;
+        task.traceId = traceId;
+        task.run = [server, request, session, traceId, traceQueuedUs]() {
+            TraceScope trace(traceId);
+            if (traceId)
+                RequestTracer::instance().record(traceId, "queue", traceQueuedUs, RequestTracer::instance().nowUs());
+            return server->handleRequest(request, session);
+        };
+        task.done = [this, guard, request, seq](const QJsonObject& result) {
+            // 提交失败时写线程给出的错误响应不带这两项，这里按请求补上
+            QJsonObject response = result;
+            response["action"] = request["action"].toString();
+            if (request.contains("request_id"))
+                response["request_id"] = request["request_id"];
+            QMetaObject::invokeMethod(this, [this, guard, seq, response]() {
+                onRequestFinished(guard, seq, response);
+            }, Qt::QueuedConnection);
+        };
+        if (writer->submit(std::move(task)))
+            return true;
+        // 写线程已经停止（服务器正在关闭）：退回线程池
+    }
+
+    DispatchQueue::Job job;
+    job.run = [this, server, guard, request, session, seq, traceId, traceQueuedUs]() {
+        // 工作线程：只做业务处理，数据库连接由DatabaseManager按线程分配
+        TraceScope trace(traceId);
+        if (traceId)
+            RequestTracer::instance().record(traceId, "queue", traceQueuedUs, RequestTracer::instance().nowUs());
+        QJsonObject response = server->handleRequest(request, session);
+        // 回到Reactor线程再写回客户端
+        QMetaObject::invokeMethod(this, [this, guard, seq, response]() {
+            onRequestFinished(guard, seq, response);
+        }, Qt::QueuedConnection);
+    };
+    job.shed = [this, guard, request, seq](qint64 retryAfterMs) {
+        // 排队太久，已经被丢弃：按正常结束的流程回复拒绝
+        QJsonObject response = retryLaterResponse(request, "服务器繁忙，请稍后再试", retryAfterMs);
+        QMetaObject::invokeMethod(this, [this, guard, seq, response]() {
+            onRequestFinished(guard, seq, response);
+        }, Qt::QueuedConnection);
+    };
+
+    const qint64 retryAfter = server->dispatchQueue().submit(server->priorityOf(inFlight.action), std::move(job));
+    if (retryAfter == 0)
+        return true;
+
+    // 排队已满或者肯定等不到期限：撤销登记，直接回复
+    m_timers.cancel(inFlight.deadline);
+    info.inFlight.remove(seq);
+    sendResponse(connection, retryLaterResponse(request, "服务器繁忙，请稍后再试", retryAfter), traceId);
+    return false;
+}
+
+void ClientReactor::onRequestFinished(const QPointer<Connection>& connection, quint64 seq, const QJsonObject& response)
+{
+    // 处理期间客户端可能已经断开
+    if (!connection || !clients.contains(connection.data()))
+        return;
+
+    // 找不到记录说明已经超时并回复过错误，丢弃这个迟到的结果
+    ClientInfo &info = clients[connection.data()];
+    auto req = info.inFlight.find(seq);
+    if (req == info.inFlight.end())
+        return;
+
+    m_timers.cancel(req->deadline);
+    const bool ordered = req->ordered;
+    const quint64 traceId = req->traceId;
+    info.gauges->recordRequest(m_clock.nsecsElapsed() / 1000 - req->startedUs);
+    info.inFlight.erase(req);
+
+    updateSession(connection.data(), response);
+    updateSubscriptions(connection.data(), response);
+    sendResponse(connection.data(), response, traceId);
+    finishInFlight(connection.data(), ordered);
+}
+
+void ClientReactor::finishInFlight(Connection* connection, bool ordered)
+{
+    if (ordered) {
+        clients[connection].busy = false;
+        startNextRequest(connection);
+    }
+}
+
+SessionInfo ClientReactor::sessionOf(Connection* connection) const
+{
+    SessionInfo session;
+    auto it = clients.constFind(connection);
+    if (it != clients.cend()) {
+        session.userId = it->userId;
+        session.isAdmin = it->isAdmin;
+    }
+    return session;
+}
+
+void ClientReactor::updateSession(Connection* connection, const QJsonObject& response)
+{
+    if (response["action"].toString() != "login" || response["status"].toString() != "success")
+        return;
+
+    auto it = clients.find(connection);
+    if (it == clients.end())
+        return;
+
+    QJsonObject user = response["data"].toObject();
+    it->userId = user["user_id"].toInt();
+    it->isAdmin = user["is_admin"].toInt() == 1;
+    m_server->connections().setUser(it->gauges, it->userId);
+}
+
+void ClientReactor::updateSubscriptions(Connection* connection, const QJsonObject& response)
+{
+    if (response["action"].toString() != "subscribe_flights" || response["status"].toString() != "success")
+        return;
+
+    auto it = clients.find(connection);
+    if (it == clients.end())
+        return;
+
+    // 新的列表整体替换旧的订阅
+    clearSubscriptions(connection, *it);
+    const QJsonArray flightIds = response["data"].toObject()["flight_ids"].toArray();
+    for (const QJsonValue& value : flightIds) {
+        const int flightId = value.toInt();
+        it->subscribedFlights.insert(flightId);
+        m_flightSubscribers[flightId].insert(connection);
+    }
+}
+
+void ClientReactor::clearSubscriptions(Connection* connection, ClientInfo& info)
+{
+    for (int flightId : std::as_const(info.subscribedFlights)) {
+        auto subscribers = m_flightSubscribers.find(flightId);
+        if (subscribers == m_flightSubscribers.end())
+            continue;
+        subscribers->remove(connection);
+        if (subscribers->isEmpty())
+            m_flightSubscribers.erase(subscribers);
+    }
+    info.subscribedFlights.clear();
+}
+
+void ClientReactor::pushSeatUpdates(const QHash<int, int>& seats)
+{
+    if (m_flightSubscribers.isEmpty())
+        return;
+
+    // 先按连接把变化的航班归到一起，每个连接只发一条消息
+    QHash<Connection*, QJsonArray> updates;
+    for (auto seat = seats.constBegin(); seat != seats.constEnd(); ++seat) {
+        auto subscribers = m_flightSubscribers.constFind(seat.key());
+        if (subscribers == m_flightSubscribers.constEnd())
+            continue;
+
+        QJsonObject delta;
+        delta["flight_id"]       = seat.key();
+        delta["remaining_seats"] = seat.value();
+        for (Connection* connection : *subscribers)
+            updates[connection].append(delta);
+    }
+
+    for (auto it = updates.constBegin(); it != updates.constEnd(); ++it) {
+        QJsonObject push;
+        push["action"]  = "seat_update";
+        push["status"]  = "success";
+        push["message"] = "余票更新";
+        push["data"]    = it.value();
+        sendResponse(it.key(), push);
+    }
+}
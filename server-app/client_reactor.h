@@ -0,0 +1,189 @@
+/*
+该程序负责一组客户端连接的收发（Reactor）
+每个ClientReactor运行在自己的线程（或主线程）里，拥有自己的事件循环和一部分连接：
+TcpServer接受连接后把socket描述符轮流分给各个Reactor，Reactor通过传输层（transport.h）接管连接，负责拆帧、tag注册、
+把业务请求交给TcpServer处理，并把响应写回客户端。
+clients哈希表只在所属Reactor的线程里访问，不需要加锁。
+
+发送：响应先追加到连接自己的发送缓冲（长度头直接写在缓冲里），同一轮事件循环中产生的所有响应
+在下一次回到事件循环时一次性交给传输层写出，流水线请求不会再变成一串小的write。
+
+推送：连接通过subscribe_flights订阅一组航班，余票变化时TcpServer定时（合并后）把最新余票交给每个Reactor，
+Reactor按航班找到订阅者，每个连接一轮只收到一条seat_update。
+
+超时：每个Reactor有一个时间轮（timer_wheel.h），由一个固定间隔的QTimer驱动，
+tag注册期限、空闲回收、请求处理期限都挂在上面，不再为每个连接单独创建QTimer。
+
+背压：单帧超过上限的连接直接断开；某个连接待发送的数据超过高水位时暂停读取它的请求
+（不再从连接读数据，内核缓冲满后对端自然会被TCP流控挡住），发送缓冲降到低水位以下再恢复。
+*/
+
+#ifndef CLIENT_REACTOR_H
+#define CLIENT_REACTOR_H
+
+#include <QObject>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QHash>
+#include <QSet>
+#include <QQueue>
+#include <QPointer>
+#include <QTimer>
+#include <QtEndian>
+#include <QSharedPointer>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include "frame_decoder.h"
+#include "message_codec.h"
+#include "timer_wheel.h"
+#include "connection_registry.h"
+#include "transport.h"
+#include "request_tracer.h"
+
+class TcpServer;
+struct SessionInfo;
+
+class ClientReactor : public QObject, public ConnectionHandler
+{
+    Q_OBJECT
+
+public:
+    ClientReactor(TcpServer *server, int index);
+
+    int index() const { return m_index; }
+
+public slots:
+    // 接管一个已经accept的socket描述符（必须在Reactor所在线程中调用）
+    void addConnection(qintptr socketDescriptor);
+    // 把航班的最新余票（flight_id -> remaining_seats）推送给本Reactor中订阅了这些航班的连接
+    void pushSeatUpdates(const QHash<int, int>& seats);
+
+private:
+    // 传输层回调（ConnectionHandler）
+    // 客户端发来数据，调用这个
+    void onConnectionReadable(Connection* connection) override;
+    // 数据写出后检查是否可以恢复读取
+    void onConnectionWritten(Connection* connection) override;
+    // 客户端断开连接，调用这个
+    void onConnectionClosed(Connection* connection) override;
+
+    TcpServer *m_server;
+    int m_index;
+    Transport *m_transport{nullptr};    // 第一个连接到来时在Reactor线程中创建
+
+    // 时间轮上的定时器类型
+    enum class TimerKind : quint8 {
+        Handshake,  // tag注册期限
+        Idle,       // 空闲回收
+        Request     // 请求处理期限
+    };
+
+    struct TimerEvent {
+        Connection* connection{nullptr};
+        TimerKind kind{TimerKind::Handshake};
+        quint64 requestSeq{0};  // 仅Request使用
+    };
+
+    using Timers = TimerWheel<TimerEvent>;
+
+    // 交给线程池、还没有返回结果的请求
+    struct InFlightRequest {
+        Timers::TimerId deadline{Timers::InvalidTimer};
+        bool ordered{false};    // 是否占用了连接的顺序处理名额
+        qint64 startedUs{0};    // 提交时间（m_clock），用于统计处理耗时
+        QString action;         // 超时时用来构造错误响应
+        QJsonValue requestId;
+        quint64 traceId{0};     // 被采样追踪时非0
+    };
+
+    // 等待按顺序处理的请求
+    struct QueuedRequest {
+        QJsonObject request;
+        quint64 traceId{0};
+    };
+
+    // 已放进发送缓冲、还没写出的响应，写出时记录write阶段的耗时
+    struct QueuedResponse {
+        int actionIndex{-1};
+        qint64 queuedNs{0};     // 放进发送缓冲的时间（m_clock）
+        quint64 traceId{0};
+        qint64 traceQueuedUs{0}; // 放进发送缓冲的时间（RequestTracer的时钟），仅追踪时使用
+    };
+
+    struct ClientInfo {
+        QString tag;
+        FrameDecoder decoder; // 接收缓冲与拆帧
+        QQueue<QueuedRequest> pendingRequests; // 等待交给线程池的请求（仅限没有request_id的请求）
+        bool busy{false};     // 是否有无request_id的请求正在线程池中处理（这类请求按顺序处理，保证响应顺序）
+        int userId{0};        // 登录成功后记录，用于权限检查
+        bool isAdmin{false};
+        bool readPaused{false};                 // 发送缓冲超过高水位，暂停处理该连接的请求
+        QByteArray sendBuf;                     // 本轮积攒的响应（含长度头），等待统一写出
+        bool flushQueued{false};                // 是否已在m_dirty中
+        QList<QueuedResponse> queuedResponses;  // sendBuf中各条响应的action与入缓冲时间
+        QSharedPointer<ConnectionGauges> gauges;
+        MessageCodec::Encoding encoding{MessageCodec::Encoding::Json}; // tag注册时协商的发送编码
+        MessageCodec::Compression compression{MessageCodec::Compression::None}; // tag注册时协商的压缩算法
+        Timers::TimerId handshakeTimer{Timers::InvalidTimer};
+        Timers::TimerId idleTimer{Timers::InvalidTimer};
+        qint64 lastActivityMs{0};               // 最近一次收到数据的时间（m_clock）
+        quint64 nextRequestSeq{1};
+        QHash<quint64, InFlightRequest> inFlight;
+        QSet<int> subscribedFlights;            // subscribe_flights订阅的航班
+    };
+
+    QHash<Connection*, ClientInfo> clients;
+
+    QHash<int, QSet<Connection*>> m_flightSubscribers; // 航班id -> 订阅了它的连接
+
+    QList<Connection*> m_dirty;      // 发送缓冲非空、等待写出的连接
+    bool m_flushScheduled{false};   // 是否已经投递了flushPending
+
+    Timers m_timers;
+    QTimer *m_tickTimer;            // 驱动时间轮，第一个连接到来时在Reactor线程中启动
+    QElapsedTimer m_clock;
+
+    void onTick();
+    void onTimerExpired(const TimerEvent& event);
+    // 断开连接时取消该连接挂在时间轮上的所有定时器
+    void cancelTimers(ClientInfo& info);
+
+    // 读取连接中的数据并处理其中所有完整的帧（暂停读取时不做任何事）
+    void processIncoming(Connection* connection);
+    void pauseReading(Connection* connection, ClientInfo& info);
+    void resumeReading(Connection* connection, ClientInfo& info);
+
+    // 检查限流预算：超出时直接回复错误（带retry_after_ms）并返回false
+    bool admitRequest(Connection* connection, const QJsonObject& request);
+
+    // 把一条业务请求交给线程池（或直接同步处理），traceId非0表示这条请求被采样追踪
+    void dispatchRequest(Connection* connection, const QJsonObject& request, quint64 traceId);
+    // 如果该连接空闲，取出下一条按顺序处理的请求交给线程池
+    void startNextRequest(Connection* connection);
+    // 交给线程池处理，ordered表示该请求占用了连接的顺序处理名额
+    // 排队已满或等不到期限时直接回复拒绝并返回false（此时不占用顺序处理名额）
+    bool submitToPool(Connection* connection, const QJsonObject& request, bool ordered, quint64 traceId);
+    // 线程池处理完毕后在Reactor线程中调用；seq对应ClientInfo::inFlight中的记录，已超时的结果直接丢弃
+    void onRequestFinished(const QPointer<Connection>& connection, quint64 seq, const QJsonObject& response);
+    // 结束一条已经回复过的请求：顺序请求需要释放名额并开始下一条
+    void finishInFlight(Connection* connection, bool ordered);
+
+    // 当前连接的登录状态
+    SessionInfo sessionOf(Connection* connection) const;
+    // 如果是登录成功的响应，记录该连接的用户与权限
+    void updateSession(Connection* connection, const QJsonObject& response);
+    // 如果是订阅成功的响应，用其中的航班列表替换该连接的订阅
+    void updateSubscriptions(Connection* connection, const QJsonObject& response);
+    // 取消该连接的所有订阅
+    void clearSubscriptions(Connection* connection, ClientInfo& info);
+
+    // 辅助函数，将响应按该连接协商的编码放入发送缓冲，在本轮事件循环结束后统一发回客户端
+    void sendResponse(Connection* connection, const QJsonObject& response, quint64 traceId = 0);
+    // 把所有连接积攒的响应交给传输层（每轮事件循环最多执行一次）
+    void flushPending();
+    // 立即写出某个连接积攒的响应（断开连接前必须调用）
+    void flushConnection(Connection* connection);
+};
+
+#endif // CLIENT_REACTOR_H
@@ -0,0 +1,222 @@
+/*
+该文件定义服务器的连接注册表
+所有Reactor中的连接都在这里登记一份ConnectionGauges（统计信息），并按以下几个键建立索引：
+  连接id、tag（唯一，tag注册时用来拒绝重复的tag）、对端地址、登录的用户id。
+按tag/地址/用户查找连接、tag查重都是一次哈希查找，不需要遍历所有连接；
+管理员接口按负载取前N个连接时只对统计数据排序。
+索引由一把锁保护（连接建立/注册tag/登录/断开时才会修改）；计数器都是原子变量，
+由所属Reactor在收发时直接更新，读的一方不需要加锁。
+*/
+#ifndef CONNECTION_REGISTRY_H
+#define CONNECTION_REGISTRY_H
+
+#include <QString>
+#include <QHash>
+#include <QMultiHash>
+#include <QList>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QAtomicInteger>
+#include <QDateTime>
+#include <algorithm>
+
+// 单个连接的统计：由所属Reactor更新，管理员接口在其他线程读取
+struct ConnectionGauges {
+    quint64 id{0};
+    int reactorIndex{0};
+    QString peer;
+    QString tag;                                // 以下两项由ConnectionRegistry加锁写入
+    int userId{0};
+
+    // 缓冲情况
+    QAtomicInteger<qint64> inboundBytes{0};     // 已收到但还没处理的字节数
+    QAtomicInteger<qint64> outboundBytes{0};    // 待发送的字节数
+    QAtomicInteger<qint64> peakOutboundBytes{0};
+    QAtomicInt readPaused{0};
+    QAtomicInteger<qint64> pauseCount{0};       // 因背压暂停读取的次数
+    QAtomicInteger<qint64> rateLimited{0};      // 因超出限流预算被拒绝的请求数
+
+    // 累计流量与请求
+    QAtomicInteger<qint64> bytesIn{0};          // 累计收到的字节数
+    QAtomicInteger<qint64> bytesOut{0};         // 累计发出的字节数
+    QAtomicInteger<qint64> requests{0};         // 已回复的业务请求数
+    QAtomicInteger<qint64> latencyTotalUs{0};   // 这些请求的处理耗时之和（微秒）
+    QAtomicInteger<qint64> lastActivityMs{0};   // 最近一次收发数据的时间（epoch毫秒）
+
+    void touch() { lastActivityMs.storeRelaxed(QDateTime::currentMSecsSinceEpoch()); }
+
+    void recordRequest(qint64 latencyUs)
+    {
+        requests.fetchAndAddRelaxed(1);
+        latencyTotalUs.fetchAndAddRelaxed(latencyUs);
+    }
+
+    qint64 averageLatencyUs() const
+    {
+        const qint64 count = requests.loadRelaxed();
+        return count > 0 ? latencyTotalUs.loadRelaxed() / count : 0;
+    }
+};
+
+class ConnectionRegistry
+{
+public:
+    using Gauges = QSharedPointer<ConnectionGauges>;
+
+    // 排序依据：管理员接口按这些指标取负载最高的连接
+    enum class LoadMetric {
+        Bytes,      // 累计收发字节数
+        Requests,   // 已回复的请求数
+        Latency,    // 平均处理耗时
+        Outbound    // 当前待发送字节数
+    };
+
+    // 登记一个新连接，返回它的统计对象（Reactor持有，断开时调用remove）
+    Gauges add(int reactorIndex, const QString& peer)
+    {
+        Gauges gauges(new ConnectionGauges);
+        gauges->reactorIndex = reactorIndex;
+        gauges->peer = peer;
+        gauges->touch();
+
+        QMutexLocker locker(&m_mutex);
+        gauges->id = m_nextId++;
+        m_byId.insert(gauges->id, gauges);
+        m_byPeer.insert(peer, gauges->id);
+        return gauges;
+    }
+
+    void remove(const Gauges& gauges)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_byId.remove(gauges->id);
+        m_byPeer.remove(gauges->peer, gauges->id);
+        if (!gauges->tag.isEmpty())
+            m_byTag.remove(gauges->tag);
+        if (gauges->userId > 0)
+            m_byUser.remove(gauges->userId, gauges->id);
+    }
+
+    // 为连接绑定tag；tag已被其他连接占用时返回false
+    bool claimTag(const Gauges& gauges, const QString& tag)
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_byTag.contains(tag))
+            return false;
+        m_byTag.insert(tag, gauges->id);
+        gauges->tag = tag;
+        return true;
+    }
+
+    // 登录成功后记录连接所属的用户（userId为0表示未登录）
+    void setUser(const Gauges& gauges, int userId)
+    {
+        QMutexLocker locker(&m_mutex);
+        if (gauges->userId == userId)
+            return;
+        if (gauges->userId > 0)
+            m_byUser.remove(gauges->userId, gauges->id);
+        gauges->userId = userId;
+        if (userId > 0)
+            m_byUser.insert(userId, gauges->id);
+    }
+
+    Gauges findByTag(const QString& tag) const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_byId.value(m_byTag.value(tag));
+    }
+
+    QList<Gauges> findByPeer(const QString& peer) const
+    {
+        QMutexLocker locker(&m_mutex);
+        return lookup(m_byPeer.values(peer));
+    }
+
+    QList<Gauges> findByUser(int userId) const
+    {
+        QMutexLocker locker(&m_mutex);
+        return lookup(m_byUser.values(userId));
+    }
+
+    QList<Gauges> all() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_byId.values();
+    }
+
+    // tag和用户id会在其他线程中被修改，读取时需要加锁
+    struct Identity {
+        QString tag;
+        int userId{0};
+    };
+
+    Identity identity(const Gauges& gauges) const
+    {
+        QMutexLocker locker(&m_mutex);
+        return {gauges->tag, gauges->userId};
+    }
+
+    int size() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_byId.size();
+    }
+
+    // 按负载从高到低取前limit个连接
+    QList<Gauges> top(LoadMetric metric, int limit) const
+    {
+        QList<Gauges> list = all();
+        if (limit <= 0)
+            return {};
+        limit = qMin(limit, static_cast<int>(list.size()));
+
+        auto load = [metric](const Gauges& g) -> qint64 {
+            switch (metric) {
+            case LoadMetric::Requests: return g->requests.loadRelaxed();
+            case LoadMetric::Latency:  return g->averageLatencyUs();
+            case LoadMetric::Outbound: return g->outboundBytes.loadRelaxed();
+            case LoadMetric::Bytes:    break;
+            }
+            return g->bytesIn.loadRelaxed() + g->bytesOut.loadRelaxed();
+        };
+
+        // 先取出各连接的负载值，避免排序过程中计数器变化导致比较结果不一致
+        QList<std::pair<qint64, Gauges>> ranked;
+        ranked.reserve(list.size());
+        for (const Gauges& g : std::as_const(list))
+            ranked.append({load(g), g});
+
+        std::partial_sort(ranked.begin(), ranked.begin() + limit, ranked.end(),
+                          [](const auto& a, const auto& b) { return a.first > b.first; });
+
+        QList<Gauges> result;
+        result.reserve(limit);
+        for (int i = 0; i < limit; ++i)
+            result.append(ranked.at(i).second);
+        return result;
+    }
+
+private:
+    mutable QMutex m_mutex;
+    quint64 m_nextId{1};
+    QHash<quint64, Gauges> m_byId;
+    QHash<QString, quint64> m_byTag;
+    QMultiHash<QString, quint64> m_byPeer;
+    QMultiHash<int, quint64> m_byUser;
+
+    // 调用前必须持有m_mutex
+    QList<Gauges> lookup(const QList<quint64>& ids) const
+    {
+        QList<Gauges> result;
+        result.reserve(ids.size());
+        for (quint64 id : ids) {
+            Gauges gauges = m_byId.value(id);
+            if (gauges)
+                result.append(gauges);
+        }
+        return result;
+    }
+};
+
+#endif // CONNECTION_REGISTRY_H
@@ -3,6 +3,20 @@
 注意，所有需要使用数据库的部分，都需要通过调用该文件当中的DatabaseManager类来实现。
 也就是说，在server-app的任何地方，如果你需要调用数据库，请使用DatabaseManager::instance().database()
 在main.cpp中初始化该数据库
+QSqlDatabase的连接只能在创建它的线程里使用，所以database()会给每个线程分配独立的连接，并且按用途分成两种：
+  写连接：主线程使用init()打开的默认连接，其他线程第一次调用时从默认连接克隆；
+          同一时刻只有一个线程能使用写连接（持有写租约），写事务之间在进程内排队，而不是在SQLite里忙等重试；
+  读连接：只读打开，每条请求在一个读事务里执行，看到的是请求开始时的快照。
+          WAL模式下读不阻塞写、写也不阻塞读，查询可以在所有线程上并行执行。
+          回滚日志模式（legacy）下读事务会一直持有SHARED锁、挡住写连接提交，所以不开读事务，每条查询各自读最新提交的数据。
+每条请求由TcpServer按action的读/写类型借一个DatabaseLease，处理函数里的database()和CachedQuery自动使用对应的连接；
+没有租约时（例如定时推送余票）使用读连接。
+每个连接打开后都按DatabaseProfile设置SQLite参数（日志模式、同步级别、mmap、页缓存等），启动时把实际生效的值打到日志里。
+表结构的后续修改通过migrate()按 PRAGMA user_version 逐版本升级，已经升级过的数据库不会重复执行。
+处理函数执行SQL时使用CachedQuery（见sql_statements.h）：语句按编号缓存在每个线程的连接上，只在第一次使用时prepare。
+写操作的处理函数不自己开启事务：单独执行时每条语句自动提交（写租约保证同一时刻只有一个线程在写）；
+开启组提交（group_commit.h）后，一批请求共用写线程上的一个事务，每条请求在自己的保存点里执行。
+订票、退票不经过写操作的路径，由订单日志（booking_journal.h）在后台线程上写回。
 */
 #ifndef DATABASE_MANAGER_H
 #define DATABASE_MANAGER_H
@@ -11,9 +25,64 @@
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QSqlError>
-#include <QDebug>
+#include "async_logger.h"
 #include <QStandardPaths>
 #include <QDir>
+#include <QThread>
+#include <QStringList>
+#include <QAtomicInteger>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <array>
+#include <iterator>
+#include <memory>
+#include "sql_statements.h"
+#include "request_tracer.h"
+
+// SQLite的运行参数（启动参数 --db-profile 选择）
+struct DatabaseProfile {
+    QString name;
+    QString journalMode;    // WAL：读不阻塞写，提交只追加WAL文件；DELETE：原来的回滚日志
+    QString synchronous;    // WAL下NORMAL只在checkpoint时fsync，断电可能丢最近的提交但不会损坏；FULL每次提交都fsync
+    qint64 mmapSize{0};     // 字节，0为不使用mmap
+    int cacheSizeKiB{0};    // 每个连接的页缓存
+    QString tempStore;      // 临时表/排序放在内存（MEMORY）还是文件（DEFAULT）
+    int busyTimeoutMs{0};   // 遇到写锁时的最长等待时间
+
+    // fast（默认）：WAL + NORMAL，适合订票这种大量小事务
+    static DatabaseProfile fast()
+    {
+        return {QStringLiteral("fast"), QStringLiteral("WAL"), QStringLiteral("NORMAL"),
+                256LL * 1024 * 1024, 64 * 1024, QStringLiteral("MEMORY"), 5000};
+    }
+
+    // durable：同样用WAL，但每次提交都fsync，断电也不丢已确认的订单
+    static DatabaseProfile durable()
+    {
+        DatabaseProfile profile = fast();
+        profile.name = QStringLiteral("durable");
+        profile.synchronous = QStringLiteral("FULL");
+        return profile;
+    }
+
+    // legacy：SQLite默认设置（回滚日志、每次提交fsync），用于对比
+    static DatabaseProfile legacy()
+    {
+        return {QStringLiteral("legacy"), QStringLiteral("DELETE"), QStringLiteral("FULL"),
+                0, 2000, QStringLiteral("DEFAULT"), 5000};
+    }
+
+    static bool fromName(const QString& name, DatabaseProfile& profile)
+    {
+        for (const DatabaseProfile& candidate : {fast(), durable(), legacy()}) {
+            if (name.compare(candidate.name, Qt::CaseInsensitive) == 0) {
+                profile = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+};
 
 class DatabaseManager {
 public:
@@ -24,37 +93,133 @@ public:
     }
 
     // 初始化数据库
-    bool init() {
+    bool init(const DatabaseProfile& profile = DatabaseProfile::fast()) {
+        m_profile = profile;
         m_db = QSqlDatabase::addDatabase("QSQLITE");
+        m_ownerThread = QThread::currentThread();
 
         QString dbPath = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation);
 
         QDir().mkpath(dbPath);
         m_db.setDatabaseName(dbPath + "/flight_system.db");
+        // 多个线程各自持有连接时会出现写锁竞争，遇到锁时等待一段时间而不是立即失败（克隆的连接会继承这个参数）
+        m_db.setConnectOptions(QString("QSQLITE_BUSY_TIMEOUT=%1").arg(m_profile.busyTimeoutMs));
 
 
         if (!m_db.open())
         {
-            qCritical() << "数据库打开失败:" << m_db.lastError().text();
+            LOG_CRITICAL() << "数据库打开失败:" << m_db.lastError().text();
             return false;
         }
 
-        qInfo() << "数据库连接成功! 路径:" << dbPath + "/flight_system.db";
+        LOG_INFO() << "数据库连接成功! 路径:" << dbPath + "/flight_system.db";
 
-        // 启用外键约束（SQLlite默认是没有开启外键约束的
+        // 日志模式记录在数据库文件里，只需要在第一个连接上设置一次
         QSqlQuery query(m_db);
-        if (!query.exec("PRAGMA foreign_keys = ON;"))
+        if (!query.exec(QString("PRAGMA journal_mode = %1;").arg(m_profile.journalMode)))
         {
-            qWarning() << "启用外键失败:" << query.lastError().text();
+            LOG_WARN() << "设置日志模式失败:" << query.lastError().text();
         }
+        // 返回实际生效的日志模式（例如文件系统不支持WAL时保持原样）
+        m_snapshotReads = query.next() && query.value(0).toString().compare("wal", Qt::CaseInsensitive) == 0;
+        query.finish();
+        configureConnection(m_db);
+        logSettings();
 
-        return createTables();
+        return createTables() && migrate();
     }
 
+    // 数据库文件路径（订单日志放在它旁边）
+    QString databasePath() const { return m_db.databaseName(); }
+    const DatabaseProfile& profile() const { return m_profile; }
+    // 读请求是否在快照（读事务）中执行：只有WAL模式下读事务不会阻塞写
+    bool snapshotReads() const { return m_snapshotReads; }
+
+    // 连接的用途
+    enum class Role {
+        Read,
+        Write
+    };
+
     // 提供一个公共访问接口，允许其他类获得QSqlDatabase对象以使用SQL语句进行查询
-    QSqlDatabase database() { return m_db; }
+    // 返回属于当前线程、与当前租约用途相同的连接
+    QSqlDatabase database() { return connection(currentRole()); }
+
+    QSqlDatabase connection(Role role) {
+        if (role == Role::Write && QThread::currentThread() == m_ownerThread)
+            return m_db;
+
+        const QString name = QString("conn_%1_%2").arg(reinterpret_cast<quintptr>(QThread::currentThread()), 0, 16)
+                                                  .arg(role == Role::Write ? "w" : "r");
+        if (QSqlDatabase::contains(name))
+            return QSqlDatabase::database(name);
+
+        // 线程内第一次使用：从默认连接克隆（会继承数据库路径与连接参数）
+        QSqlDatabase db = QSqlDatabase::cloneDatabase(QSqlDatabase::defaultConnection, name);
+        if (role == Role::Read)
+            db.setConnectOptions(m_db.connectOptions() + ";QSQLITE_OPEN_READONLY");
+        if (!db.open()) {
+            LOG_CRITICAL() << "线程数据库连接打开失败:" << db.lastError().text();
+            return db;
+        }
+        configureConnection(db);
+        LOG_INFO() << "为线程创建数据库连接:" << name;
+        return db;
+    }
+
+    // 当前线程的租约用途（没有租约时为Read）
+    static Role& currentRole() {
+        thread_local Role role = Role::Read;
+        return role;
+    }
+
+    // 当前线程是否正在执行一批组提交（批次的事务已经开启）
+    static bool& inGroupCommit() {
+        thread_local bool inBatch = false;
+        return inBatch;
+    }
+
+    // 取当前线程连接上预编译好的语句（第一次使用时prepare）
+    // 返回的语句用完后必须finish()，否则SELECT会一直占着读事务，请使用下面的CachedQuery
+    QSqlQuery& statement(Sql id) {
+        // 连接属于线程，缓存也按线程（和连接用途）保存；线程退出时随之释放
+        struct Cache {
+            std::array<std::unique_ptr<QSqlQuery>, SqlCount> queries[2];
+            std::unique_ptr<QSqlQuery> failed;      // 最近一条prepare失败的语句
+        };
+        thread_local Cache cache;
+
+        const Role role = currentRole();
+        std::unique_ptr<QSqlQuery>& slot = cache.queries[static_cast<int>(role)][static_cast<int>(id)];
+        if (slot) {
+            m_statementHits.fetchAndAddRelaxed(1);
+            return *slot;
+        }
+
+        m_statementMisses.fetchAndAddRelaxed(1);
+        auto query = std::make_unique<QSqlQuery>(connection(role));
+        query->setForwardOnly(true);
+        if (!query->prepare(QString::fromUtf8(sqlText(id)))) {
+            // 不缓存失败的语句，下次再试；这次exec()会失败并带着同样的错误返回
+            LOG_WARN() << "预编译SQL失败:" << static_cast<int>(id) << query->lastError().text();
+            cache.failed = std::move(query);
+            return *cache.failed;
+        }
+        slot = std::move(query);
+        return *slot;
+    }
+
+    // 预编译语句缓存的命中/未命中次数（未命中即prepare次数）
+    quint64 statementHits() const { return m_statementHits.loadRelaxed(); }
+    quint64 statementMisses() const { return m_statementMisses.loadRelaxed(); }
+
+    // 写租约的等待次数与累计等待时间（微秒），用于判断写操作是否在排队
+    quint64 writeLeaseWaits() const { return m_writeLeaseWaits.loadRelaxed(); }
+    quint64 writeLeaseWaitUs() const { return m_writeLeaseWaitUs.loadRelaxed(); }
 
 private:
+    friend class DatabaseLease;
+
     // 私有构造函数，防止外部创建实例
     DatabaseManager() {}
     ~DatabaseManager() { m_db.close(); }
@@ -62,6 +227,50 @@ private:
     DatabaseManager(const DatabaseManager&) = delete;
     DatabaseManager& operator=(const DatabaseManager&) = delete;
 
+    // 每个连接都需要单独设置的参数
+    void configureConnection(QSqlDatabase& db) const {
+        // 启用外键约束（SQLlite默认是没有开启外键约束的
+        QSqlQuery query(db);
+        if (!query.exec("PRAGMA foreign_keys = ON;"))
+        {
+            LOG_WARN() << "启用外键失败:" << query.lastError().text();
+        }
+
+        // cache_size为负数时单位是KiB
+        const QStringList pragmas = {
+            QString("PRAGMA synchronous = %1;").arg(m_profile.synchronous),
+            QString("PRAGMA mmap_size = %1;").arg(m_profile.mmapSize),
+            QString("PRAGMA cache_size = %1;").arg(-m_profile.cacheSizeKiB),
+            QString("PRAGMA temp_store = %1;").arg(m_profile.tempStore)
+        };
+        for (const QString& sql : pragmas) {
+            if (!query.exec(sql))
+                LOG_WARN() << "设置数据库参数失败:" << sql << query.lastError().text();
+        }
+    }
+
+    // 从默认连接读回实际生效的参数（例如文件系统不支持WAL时journal_mode会保持原样）
+    void logSettings() {
+        QSqlQuery query(m_db);
+        auto read = [&query](const char* pragma) {
+            if (query.exec(QString("PRAGMA %1;").arg(pragma)) && query.next())
+                return query.value(0).toString();
+            return QStringLiteral("?");
+        };
+        static const char* const synchronousNames[] = {"OFF", "NORMAL", "FULL", "EXTRA"};
+        static const char* const tempStoreNames[] = {"DEFAULT", "FILE", "MEMORY"};
+        const int synchronous = read("synchronous").toInt();
+        const int tempStore = read("temp_store").toInt();
+
+        LOG_INFO() << "数据库参数:" << m_profile.name
+                   << "journal_mode=" + read("journal_mode")
+                   << "synchronous=" + QString(synchronous >= 0 && synchronous < 4 ? synchronousNames[synchronous] : "?")
+                   << "mmap_size=" + read("mmap_size")
+                   << "cache_size=" + read("cache_size")
+                   << "temp_store=" + QString(tempStore >= 0 && tempStore < 3 ? tempStoreNames[tempStore] : "?")
+                   << "busy_timeout=" + read("busy_timeout");
+    }
+
     // 表的具体形式，可以去查看共享文档
     bool createTables() {
         QSqlQuery query(m_db);
@@ -74,7 +283,7 @@ private:
                         "is_admin INTEGER NOT NULL DEFAULT 0,"
                         "created_at DATETIME DEFAULT CURRENT_TIMESTAMP"
                         ");")) {
-            qCritical() << "创建User表失败:" << query.lastError().text();
+            LOG_CRITICAL() << "创建User表失败:" << query.lastError().text();
             return false;
         }
 
@@ -92,7 +301,7 @@ private:
                         "price REAL NOT NULL,"
                         "is_deleted INTEGER NOT NULL DEFAULT 0"
                         ");")) {
-            qCritical() << "创建Flight表失败:" << query.lastError().text();
+            LOG_CRITICAL() << "创建Flight表失败:" << query.lastError().text();
             return false;
         }
 
@@ -106,11 +315,25 @@ private:
                         "FOREIGN KEY (user_id) REFERENCES User (user_id),"
                         "FOREIGN KEY (flight_id) REFERENCES Flight (flight_id)"
                         ");")) {
-            qCritical() << "创建Booking表失败:" << query.lastError().text();
+            LOG_CRITICAL() << "创建Booking表失败:" << query.lastError().text();
             return false;
         }
 
-        qInfo() << "所有表检查/创建成功!";
+        // 列表接口按这些键做keyset分页（见tcp_server.cpp），索引保证每页都是一次索引定位+顺序读取
+        // SQLite的普通索引末尾隐含rowid（即各表的*_id主键），所以 (departure_time) 可以直接用于 ORDER BY departure_time, flight_id
+        const char *indexes[] = {
+            "CREATE INDEX IF NOT EXISTS idx_flight_departure ON Flight (departure_time);",
+            "CREATE INDEX IF NOT EXISTS idx_booking_time ON Booking (booking_time);",
+            "CREATE INDEX IF NOT EXISTS idx_booking_user_time ON Booking (user_id, booking_time);"
+        };
+        for (const char *sql : indexes) {
+            if (!query.exec(sql)) {
+                LOG_CRITICAL() << "创建索引失败:" << query.lastError().text();
+                return false;
+            }
+        }
+
+        LOG_INFO() << "所有表检查/创建成功!";
 
         // 插入一个默认管理员账户，方便测试
         // 这里的SQL写法也确保了这个管理员帐户不会被反复插入。
@@ -121,7 +344,157 @@ private:
         return true;
     }
 
+    // 表结构升级：每个版本一组语句，在同一个事务里执行并把user_version设为该版本
+    // 新版本只能追加在末尾，已经发布的版本不能再改
+    bool migrate() {
+        static const QStringList migrations[] = {
+            // 版本1：起降时间另存一份整数秒（把 'YYYY-MM-DD HH:MM:SS' 当作UTC换算，只用于比较和排序，不做时区转换），
+            // 航班查询按 [当天0点, 次日0点) 的范围在索引上定位，而不是对TEXT列做LIKE再排序
+            {
+                "ALTER TABLE Flight ADD COLUMN departure_epoch INTEGER;",
+                "ALTER TABLE Flight ADD COLUMN arrival_epoch INTEGER;",
+                "UPDATE Flight SET departure_epoch = CAST(strftime('%s', departure_time) AS INTEGER),"
+                "                  arrival_epoch   = CAST(strftime('%s', arrival_time) AS INTEGER);",
+                // 用触发器维护，服务器的处理函数和dataPrepare里的导入脚本都不需要知道这两列
+                "CREATE TRIGGER IF NOT EXISTS trg_flight_epoch_insert AFTER INSERT ON Flight BEGIN"
+                "  UPDATE Flight SET departure_epoch = CAST(strftime('%s', NEW.departure_time) AS INTEGER),"
+                "                    arrival_epoch   = CAST(strftime('%s', NEW.arrival_time) AS INTEGER)"
+                "  WHERE flight_id = NEW.flight_id;"
+                " END;",
+                "CREATE TRIGGER IF NOT EXISTS trg_flight_epoch_update AFTER UPDATE OF departure_time, arrival_time ON Flight BEGIN"
+                "  UPDATE Flight SET departure_epoch = CAST(strftime('%s', NEW.departure_time) AS INTEGER),"
+                "                    arrival_epoch   = CAST(strftime('%s', NEW.arrival_time) AS INTEGER)"
+                "  WHERE flight_id = NEW.flight_id;"
+                " END;",
+                // 部分索引只包含未删除的航班；查询条件里必须写 is_deleted = 0 才会用上
+                // 末尾隐含rowid，ORDER BY departure_epoch, flight_id 不需要额外排序
+                "CREATE INDEX IF NOT EXISTS idx_flight_route_epoch ON Flight (origin, destination, departure_epoch) WHERE is_deleted = 0;",
+                "CREATE INDEX IF NOT EXISTS idx_flight_departure_epoch ON Flight (departure_epoch) WHERE is_deleted = 0;",
+                // 被idx_flight_route_epoch取代
+                "DROP INDEX IF EXISTS idx_flight_route;"
+            },
+        };
+        const int latest = static_cast<int>(std::size(migrations));
+
+        QSqlQuery query(m_db);
+        if (!query.exec("PRAGMA user_version;") || !query.next()) {
+            LOG_CRITICAL() << "读取数据库版本失败:" << query.lastError().text();
+            return false;
+        }
+        int version = query.value(0).toInt();
+        if (version > latest) {
+            LOG_CRITICAL() << "数据库版本" << version << "比服务器支持的版本" << latest << "新，请升级服务器";
+            return false;
+        }
+
+        for (; version < latest; ++version) {
+            if (!m_db.transaction()) {
+                LOG_CRITICAL() << "数据库升级失败:" << m_db.lastError().text();
+                return false;
+            }
+            for (const QString& sql : migrations[version]) {
+                if (!query.exec(sql)) {
+                    LOG_CRITICAL() << "数据库升级到版本" << version + 1 << "失败:" << query.lastError().text();
+                    m_db.rollback();
+                    return false;
+                }
+            }
+            // PRAGMA不能绑定参数，版本号直接拼进去
+            if (!query.exec(QString("PRAGMA user_version = %1;").arg(version + 1)) || !m_db.commit()) {
+                LOG_CRITICAL() << "数据库升级到版本" << version + 1 << "失败:" << query.lastError().text();
+                m_db.rollback();
+                return false;
+            }
+            LOG_INFO() << "数据库已升级到版本" << version + 1;
+        }
+
+        // 迁移可能改变了数据分布，让查询规划器重新统计（只分析有变化的表，很快）
+        query.exec("PRAGMA optimize;");
+        return true;
+    }
+
     QSqlDatabase m_db;
+    QThread* m_ownerThread{nullptr};
+    DatabaseProfile m_profile{DatabaseProfile::fast()};
+    bool m_snapshotReads{false};
+
+    QAtomicInteger<quint64> m_statementHits{0};
+    QAtomicInteger<quint64> m_statementMisses{0};
+
+    QMutex m_writeMutex;            // 写租约
+    QAtomicInteger<quint64> m_writeLeaseWaits{0};
+    QAtomicInteger<quint64> m_writeLeaseWaitUs{0};
+};
+
+// 一条请求使用数据库的租约：构造时切换当前线程的连接用途，析构时恢复
+// Write：独占写租约（其他线程的写请求在这里排队），处理函数自己管理事务；
+//        同一线程已经持有写租约时（组提交的批次中）直接沿用，不重复加锁
+// Read：在读连接上开启一个读事务，请求内的多条查询看到同一个快照，析构时结束事务
+//       （只在WAL模式下，见snapshotReads()；否则每条查询单独执行）；
+//       snapshot为false时也不开读事务，每条查询读到的都是最新提交的数据（订票、退票需要）
+class DatabaseLease
+{
+public:
+    explicit DatabaseLease(DatabaseManager::Role role, bool snapshot = true)
+        : m_previous(DatabaseManager::currentRole()), m_role(role)
+    {
+        DatabaseManager& manager = DatabaseManager::instance();
+        if (m_role == DatabaseManager::Role::Write && m_previous != DatabaseManager::Role::Write) {
+            m_locked = true;
+            if (!manager.m_writeMutex.tryLock()) {
+                TraceSpan span("db.write_lease");
+                QElapsedTimer timer;
+                timer.start();
+                manager.m_writeMutex.lock();
+                manager.m_writeLeaseWaits.fetchAndAddRelaxed(1);
+                manager.m_writeLeaseWaitUs.fetchAndAddRelaxed(static_cast<quint64>(timer.nsecsElapsed() / 1000));
+            }
+        }
+        DatabaseManager::currentRole() = m_role;
+        if (m_role == DatabaseManager::Role::Read && snapshot && manager.snapshotReads()) {
+            QSqlDatabase db = manager.database();
+            m_snapshot = db.transaction();
+        }
+    }
+
+    ~DatabaseLease()
+    {
+        DatabaseManager& manager = DatabaseManager::instance();
+        if (m_snapshot) {
+            QSqlDatabase db = manager.database();
+            db.commit();
+        }
+        DatabaseManager::currentRole() = m_previous;
+        if (m_locked)
+            manager.m_writeMutex.unlock();
+    }
+
+    DatabaseLease(const DatabaseLease&) = delete;
+    DatabaseLease& operator=(const DatabaseLease&) = delete;
+
+private:
+    DatabaseManager::Role m_previous;
+    DatabaseManager::Role m_role;
+    bool m_snapshot{false};
+    bool m_locked{false};
+};
+
+// 借用一条缓存的语句，离开作用域时finish()（重置语句、释放读事务，但保留编译结果）
+// 用法：CachedQuery query(Sql::Login); query->bindValue(":user", username); query->exec();
+class CachedQuery
+{
+public:
+    explicit CachedQuery(Sql id) : m_query(DatabaseManager::instance().statement(id)) {}
+    ~CachedQuery() { m_query.finish(); }
+
+    CachedQuery(const CachedQuery&) = delete;
+    CachedQuery& operator=(const CachedQuery&) = delete;
+
+    QSqlQuery* operator->() { return &m_query; }
+    QSqlQuery& operator*() { return m_query; }
+
+private:
+    QSqlQuery& m_query;
 };
 
 #endif // DATABASE_MANAGER_H
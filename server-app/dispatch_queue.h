@@ -0,0 +1,192 @@
+/*
+该文件实现线程池前面的有界优先级队列（准入控制与过载丢弃）
+Reactor不再直接把请求交给QThreadPool，而是放进这个队列：
+  1. 按优先级分成三档：订票/退票等写操作 > 查询 > 管理员报表，工作线程总是先取高优先级的请求；
+  2. 每档的排队长度有上限，按当前的平均处理耗时估算排到它还要等多久，
+     已满或者肯定等不到期限的请求在提交时就直接拒绝；
+  3. 工作线程取出请求时如果已经超过排队期限，不再处理，直接回复拒绝（这时客户端多半已经不想要结果了）。
+拒绝时都会给出建议的重试等待时间（retry_after_ms）。
+每提交一个请求就向QThreadPool投递一个“取一个请求来处理”的任务，所以线程池自己的队列里只有这些小任务，
+真正的请求和它们的顺序由这里决定。仅在开启线程池时使用。
+*/
+#ifndef DISPATCH_QUEUE_H
+#define DISPATCH_QUEUE_H
+
+#include <QtGlobal>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QAtomicInteger>
+#include <array>
+#include <deque>
+#include <functional>
+
+class DispatchQueue
+{
+public:
+    enum class Priority {
+        High,       // 订票、退票等写操作
+        Normal,     // 查询、登录
+        Low         // 管理员报表
+    };
+    static constexpr int PriorityCount = 3;
+
+    struct Job {
+        std::function<void()> run;                      // 在工作线程中处理请求
+        std::function<void(qint64 retryAfterMs)> shed;  // 排队超时被丢弃时调用（工作线程中）
+    };
+
+    // 每档的统计，供管理员接口查看
+    struct Stats {
+        int depth{0};
+        int peakDepth{0};
+        qint64 accepted{0};
+        qint64 rejected{0};     // 提交时被拒绝
+        qint64 shed{0};         // 排队超时被丢弃
+        qint64 avgWaitUs{0};    // 平均排队时间
+    };
+
+    // 队列长度上限（每档）和排队期限（毫秒），0 表示不限制
+    void setLimits(int capacity, int maxWaitMs)
+    {
+        m_capacity = qMax(0, capacity);
+        m_maxWaitMs = qMax(0, maxWaitMs);
+    }
+
+    void setPool(QThreadPool* pool)
+    {
+        m_pool = pool;
+        m_clock.start();
+    }
+
+    int capacity() const { return m_capacity; }
+    int maxWaitMs() const { return m_maxWaitMs; }
+
+    // 提交一个请求：返回0表示已排队，否则表示被拒绝，返回值为建议的重试等待时间（毫秒）
+    qint64 submit(Priority priority, Job job)
+    {
+        const int p = static_cast<int>(priority);
+        {
+            QMutexLocker locker(&m_mutex);
+            Lane& lane = m_lanes[p];
+
+            // 排在它前面的是同档和更高档的请求
+            int ahead = 0;
+            for (int i = 0; i <= p; ++i)
+                ahead += static_cast<int>(m_lanes[i].jobs.size());
+            const qint64 expectedWaitMs = estimateWaitMs(ahead);
+
+            const bool full = m_capacity > 0 && static_cast<int>(lane.jobs.size()) >= m_capacity;
+            const bool tooLate = m_maxWaitMs > 0 && expectedWaitMs > m_maxWaitMs;
+            if (full || tooLate) {
+                ++lane.rejected;
+                return retryAfterMs(expectedWaitMs);
+            }
+
+            lane.jobs.push_back({std::move(job), m_clock.elapsed()});
+            lane.peakDepth = qMax(lane.peakDepth, static_cast<int>(lane.jobs.size()));
+            ++lane.accepted;
+        }
+
+        m_pool->start([this]() { runOne(); });
+        return 0;
+    }
+
+    Stats stats(Priority priority) const
+    {
+        QMutexLocker locker(&m_mutex);
+        const Lane& lane = m_lanes[static_cast<int>(priority)];
+        Stats stats;
+        stats.depth = static_cast<int>(lane.jobs.size());
+        stats.peakDepth = lane.peakDepth;
+        stats.accepted = lane.accepted;
+        stats.rejected = lane.rejected;
+        stats.shed = lane.shed;
+        stats.avgWaitUs = lane.dequeued > 0 ? lane.waitTotalUs / lane.dequeued : 0;
+        return stats;
+    }
+
+    // 平均处理一个请求的耗时（微秒，指数滑动平均）
+    qint64 avgServiceUs() const { return m_avgServiceUs.loadRelaxed(); }
+
+private:
+    struct Pending {
+        Job job;
+        qint64 enqueuedMs{0};
+    };
+
+    struct Lane {
+        std::deque<Pending> jobs;
+        int peakDepth{0};
+        qint64 accepted{0};
+        qint64 rejected{0};
+        qint64 shed{0};
+        qint64 dequeued{0};
+        qint64 waitTotalUs{0};
+    };
+
+    mutable QMutex m_mutex;
+    std::array<Lane, PriorityCount> m_lanes;
+    QThreadPool* m_pool{nullptr};
+    QElapsedTimer m_clock;
+    int m_capacity{0};
+    int m_maxWaitMs{0};
+    QAtomicInteger<qint64> m_avgServiceUs{0};
+
+    // 调用前必须持有m_mutex
+    qint64 estimateWaitMs(int ahead) const
+    {
+        const int threads = qMax(1, m_pool->maxThreadCount());
+        return static_cast<qint64>(ahead) * m_avgServiceUs.loadRelaxed() / threads / 1000;
+    }
+
+    qint64 retryAfterMs(qint64 expectedWaitMs) const
+    {
+        // 至少等100ms，避免客户端立刻重试又被拒绝
+        return qMax<qint64>(100, expectedWaitMs);
+    }
+
+    // 工作线程：取出优先级最高的请求处理；已经超过排队期限的直接丢弃
+    void runOne()
+    {
+        Pending pending;
+        qint64 waitedMs = 0;
+        int p = 0;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (p < PriorityCount && m_lanes[p].jobs.empty())
+                ++p;
+            if (p == PriorityCount)
+                return;
+
+            Lane& lane = m_lanes[p];
+            pending = std::move(lane.jobs.front());
+            lane.jobs.pop_front();
+            waitedMs = m_clock.elapsed() - pending.enqueuedMs;
+            ++lane.dequeued;
+            lane.waitTotalUs += waitedMs * 1000;
+
+            if (m_maxWaitMs > 0 && waitedMs > m_maxWaitMs) {
+                ++lane.shed;
+                int remaining = 0;
+                for (int i = 0; i <= p; ++i)
+                    remaining += static_cast<int>(m_lanes[i].jobs.size());
+                const qint64 retryAfter = retryAfterMs(estimateWaitMs(remaining));
+                locker.unlock();
+                pending.job.shed(retryAfter);
+                return;
+            }
+        }
+
+        QElapsedTimer service;
+        service.start();
+        pending.job.run();
+
+        // 指数滑动平均（1/8权重），只用于估算排队时间，不需要很精确
+        const qint64 elapsedUs = service.nsecsElapsed() / 1000;
+        const qint64 avg = m_avgServiceUs.loadRelaxed();
+        m_avgServiceUs.storeRelaxed(avg == 0 ? elapsedUs : avg + (elapsedUs - avg) / 8);
+    }
+};
+
+#endif // DISPATCH_QUEUE_H
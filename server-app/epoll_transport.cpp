@@ -0,0 +1,267 @@
+#include "epoll_transport.h"
+
+#ifdef Q_OS_LINUX
+
+#include "async_logger.h"
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+EpollConnection::EpollConnection(EpollTransport* transport, int fd, const QHostAddress& peer, ConnectionHandler* handler)
+    : Connection(transport), m_transport(transport), m_fd(fd), m_peer(peer), m_handler(handler)
+{
+}
+
+EpollConnection::~EpollConnection()
+{
+    if (m_fd >= 0) {
+        m_transport->control(EPOLL_CTL_DEL, m_fd, 0, nullptr);
+        ::close(m_fd);
+    }
+}
+
+QByteArray EpollConnection::readAll()
+{
+    QByteArray data;
+    if (m_closed || m_closing)
+        return data;
+
+    for (int chunk = 0; chunk < MaxReadChunks; ++chunk) {
+        const qsizetype used = data.size();
+        data.resize(used + ReadChunkSize);
+        const ssize_t n = ::recv(m_fd, data.data() + used, ReadChunkSize, 0);
+        if (n > 0) {
+            data.resize(used + n);
+            // 没有读满说明内核缓冲已经读空了，省掉一次必然返回EAGAIN的recv
+            if (n < ReadChunkSize)
+                break;
+            continue;
+        }
+
+        data.resize(used);
+        if (n < 0 && errno == EINTR) {
+            --chunk;
+            continue;
+        }
+        // 对端关闭（n == 0）或出错；已经读到的数据照常交给Reactor处理
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+            markClosed();
+        break;
+    }
+    return data;
+}
+
+void EpollConnection::write(const QByteArray& data)
+{
+    if (m_closed || m_closing || data.isEmpty())
+        return;
+
+    // 已经写出的部分先丢掉，缓冲为空时append只是共享数据，不会拷贝
+    if (m_outOffset > 0) {
+        m_out.remove(0, m_outOffset);
+        m_outOffset = 0;
+    }
+    m_out.append(data);
+    flushOut();
+}
+
+void EpollConnection::setReadPaused(bool paused)
+{
+    if (m_readPaused == paused)
+        return;
+    m_readPaused = paused;
+    updateInterest();
+}
+
+void EpollConnection::close()
+{
+    if (m_closed || m_closing)
+        return;
+    m_closing = true;
+    if (bytesToWrite() == 0)
+        markClosed();
+    else
+        updateInterest();
+}
+
+void EpollConnection::handleEvents(quint32 events)
+{
+    if (m_closed)
+        return;
+
+    if (events & EPOLLOUT) {
+        flushOut();
+        if (m_closed)
+            return;
+    }
+
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        if (m_readPaused || m_closing) {
+            // 不再读数据时EPOLLIN已经去掉，这里只可能是挂断或出错，直接关闭
+            if (events & (EPOLLHUP | EPOLLERR))
+                markClosed();
+            return;
+        }
+        // readAll会发现对端关闭或出错
+        m_handler->onConnectionReadable(this);
+    }
+}
+
+void EpollConnection::flushOut()
+{
+    bool progressed = false;
+    while (m_outOffset < m_out.size()) {
+        const ssize_t n = ::send(m_fd, m_out.constData() + m_outOffset, m_out.size() - m_outOffset, MSG_NOSIGNAL);
+        if (n > 0) {
+            m_outOffset += n;
+            progressed = true;
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        markClosed();
+        return;
+    }
+
+    if (m_outOffset == m_out.size()) {
+        m_out.clear();
+        m_outOffset = 0;
+    }
+    if (progressed)
+        notifyWritten();
+
+    if (m_closing && m_out.isEmpty()) {
+        markClosed();
+        return;
+    }
+    updateInterest();
+}
+
+void EpollConnection::updateInterest()
+{
+    if (m_closed)
+        return;
+
+    quint32 events = 0;
+    if (!m_readPaused && !m_closing)
+        events |= EPOLLIN;
+    if (bytesToWrite() > 0)
+        events |= EPOLLOUT;
+
+    if (events != m_events && m_transport->control(EPOLL_CTL_MOD, m_fd, events, this))
+        m_events = events;
+}
+
+void EpollConnection::notifyWritten()
+{
+    if (m_writtenQueued)
+        return;
+    m_writtenQueued = true;
+    QMetaObject::invokeMethod(this, [this]() {
+        m_writtenQueued = false;
+        if (!m_closed)
+            m_handler->onConnectionWritten(this);
+    }, Qt::QueuedConnection);
+}
+
+void EpollConnection::markClosed()
+{
+    if (m_closed)
+        return;
+    m_closed = true;
+    m_transport->control(EPOLL_CTL_DEL, m_fd, 0, nullptr);
+    ::close(m_fd);
+    m_fd = -1;
+    m_out.clear();
+    m_outOffset = 0;
+
+    // 可能是在Reactor的readAll/write中发现的，排到下一轮事件循环再回调
+    QMetaObject::invokeMethod(this, [this]() { m_handler->onConnectionClosed(this); }, Qt::QueuedConnection);
+}
+
+EpollTransport::EpollTransport(ConnectionHandler* handler, QObject* parent)
+    : Transport(parent), m_handler(handler)
+{
+    m_epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    if (m_epollFd < 0) {
+        LOG_WARN() << "epoll_create1失败:" << std::strerror(errno);
+        return;
+    }
+
+    // epoll描述符本身可读表示有连接就绪
+    m_notifier = new QSocketNotifier(m_epollFd, QSocketNotifier::Read, this);
+    QObject::connect(m_notifier, &QSocketNotifier::activated, this, [this]() { onActivated(); });
+}
+
+EpollTransport::~EpollTransport()
+{
+    // 连接析构时要从epoll中删除自己，必须在关闭epoll描述符之前释放；除了notifier，子对象都是连接
+    delete m_notifier;
+    qDeleteAll(children());
+    if (m_epollFd >= 0)
+        ::close(m_epollFd);
+}
+
+Connection* EpollTransport::adopt(qintptr socketDescriptor)
+{
+    const int fd = static_cast<int>(socketDescriptor);
+
+    const int flags = ::fcntl(fd, F_GETFL);
+    if (flags < 0 || ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        LOG_WARN() << "接管客户端连接失败:" << std::strerror(errno);
+        ::close(fd);
+        return nullptr;
+    }
+
+    // 同一轮事件循环的响应已经合并成一次write，Nagle算法只会增加延迟
+    const int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    sockaddr_storage address;
+    socklen_t length = sizeof(address);
+    QHostAddress peer;
+    if (::getpeername(fd, reinterpret_cast<sockaddr*>(&address), &length) == 0)
+        peer.setAddress(reinterpret_cast<const sockaddr*>(&address));
+
+    EpollConnection* connection = new EpollConnection(this, fd, peer, m_handler);
+    if (!control(EPOLL_CTL_ADD, fd, EPOLLIN, connection)) {
+        LOG_WARN() << "接管客户端连接失败:" << std::strerror(errno);
+        delete connection;
+        return nullptr;
+    }
+    connection->m_events = EPOLLIN;
+    return connection;
+}
+
+void EpollTransport::onActivated()
+{
+    epoll_event events[MaxEvents];
+    int n;
+    do {
+        n = ::epoll_wait(m_epollFd, events, MaxEvents, 0);
+    } while (n < 0 && errno == EINTR);
+
+    // 回调里Reactor只会deleteLater连接，这一批事件处理完之前指针都有效
+    for (int i = 0; i < n; ++i)
+        static_cast<EpollConnection*>(events[i].data.ptr)->handleEvents(events[i].events);
+}
+
+bool EpollTransport::control(int op, int fd, quint32 events, EpollConnection* connection)
+{
+    if (m_epollFd < 0)
+        return false;
+    epoll_event event;
+    std::memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.ptr = connection;
+    return ::epoll_ctl(m_epollFd, op, fd, &event) == 0;
+}
+
+#endif // Q_OS_LINUX
@@ -0,0 +1,93 @@
+/*
+该文件实现基于Linux epoll的传输层（--transport epoll）
+每个Reactor一个epoll实例，epoll的描述符挂在Reactor事件循环的一个QSocketNotifier上：
+事件循环每次醒来，一次epoll_wait取出一批就绪的连接直接处理，不再为每个连接各注册一个QSocketNotifier。
+  读：水平触发，可读时回调Reactor，Reactor调用readAll()直接recv进一个QByteArray，没有Qt读缓冲的额外拷贝；
+      暂停读取就是把EPOLLIN去掉，数据留在内核里。
+  写：write()先直接send，写不完的部分缓冲起来并关注EPOLLOUT，可写时继续发送；
+      写出进度合并后在下一轮事件循环回调Reactor（和QTcpSocket的bytesWritten一样不会重入）。
+  关闭：close()先停止读取，发送缓冲写完后再关闭描述符；对端断开或出错时同样在下一轮事件循环回调一次。
+仅在Linux上编译，其他平台选择epoll时退回qt实现。
+*/
+#ifndef EPOLL_TRANSPORT_H
+#define EPOLL_TRANSPORT_H
+
+#include <QtGlobal>
+
+#ifdef Q_OS_LINUX
+
+#include <QSocketNotifier>
+#include "transport.h"
+
+class EpollTransport;
+
+class EpollConnection : public Connection
+{
+public:
+    EpollConnection(EpollTransport* transport, int fd, const QHostAddress& peer, ConnectionHandler* handler);
+    ~EpollConnection() override;
+
+    QByteArray readAll() override;
+    // 不在用户态缓冲收到的数据，未读的数据都在内核里
+    qint64 bytesAvailable() const override { return 0; }
+    void write(const QByteArray& data) override;
+    qint64 bytesToWrite() const override { return m_out.size() - m_outOffset; }
+    void setReadPaused(bool paused) override;
+    QHostAddress peerAddress() const override { return m_peer; }
+    void close() override;
+
+private:
+    friend class EpollTransport;
+
+    // 一次readAll最多读这么多块，剩下的等下一轮（水平触发会再次通知），避免一个连接占住整个Reactor
+    static constexpr int ReadChunkSize = 64 * 1024;
+    static constexpr int MaxReadChunks = 16;
+
+    EpollTransport* m_transport;
+    int m_fd;
+    QHostAddress m_peer;
+    ConnectionHandler* m_handler;
+
+    QByteArray m_out;               // 还没写进内核的数据，从m_outOffset开始
+    qsizetype m_outOffset{0};
+    quint32 m_events{0};            // 当前在epoll中关注的事件
+    bool m_readPaused{false};
+    bool m_closing{false};          // 已调用close()，等待发送缓冲写完
+    bool m_closed{false};           // 描述符已关闭，之后不再有任何回调
+    bool m_writtenQueued{false};    // 是否已投递onConnectionWritten
+
+    void handleEvents(quint32 events);
+    void flushOut();
+    void updateInterest();
+    void notifyWritten();
+    void markClosed();
+};
+
+class EpollTransport : public Transport
+{
+public:
+    EpollTransport(ConnectionHandler* handler, QObject* parent);
+    ~EpollTransport() override;
+
+    // epoll_create失败时为false
+    bool isValid() const { return m_epollFd >= 0; }
+
+    Connection* adopt(qintptr socketDescriptor) override;
+
+private:
+    friend class EpollConnection;
+
+    // 一次epoll_wait最多取出的事件数，剩下的留给下一轮
+    static constexpr int MaxEvents = 256;
+
+    ConnectionHandler* m_handler;
+    int m_epollFd{-1};
+    QSocketNotifier* m_notifier{nullptr};
+
+    void onActivated();
+    bool control(int op, int fd, quint32 events, EpollConnection* connection);
+};
+
+#endif // Q_OS_LINUX
+
+#endif // EPOLL_TRANSPORT_H
@@ -0,0 +1,169 @@
+#include "group_commit.h"
+#include "database_manager.h"
+#include "request_tracer.h"
+#include "async_logger.h"
+#include <QThread>
+#include <QDeadlineTimer>
+
+static QJsonObject commitFailedResponse(const QString& message)
+{
+    return {
+        {"status", "error"},
+        {"message", message},
+        {"data", QJsonValue()}
+    };
+}
+
+GroupCommitWriter::GroupCommitWriter(int maxBatch, int windowMs)
+    : m_maxBatch(qMax(1, maxBatch)), m_windowMs(qMax(0, windowMs))
+{
+}
+
+GroupCommitWriter::~GroupCommitWriter()
+{
+    stop();
+}
+
+void GroupCommitWriter::start()
+{
+    if (m_thread)
+        return;
+    m_accepting.storeRelease(1);
+    m_thread = QThread::create([this]() { run(); });
+    m_thread->setObjectName(QStringLiteral("group-commit"));
+    m_thread->start();
+    LOG_INFO() << "写操作组提交已开启，每批最多" << m_maxBatch << "条，凑批窗口(ms):" << m_windowMs;
+}
+
+void GroupCommitWriter::stop()
+{
+    if (!m_thread)
+        return;
+    m_accepting.storeRelease(0);
+    // 结束标记（没有run的任务）排在所有已提交的任务之后
+    m_queue.push(Task());
+    m_available.release();
+    m_thread->wait();
+    delete m_thread;
+    m_thread = nullptr;
+}
+
+bool GroupCommitWriter::submit(Task task)
+{
+    if (!m_accepting.loadAcquire())
+        return false;
+    m_queue.push(std::move(task));
+    m_available.release();
+    return true;
+}
+
+GroupCommitWriter::Task GroupCommitWriter::take()
+{
+    // 信号量已经确认有任务，pop失败只是生产者还没把节点链接好，稍等即可
+    Task task;
+    while (!m_queue.pop(task))
+        QThread::yieldCurrentThread();
+    return task;
+}
+
+void GroupCommitWriter::run()
+{
+    bool stopping = false;
+    while (!stopping) {
+        m_available.acquire();
+        Task first = take();
+        if (!first.run)
+            break;
+
+        commitBatch(std::move(first), stopping);
+    }
+
+    // 停止之后才提交进来的任务（与stop()竞争的极少数）直接回复错误
+    while (m_available.tryAcquire()) {
+        Task task = take();
+        if (task.done)
+            task.done(commitFailedResponse("服务器正在关闭，请稍后再试"));
+    }
+}
+
+void GroupCommitWriter::commitBatch(Task first, bool& stopping)
+{
+    QList<Finished> finished;
+    bool committed = false;
+    qint64 commitStartUs = 0;
+    qint64 commitEndUs = 0;
+    {
+        // 整批持有写租约；处理函数自己借的写租约在同一线程上是重入的
+        DatabaseLease lease(DatabaseManager::Role::Write);
+        QSqlDatabase db = DatabaseManager::instance().database();
+        const bool open = db.transaction();
+        if (!open)
+            LOG_WARN() << "组提交无法开启事务:" << db.lastError().text();
+        DatabaseManager::inGroupCommit() = open;
+
+        auto apply = [&](Task& task) {
+            if (!open) {
+                finished.append({std::move(task), commitFailedResponse("无法开启事务：" + db.lastError().text())});
+                return;
+            }
+            // 每条请求一个保存点：失败的请求只撤销自己的修改
+            CachedQuery savepoint(Sql::SavepointRequest);
+            if (!savepoint->exec()) {
+                finished.append({std::move(task), commitFailedResponse("无法创建保存点：" + savepoint->lastError().text())});
+                return;
+            }
+            QJsonObject response = task.run();
+            if (response["status"].toString() == "error") {
+                CachedQuery rollback(Sql::RollbackToRequest);
+                rollback->exec();
+            }
+            CachedQuery release(Sql::ReleaseRequest);
+            release->exec();
+            finished.append({std::move(task), response});
+        };
+
+        apply(first);
+        // 凑批次：先取已经排队的，再在窗口内等新的
+        QDeadlineTimer window(m_windowMs);
+        while (finished.size() < m_maxBatch) {
+            if (!m_available.tryAcquire(1, static_cast<int>(window.remainingTime())))
+                break;
+            Task task = take();
+            if (!task.run) {
+                stopping = true;
+                break;
+            }
+            apply(task);
+        }
+
+        if (open) {
+            commitStartUs = RequestTracer::instance().nowUs();
+            committed = db.commit();
+            commitEndUs = RequestTracer::instance().nowUs();
+            if (!committed) {
+                LOG_WARN() << "组提交失败，整批" << finished.size() << "条请求回滚:" << db.lastError().text();
+                db.rollback();
+            }
+        }
+        DatabaseManager::inGroupCommit() = false;
+        if (m_afterCommit)
+            m_afterCommit(committed);
+    }
+
+    m_batches.fetchAndAddRelaxed(1);
+    if (committed)
+        m_tasks.fetchAndAddRelaxed(static_cast<quint64>(finished.size()));
+    if (finished.size() > m_largestBatch.loadRelaxed())
+        m_largestBatch.storeRelaxed(static_cast<int>(finished.size()));
+
+    // 提交（落盘）之后才回复
+    for (Finished& item : finished) {
+        if (!committed && item.response["status"].toString() != "error")
+            item.response = commitFailedResponse("提交事务失败，请重试");
+        if (item.task.traceId && commitEndUs > 0)
+            RequestTracer::instance().record(item.task.traceId, "group_commit", commitStartUs, commitEndUs,
+                                             QString("batch=%1").arg(finished.size()));
+        if (item.task.done)
+            item.task.done(item.response);
+    }
+}
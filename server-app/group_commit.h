@@ -0,0 +1,84 @@
+/*
+该文件实现写操作的组提交（group commit）
+原来每个写请求（注册、修改资料、管理员增删改航班等）各自提交一次，每次提交都要单独落盘一次，落盘次数就是写操作的吞吐上限。
+订票、退票不经过这里：它们追加到订单日志（booking_journal.h），同时到达的追加在那里共用一次fsync，再由日志的后台线程成批写回。
+开启后（线程池模式，--group-commit 大于0），其余的写操作都由Reactor直接交给这里唯一的写线程：
+  1. 请求通过无锁的MPSC队列（mpsc_queue.h）进入写线程，提交方不会阻塞；
+  2. 写线程取得写租约，开启一个事务，依次执行排队的请求：每条请求在自己的保存点（SAVEPOINT）里执行，
+     失败的请求只回滚到自己的保存点，不影响同一批的其他请求（处理函数自己不开启事务）；
+  3. 队列取空、批次达到上限、或者等待窗口（--commit-window）到期后，整批只提交（落盘）一次；
+  4. 提交成功之后才把响应交回各自的Reactor；提交失败时整批都回复错误。
+队列里有积压时一批自然就会变大，所以即使窗口为0，压力越大每次提交分摊到的请求越多。
+*/
+#ifndef GROUP_COMMIT_H
+#define GROUP_COMMIT_H
+
+#include <QtGlobal>
+#include <QJsonObject>
+#include <QSemaphore>
+#include <QAtomicInteger>
+#include <QList>
+#include <functional>
+#include "mpsc_queue.h"
+
+class QThread;
+
+class GroupCommitWriter
+{
+public:
+    struct Task {
+        quint64 traceId{0};
+        // 在写线程中执行一条请求，返回响应（status为error时回滚到该请求的保存点）
+        std::function<QJsonObject()> run;
+        // 批次提交之后在写线程中调用，交回最终的响应（需要自己投递回Reactor线程）
+        // 提交失败时交回的是写线程生成的错误响应，不带action与request_id
+        std::function<void(const QJsonObject&)> done;
+    };
+
+    // maxBatch：一批最多的请求数；windowMs：拿到第一条请求后最多再等多久凑批次（0为不等待，只取已经排队的）
+    GroupCommitWriter(int maxBatch, int windowMs);
+    ~GroupCommitWriter();
+
+    // 每批事务结束后在写线程中调用：committed表示这批修改是否已经提交
+    void setAfterCommit(std::function<void(bool committed)> afterCommit) { m_afterCommit = std::move(afterCommit); }
+
+    void start();
+    // 处理完已经排队的请求后停止写线程
+    void stop();
+
+    // 任意线程：提交一条写请求；写线程已经停止时返回false
+    bool submit(Task task);
+
+    int maxBatch() const { return m_maxBatch; }
+    int windowMs() const { return m_windowMs; }
+    quint64 batches() const { return m_batches.loadRelaxed(); }
+    quint64 committedTasks() const { return m_tasks.loadRelaxed(); }
+    int largestBatch() const { return m_largestBatch.loadRelaxed(); }
+
+private:
+    struct Finished {
+        Task task;
+        QJsonObject response;
+    };
+
+    void run();
+    // 取一条已经确认存在的任务（可能要等生产者把节点链接好）
+    Task take();
+    // 以first开始执行一批请求并提交；取到结束标记时把stopping置为true
+    void commitBatch(Task first, bool& stopping);
+
+    const int m_maxBatch;
+    const int m_windowMs;
+    std::function<void(bool)> m_afterCommit;
+
+    MpscQueue<Task> m_queue;
+    QSemaphore m_available;         // 队列中的任务数
+    QAtomicInt m_accepting{0};
+    QThread* m_thread{nullptr};
+
+    QAtomicInteger<quint64> m_batches{0};
+    QAtomicInteger<quint64> m_tasks{0};
+    QAtomicInt m_largestBatch{0};
+};
+
+#endif // GROUP_COMMIT_H
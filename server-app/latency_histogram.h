@@ -0,0 +1,99 @@
+/*
+该文件实现无锁的耗时直方图（对数-线性分桶，类似HdrHistogram）
+把微秒数按最高位分成若干段（每段是上一段的两倍），每段再等分成SubBucketCount个桶，
+所以任何取值的相对误差都不超过 1/SubBucketCount（约6%），而桶的总数是固定的（几百个），
+不需要预先知道耗时的分布。
+记录一次只是几个原子加法，任意线程都可以同时记录；读取时复制一份快照再算百分位数，
+快照期间仍在记录的数据可能只算进去一部分，对统计用途没有影响。
+*/
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <QtGlobal>
+#include <QAtomicInteger>
+#include <array>
+#include <cmath>
+
+class LatencyHistogram
+{
+public:
+    static constexpr int SubBucketBits = 4;
+    static constexpr int SubBucketCount = 1 << SubBucketBits;
+    // 能区分的最大值是 2^MaxExponent - 1 微秒（约19小时），更大的值都记在最后一个桶
+    static constexpr int MaxExponent = 36;
+    static constexpr int BucketCount = (MaxExponent - SubBucketBits + 1) * SubBucketCount;
+    static constexpr quint64 MaxValue = (quint64(1) << MaxExponent) - 1;
+
+    void record(quint64 us)
+    {
+        us = qMin(us, MaxValue);
+        m_buckets[bucketOf(us)].fetchAndAddRelaxed(1);
+        m_count.fetchAndAddRelaxed(1);
+        m_sum.fetchAndAddRelaxed(us);
+
+        quint64 max = m_max.loadRelaxed();
+        while (us > max && !m_max.testAndSetRelaxed(max, us, max)) {}
+    }
+
+    struct Snapshot {
+        quint64 count{0};
+        quint64 sumUs{0};
+        quint64 maxUs{0};
+        std::array<quint64, BucketCount> buckets{};
+
+        quint64 meanUs() const { return count > 0 ? sumUs / count : 0; }
+
+        // 百分位数（0~100），返回所在桶的上界，不会超过记录到的最大值
+        quint64 percentileUs(double percentile) const
+        {
+            if (count == 0)
+                return 0;
+            const quint64 target = qMax<quint64>(1, static_cast<quint64>(std::ceil(percentile / 100.0 * count)));
+            quint64 seen = 0;
+            for (int i = 0; i < BucketCount; ++i) {
+                seen += buckets[i];
+                if (seen >= target)
+                    return qMin(upperBoundOf(i), maxUs);
+            }
+            return maxUs;
+        }
+    };
+
+    Snapshot snapshot() const
+    {
+        Snapshot snapshot;
+        for (int i = 0; i < BucketCount; ++i)
+            snapshot.buckets[i] = m_buckets[i].loadRelaxed();
+        snapshot.count = m_count.loadRelaxed();
+        snapshot.sumUs = m_sum.loadRelaxed();
+        snapshot.maxUs = m_max.loadRelaxed();
+        return snapshot;
+    }
+
+    // 小于SubBucketCount的值每个值一个桶；其余按最高位所在的段定位，再取最高位之后的SubBucketBits位作为段内下标
+    static int bucketOf(quint64 us)
+    {
+        if (us < SubBucketCount)
+            return static_cast<int>(us);
+        const int msb = 63 - qCountLeadingZeroBits(us);
+        const int shift = msb - SubBucketBits;
+        return (shift + 1) * SubBucketCount + static_cast<int>((us >> shift) - SubBucketCount);
+    }
+
+    static quint64 upperBoundOf(int bucket)
+    {
+        if (bucket < SubBucketCount)
+            return static_cast<quint64>(bucket);
+        const int shift = bucket / SubBucketCount - 1;
+        const quint64 sub = static_cast<quint64>(bucket % SubBucketCount + SubBucketCount);
+        return ((sub + 1) << shift) - 1;
+    }
+
+private:
+    std::array<QAtomicInteger<quint64>, BucketCount> m_buckets{};
+    QAtomicInteger<quint64> m_count{0};
+    QAtomicInteger<quint64> m_sum{0};
+    QAtomicInteger<quint64> m_max{0};
+};
+
+#endif // LATENCY_HISTOGRAM_H
@@ -4,6 +4,8 @@
 
 #include "database_manager.h"
 #include "tcp_server.h"
+#include "server_config.h"
+#include "async_logger.h"
 
 int main(int argc, char *argv[])
 {
@@ -22,16 +24,37 @@ int main(int argc, char *argv[])
     // 使用 QCoreApplication（而不是 QApplication）
     QCoreApplication a(argc, argv);
 
-    qInfo() << "服务器启动中...";
+    // 日志由后台线程写出；解析参数之前先用默认级别（info）
+    AsyncLogger::instance().start();
 
-    if (!DatabaseManager::instance().init()) {
-        qCritical() << "数据库初始化失败，服务器退出。";
+    // 解析命令行参数，例如: server-app --port 12345 --workers 4
+    ServerConfig config = ServerConfig::fromArguments(a);
+    AsyncLogger::setLevel(config.logLevel);
+
+    LOG_INFO() << "服务器启动中...";
+
+    if (!DatabaseManager::instance().init(config.dbProfile)) {
+        LOG_CRITICAL() << "数据库初始化失败，服务器退出。";
+        AsyncLogger::instance().stop();
         return -1;
     }
 
     // 创建并启动 TCP 服务器
     TcpServer server;
-    server.startServer(12345); // 监听 12345 端口
-
-    return a.exec();
+    server.setWorkerThreads(config.workerThreads);
+    server.setReactorCount(config.reactorThreads);
+    server.setConnectionLimits(config.maxFrameSize, config.writeHighWatermark, config.writeLowWatermark);
+    server.setCompressThreshold(config.compressThreshold);
+    server.setTimeouts(config.handshakeTimeoutMs, config.idleTimeoutMs, config.requestTimeoutMs);
+    server.setRateLimits(config.rateQueryPerSec, config.rateBookingPerSec, config.rateAccountPerSec);
+    server.setQueueLimits(config.queueCapacity, config.queueWaitMs);
+    server.setGroupCommit(config.groupCommitBatch, config.groupCommitWindowMs);
+    server.setTransport(config.transport);
+    server.setTracing(config.traceFile, config.traceSampleEvery);
+    server.startServer(config.port); // 默认监听 12345 端口
+
+    const int exitCode = a.exec();
+    // 写出缓冲中剩余的日志，之后（例如析构时）的日志直接同步输出
+    AsyncLogger::instance().stop();
+    return exitCode;
 }
@@ -0,0 +1,66 @@
+/*
+该文件实现一个无锁的多生产者单消费者队列（Vyukov的侵入式链表队列）
+任意线程都可以push（一次原子交换，不会阻塞，也不会因为别的生产者被挂起而等待），
+只有一个消费者线程可以pop。
+push和对应节点链接进链表之间有一个很短的窗口：这时pop会暂时返回false，
+所以消费者应当用计数（例如QSemaphore）确认确实有元素后，循环pop直到拿到为止。
+用法见group_commit.h。
+*/
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <QAtomicPointer>
+#include <utility>
+
+template <typename T>
+class MpscQueue
+{
+public:
+    MpscQueue() : m_head(new Node), m_tail(m_head.loadRelaxed()) {}
+
+    ~MpscQueue()
+    {
+        T value;
+        while (pop(value)) {}
+        delete m_tail;
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    // 任意线程
+    void push(T value)
+    {
+        Node* node = new Node;
+        node->value = std::move(value);
+        // acquire：拿到前一个生产者对previous的初始化（next为空）；release：把node的初始化交给下一个生产者
+        Node* previous = m_head.fetchAndStoreOrdered(node);
+        previous->next.storeRelease(node);
+    }
+
+    // 只能在消费者线程调用；队列为空（或者最新的元素还没链接好）时返回false
+    bool pop(T& value)
+    {
+        Node* tail = m_tail;
+        Node* next = tail->next.loadAcquire();
+        if (!next)
+            return false;
+        // next成为新的哨兵节点，它的值已经取走
+        value = std::move(next->value);
+        next->value = T();
+        m_tail = next;
+        delete tail;
+        return true;
+    }
+
+private:
+    struct Node {
+        QAtomicPointer<Node> next{nullptr};
+        T value{};
+    };
+
+    QAtomicPointer<Node> m_head;    // 生产者：最后一个节点
+    Node* m_tail;                   // 消费者：哨兵节点，它的next是队首
+};
+
+#endif // MPSC_QUEUE_H
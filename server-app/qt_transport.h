@@ -0,0 +1,81 @@
+/*
+该文件实现基于QTcpSocket的传输层（默认实现，所有平台可用）
+行为和改造前的ClientReactor一致：QTcpSocket的readyRead/bytesWritten/disconnected信号转成ConnectionHandler回调，
+暂停读取通过把Qt的读缓冲限制到很小来实现。
+*/
+#ifndef QT_TRANSPORT_H
+#define QT_TRANSPORT_H
+
+#include <QTcpSocket>
+#include "async_logger.h"
+#include "transport.h"
+#include "frame_decoder.h"
+
+class QtConnection : public Connection
+{
+public:
+    QtConnection(QTcpSocket* socket, ConnectionHandler* handler, QObject* parent)
+        : Connection(parent), m_socket(socket)
+    {
+        m_socket->setParent(this);
+        QObject::connect(m_socket, &QTcpSocket::readyRead, this, [this, handler]() { handler->onConnectionReadable(this); });
+        QObject::connect(m_socket, &QTcpSocket::bytesWritten, this, [this, handler]() { handler->onConnectionWritten(this); });
+        QObject::connect(m_socket, &QTcpSocket::disconnected, this, [this, handler]() {
+            // disconnected可能在close()内部同步发出，统一排到下一轮事件循环再回调，和epoll实现保持一致
+            if (m_closed)
+                return;
+            m_closed = true;
+            QMetaObject::invokeMethod(this, [this, handler]() { handler->onConnectionClosed(this); }, Qt::QueuedConnection);
+        });
+    }
+
+    QByteArray readAll() override { return m_socket->readAll(); }
+    qint64 bytesAvailable() const override { return m_socket->bytesAvailable(); }
+    void write(const QByteArray& data) override
+    {
+        // 已经调用过close()的连接不再接受新数据（和epoll实现一致）
+        if (!m_closing)
+            m_socket->write(data);
+    }
+    qint64 bytesToWrite() const override { return m_socket->bytesToWrite(); }
+
+    void setReadPaused(bool paused) override
+    {
+        // 限制Qt的读缓冲，让未读数据留在内核里；0 表示不限制
+        m_socket->setReadBufferSize(paused ? FrameDecoder::HeaderSize : 0);
+    }
+
+    QHostAddress peerAddress() const override { return m_socket->peerAddress(); }
+    void close() override
+    {
+        m_closing = true;
+        m_socket->disconnectFromHost();
+    }
+
+private:
+    QTcpSocket* m_socket;
+    bool m_closing{false};
+    bool m_closed{false};
+};
+
+class QtTransport : public Transport
+{
+public:
+    QtTransport(ConnectionHandler* handler, QObject* parent) : Transport(parent), m_handler(handler) {}
+
+    Connection* adopt(qintptr socketDescriptor) override
+    {
+        QTcpSocket* socket = new QTcpSocket;
+        if (!socket->setSocketDescriptor(socketDescriptor)) {
+            LOG_WARN() << "接管客户端连接失败:" << socket->errorString();
+            delete socket;
+            return nullptr;
+        }
+        return new QtConnection(socket, m_handler, this);
+    }
+
+private:
+    ConnectionHandler* m_handler;
+};
+
+#endif // QT_TRANSPORT_H
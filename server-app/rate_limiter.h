@@ -0,0 +1,208 @@
+/*
+该文件实现服务器的令牌桶限流
+每个请求按action所属的限流类别（ActionSpec::RateClass，例如查询和订票分开计算），
+分别从三个桶里各取一个令牌：客户端tag、登录的用户（未登录不限）、对端IP。
+任意一个桶没有令牌就直接拒绝，并告诉客户端大约多久之后可以重试；这一步在Reactor里完成，不会碰数据库。
+同一IP下可能有很多客户端，所以IP的桶是单个客户端预算的IpBudgetFactor倍。
+
+桶的数量可能非常多（每个tag、用户、IP × 每个类别），所以每个桶只存8字节：
+剩余令牌数（float）和上次补充的时间（相对启动时间的毫秒数，32位，差值按无符号计算，回绕也没关系）。
+桶的键把范围、类别和身份压缩成一个64位整数；按键分到多个分片，每个分片一把锁，减少Reactor之间的竞争。
+长时间没有访问的桶已经补满，和新建的桶没有区别，会在分片变大时被顺手清理掉。
+*/
+#ifndef RATE_LIMITER_H
+#define RATE_LIMITER_H
+
+#include <QtGlobal>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QHostAddress>
+#include <QElapsedTimer>
+#include <array>
+#include <cmath>
+#include "action_registry.h"
+
+class RateLimiter
+{
+public:
+    // 每个类别的预算：每秒补充的令牌数与桶容量（允许的突发请求数）
+    struct Budget {
+        double ratePerSec{0};
+        double burst{0};
+
+        bool enabled() const { return ratePerSec > 0 && burst >= 1; }
+    };
+
+    // 同一IP的预算是单个客户端的几倍
+    static constexpr int IpBudgetFactor = 4;
+
+    RateLimiter() { m_clock.start(); }
+
+    // 设置某个类别的预算（必须在服务器启动前调用），ratePerSec为0表示该类别不限流
+    void setBudget(ActionSpec::RateClass rateClass, Budget budget)
+    {
+        m_budgets[static_cast<int>(rateClass)] = budget;
+    }
+
+    Budget budget(ActionSpec::RateClass rateClass) const
+    {
+        return m_budgets[static_cast<int>(rateClass)];
+    }
+
+    // 为一个请求取令牌（线程安全）：返回0表示放行，否则返回建议的重试等待时间（毫秒）
+    // userId为0表示未登录，只检查tag和IP
+    qint64 acquire(ActionSpec::RateClass rateClass, const QString& tag, int userId, const QHostAddress& peer)
+    {
+        const Budget tagBudget = m_budgets[static_cast<int>(rateClass)];
+        if (!tagBudget.enabled())
+            return 0;
+        const Budget peerBudget{tagBudget.ratePerSec * IpBudgetFactor, tagBudget.burst * IpBudgetFactor};
+
+        const quint32 now = static_cast<quint32>(m_clock.elapsed());
+
+        const quint64 tagKey = makeKey(Scope::Tag, rateClass, qHash(tag));
+        qint64 retryAfter = take(tagKey, tagBudget, now);
+        if (retryAfter > 0)
+            return retryAfter;
+
+        quint64 userKey = 0;
+        if (userId > 0) {
+            userKey = makeKey(Scope::User, rateClass, static_cast<quint64>(userId));
+            retryAfter = take(userKey, tagBudget, now);
+            if (retryAfter > 0) {
+                refund(tagKey, tagBudget);
+                return retryAfter;
+            }
+        }
+
+        const quint64 peerKey = makeKey(Scope::Peer, rateClass, peerIdentity(peer));
+        retryAfter = take(peerKey, peerBudget, now);
+        if (retryAfter > 0) {
+            // 前面的桶已经扣过了，被IP拦下时还回去
+            refund(tagKey, tagBudget);
+            if (userKey != 0)
+                refund(userKey, tagBudget);
+            return retryAfter;
+        }
+        return 0;
+    }
+
+    // 当前所有分片中的桶数
+    int bucketCount() const
+    {
+        int count = 0;
+        for (const Shard& shard : m_shards) {
+            QMutexLocker locker(&shard.mutex);
+            count += shard.buckets.size();
+        }
+        return count;
+    }
+
+private:
+    enum class Scope : quint8 {
+        Tag,
+        User,
+        Peer
+    };
+
+    struct Bucket {
+        float tokens;
+        quint32 stampMs;
+    };
+    static_assert(sizeof(Bucket) == 8, "Bucket应保持8字节");
+
+    struct Shard {
+        mutable QMutex mutex;
+        QHash<quint64, Bucket> buckets;
+        int sweepAt{SweepThreshold};   // 桶数超过该值时清理一次
+    };
+
+    static constexpr int ShardCount = 16;
+    static constexpr int SweepThreshold = 4096;
+    static constexpr int ClassCount = static_cast<int>(ActionSpec::RateClass::Account) + 1;
+
+    QElapsedTimer m_clock;
+    std::array<Budget, ClassCount> m_budgets{};
+    std::array<Shard, ShardCount> m_shards;
+
+    // 键：高2位是范围，接着6位是类别，低56位是身份（用户id、IPv4地址，或tag/IPv6的哈希）
+    static quint64 makeKey(Scope scope, ActionSpec::RateClass rateClass, quint64 identity)
+    {
+        return (static_cast<quint64>(scope) << 62)
+             | (static_cast<quint64>(rateClass) << 56)
+             | (identity & 0x00FFFFFFFFFFFFFFull);
+    }
+
+    static quint64 peerIdentity(const QHostAddress& peer)
+    {
+        bool isIpv4 = false;
+        const quint32 ipv4 = peer.toIPv4Address(&isIpv4);
+        return isIpv4 ? ipv4 : static_cast<quint64>(qHash(peer));
+    }
+
+    Shard& shardOf(quint64 key)
+    {
+        // 低位是身份，混合一下再取模，避免连续的用户id都落在同一个分片
+        return m_shards[(key ^ (key >> 29)) % ShardCount];
+    }
+
+    qint64 take(quint64 key, const Budget& budget, quint32 now)
+    {
+        Shard& shard = shardOf(key);
+        QMutexLocker locker(&shard.mutex);
+
+        auto it = shard.buckets.find(key);
+        if (it == shard.buckets.end()) {
+            if (shard.buckets.size() >= shard.sweepAt)
+                sweep(shard, now);
+            // 新桶是满的，这次请求直接从里面扣
+            shard.buckets.insert(key, Bucket{static_cast<float>(budget.burst - 1), now});
+            return 0;
+        }
+
+        Bucket& bucket = *it;
+        const double refilled = (now - bucket.stampMs) / 1000.0 * budget.ratePerSec;
+        const double tokens = qMin(budget.burst, bucket.tokens + refilled);
+        bucket.stampMs = now;
+
+        if (tokens < 1.0) {
+            bucket.tokens = static_cast<float>(tokens);
+            return qMax<qint64>(1, static_cast<qint64>(std::ceil((1.0 - tokens) / budget.ratePerSec * 1000.0)));
+        }
+
+        bucket.tokens = static_cast<float>(tokens - 1.0);
+        return 0;
+    }
+
+    void refund(quint64 key, const Budget& budget)
+    {
+        Shard& shard = shardOf(key);
+        QMutexLocker locker(&shard.mutex);
+        auto it = shard.buckets.find(key);
+        if (it != shard.buckets.end())
+            it->tokens = static_cast<float>(qMin(budget.burst, it->tokens + 1.0));
+    }
+
+    // 删除已经补满的桶（调用前必须持有分片的锁）；不知道桶属于哪个预算，按最大的补满时间保守判断
+    void sweep(Shard& shard, quint32 now)
+    {
+        double fullAfterMs = 0;
+        for (const Budget& budget : m_budgets) {
+            if (budget.enabled())
+                fullAfterMs = qMax(fullAfterMs, budget.burst * IpBudgetFactor / budget.ratePerSec * 1000.0);
+        }
+
+        for (auto it = shard.buckets.begin(); it != shard.buckets.end();) {
+            if (now - it->stampMs >= fullAfterMs)
+                it = shard.buckets.erase(it);
+            else
+                ++it;
+        }
+
+        // 清理后仍然很大就把阈值调高，避免每次新建桶都全表扫描
+        shard.sweepAt = qMax(SweepThreshold, static_cast<int>(shard.buckets.size()) * 2);
+    }
+};
+
+#endif // RATE_LIMITER_H
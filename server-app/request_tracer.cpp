@@ -0,0 +1,117 @@
+#include "request_tracer.h"
+#include "async_logger.h"
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <utility>
+
+thread_local quint64 RequestTracer::t_current = 0;
+
+RequestTracer& RequestTracer::instance()
+{
+    static RequestTracer tracer;
+    return tracer;
+}
+
+bool RequestTracer::open(const QString& path, int sampleEvery)
+{
+    QMutexLocker locker(&m_mutex);
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        LOG_WARN() << "无法打开trace文件:" << path << m_file.errorString();
+        return false;
+    }
+    // JSON数组格式：结尾的]可以没有，进程异常退出时文件也能打开
+    m_file.write("[\n");
+    m_firstEvent = true;
+    m_sampleEvery.storeRelaxed(qMax(0, sampleEvery));
+    LOG_INFO() << "请求追踪已开启，文件:" << path << "采样: 每" << sampleEvery << "条请求追踪一条";
+    return true;
+}
+
+void RequestTracer::close()
+{
+    m_sampleEvery.storeRelaxed(0);
+    flush();
+    QMutexLocker locker(&m_mutex);
+    if (m_file.isOpen()) {
+        m_file.write("\n]\n");
+        m_file.close();
+    }
+}
+
+quint64 RequestTracer::sample()
+{
+    const int every = m_sampleEvery.loadRelaxed();
+    if (every <= 0)
+        return 0;
+    thread_local quint32 counter = 0;
+    if (++counter % static_cast<quint32>(every) != 0)
+        return 0;
+    return m_nextTraceId.fetchAndAddRelaxed(1);
+}
+
+void RequestTracer::record(quint64 traceId, const char* name, qint64 startUs, qint64 endUs, const QString& detail)
+{
+    if (traceId == 0)
+        return;
+    // 线程编号从1开始，比线程句柄短，Perfetto里按它分组显示
+    thread_local const int threadIndex = m_nextThreadIndex.fetchAndAddRelaxed(1);
+
+    QMutexLocker locker(&m_mutex);
+    if (m_pending.size() >= MaxPendingSpans) {
+        ++m_dropped;
+        return;
+    }
+    m_pending.append({traceId, name, startUs, qMax(startUs, endUs), threadIndex, detail});
+}
+
+void RequestTracer::flush()
+{
+    QList<Span> spans;
+    quint64 dropped = 0;
+    bool first = true;
+    {
+        QMutexLocker locker(&m_mutex);
+        spans.swap(m_pending);
+        dropped = std::exchange(m_dropped, 0);
+        first = m_firstEvent;
+    }
+    if (dropped > 0)
+        LOG_WARN() << "trace缓冲已满，丢弃了" << dropped << "个span";
+    if (spans.isEmpty())
+        return;
+
+    // 每个span写成一对异步事件（b/e），同一个trace id的span显示在同一条轨道上
+    QByteArray out;
+    auto appendEvent = [&](const Span& span, const char* phase, qint64 ts) {
+        QJsonObject event;
+        event["name"] = QLatin1String(span.name);
+        event["cat"]  = "request";
+        event["ph"]   = phase;
+        event["id"]   = QString::number(span.traceId);
+        event["ts"]   = ts;
+        event["pid"]  = 1;
+        event["tid"]  = span.threadIndex;
+        if (phase[0] == 'b') {
+            QJsonObject args{{"trace_id", static_cast<qint64>(span.traceId)}};
+            if (!span.detail.isEmpty())
+                args["detail"] = span.detail;
+            event["args"] = args;
+        }
+        if (!first)
+            out += ",\n";
+        first = false;
+        out += QJsonDocument(event).toJson(QJsonDocument::Compact);
+    };
+    for (const Span& span : std::as_const(spans)) {
+        appendEvent(span, "b", span.startUs);
+        appendEvent(span, "e", span.endUs);
+    }
+
+    QMutexLocker locker(&m_mutex);
+    if (!m_file.isOpen())
+        return;
+    m_file.write(out);
+    m_file.flush();
+    m_firstEvent = first;
+}
@@ -0,0 +1,136 @@
+/*
+该文件实现按请求采样的链路追踪（输出Chrome trace-event格式，可以直接用Perfetto / chrome://tracing打开）
+Reactor解码出一条业务请求后，按采样率决定是否追踪：被选中的请求分配一个trace id，
+之后这条请求经过的每一步都记录一个span：
+  parse（解码）→ queue（在线程池前排队）→ handler（处理函数）→ 处理函数里的各个SQL步骤（包括等锁）
+  → serialize（编码响应）→ write（等待写出）
+trace id在Reactor中随请求一起传递；在工作线程里通过TraceScope放进线程局部变量，
+处理函数中只要写 TraceSpan span("book_flight.update_seats"); 就会记到当前请求下，不需要层层传参。
+没有被采样的请求上，TraceSpan只读一次线程局部变量，可以在生产环境以较低的采样率一直开着。
+span先放在内存里，由主线程定时追加到 --trace-file 指定的文件（JSON数组格式）；
+每条请求是一个单独的异步轨道（id为trace id），span在轨道上按时间嵌套显示。
+*/
+#ifndef REQUEST_TRACER_H
+#define REQUEST_TRACER_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QFile>
+#include <QMutex>
+#include <QList>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+
+class RequestTracer
+{
+public:
+    static RequestTracer& instance();
+
+    // 打开输出文件并开始采样：每sampleEvery条请求追踪一条（1为全部追踪），sampleEvery为0时不追踪
+    bool open(const QString& path, int sampleEvery);
+    // 写出剩余的span并关闭文件
+    void close();
+
+    bool enabled() const { return m_sampleEvery.loadRelaxed() > 0; }
+
+    // 为一条新请求决定是否采样：返回trace id，0表示不追踪（各线程各自计数，不需要同步）
+    quint64 sample();
+
+    // 所有线程共用的时间基准（微秒）
+    qint64 nowUs() const { return m_clock.nsecsElapsed() / 1000; }
+
+    // 记录一个span；detail会出现在span的参数里（例如action名字）
+    void record(quint64 traceId, const char* name, qint64 startUs, qint64 endUs, const QString& detail = QString());
+
+    // 把内存中的span追加到文件（主线程定时调用）
+    void flush();
+
+    // 当前线程正在处理的请求（由TraceScope设置），0表示不追踪
+    static quint64 current() { return t_current; }
+
+private:
+    friend class TraceScope;
+
+    struct Span {
+        quint64 traceId;
+        const char* name;       // 都是字符串常量
+        qint64 startUs;
+        qint64 endUs;
+        int threadIndex;
+        QString detail;
+    };
+
+    // 内存中最多积攒的span数，超过时丢弃（文件写不过来时不能无限占用内存）
+    static constexpr int MaxPendingSpans = 65536;
+
+    RequestTracer() { m_clock.start(); }
+
+    static thread_local quint64 t_current;
+
+    QElapsedTimer m_clock;
+    QAtomicInt m_sampleEvery{0};
+    QAtomicInteger<quint64> m_nextTraceId{1};
+    QAtomicInt m_nextThreadIndex{1};
+
+    QMutex m_mutex;                 // 保护下面的成员
+    QList<Span> m_pending;
+    quint64 m_dropped{0};
+    QFile m_file;
+    bool m_firstEvent{true};        // 第一个事件前面不加逗号
+};
+
+// 在当前线程上设置正在处理的请求，离开作用域时恢复
+class TraceScope
+{
+public:
+    explicit TraceScope(quint64 traceId) : m_previous(RequestTracer::t_current) { RequestTracer::t_current = traceId; }
+    ~TraceScope() { RequestTracer::t_current = m_previous; }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    quint64 m_previous;
+};
+
+// 记录一段耗时：构造时开始，析构（或end()）时结束；next()结束当前这段并接着开始下一段
+// name必须是字符串常量
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char* name) : m_traceId(RequestTracer::current()), m_name(name)
+    {
+        if (m_traceId)
+            m_startUs = RequestTracer::instance().nowUs();
+    }
+
+    ~TraceSpan() { end(); }
+
+    void next(const char* name)
+    {
+        if (!m_traceId)
+            return;
+        const qint64 now = RequestTracer::instance().nowUs();
+        if (m_name)
+            RequestTracer::instance().record(m_traceId, m_name, m_startUs, now);
+        m_name = name;
+        m_startUs = now;
+    }
+
+    void end()
+    {
+        if (m_traceId && m_name)
+            RequestTracer::instance().record(m_traceId, m_name, m_startUs, RequestTracer::instance().nowUs());
+        m_name = nullptr;
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    quint64 m_traceId;
+    const char* m_name;
+    qint64 m_startUs{0};
+};
+
+#endif // REQUEST_TRACER_H
@@ -0,0 +1,169 @@
+/*
+该文件实现内存中的余票库存
+启动时从数据库读出每个航班的剩余座位，之后订票、退票、查询余票都直接在内存里完成：
+每个航班一个原子计数器，订票是一次比较并交换（CAS）的减一，余票为0时失败，所以并发抢票也不会超卖；
+热门航班上的竞争只是同一个计数器上的几次CAS重试，不再排在数据库的写锁后面。
+数据库里的 remaining_seats 由订单日志（booking_journal.h）在后台按顺序写回，内存中的值始终领先于数据库。
+
+航班id是自增主键，比较密集，所以计数器按id直接存放在分块的数组里：查找不加锁，
+只有出现新的分块（新增航班）时才加锁分配，已经分配的分块不会移动或释放。
+分块数组能放下的id约400万；更大的id（例如导入的数据带着很大的主键）放在一个加锁的哈希表里，功能相同，只是要加锁。
+*/
+#ifndef SEAT_INVENTORY_H
+#define SEAT_INVENTORY_H
+
+#include <QtGlobal>
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QMutex>
+#include <QHash>
+#include <limits>
+
+class SeatInventory
+{
+public:
+    enum class Reserve {
+        Ok,
+        SoldOut,
+        UnknownFlight
+    };
+
+    SeatInventory() = default;
+    ~SeatInventory()
+    {
+        for (QAtomicPointer<Chunk>& chunk : m_chunks)
+            delete chunk.loadRelaxed();
+    }
+
+    SeatInventory(const SeatInventory&) = delete;
+    SeatInventory& operator=(const SeatInventory&) = delete;
+
+    // 登记（或覆盖）一个航班的余票：启动时加载、管理员新增航班时调用；id不合法时返回false
+    bool set(int flightId, int seats)
+    {
+        if (flightId <= 0)
+            return false;
+        if (!inChunks(flightId)) {
+            QMutexLocker locker(&m_overflowMutex);
+            if (!m_overflow.contains(flightId))
+                m_flights.fetchAndAddRelaxed(1);
+            m_overflow.insert(flightId, seats);
+            return true;
+        }
+        QAtomicInt* counter = counterOf(flightId, true);
+        if (counter->fetchAndStoreOrdered(seats) == Unknown)
+            m_flights.fetchAndAddRelaxed(1);
+        return true;
+    }
+
+    // 占用一个座位：余票大于0时原子地减一
+    Reserve reserve(int flightId)
+    {
+        if (flightId > 0 && !inChunks(flightId)) {
+            QMutexLocker locker(&m_overflowMutex);
+            auto it = m_overflow.find(flightId);
+            if (it == m_overflow.end())
+                return Reserve::UnknownFlight;
+            if (*it <= 0)
+                return Reserve::SoldOut;
+            --*it;
+            return Reserve::Ok;
+        }
+        QAtomicInt* counter = counterOf(flightId, false);
+        if (!counter)
+            return Reserve::UnknownFlight;
+        int current = counter->loadAcquire();
+        for (;;) {
+            if (current == Unknown)
+                return Reserve::UnknownFlight;
+            if (current <= 0)
+                return Reserve::SoldOut;
+            // 失败时current被更新为最新值，重新判断
+            if (counter->testAndSetOrdered(current, current - 1, current))
+                return Reserve::Ok;
+        }
+    }
+
+    // 归还一个座位（退票，或订票在写日志时失败）
+    void release(int flightId) { adjust(flightId, 1); }
+
+    // 按差值修改余票（管理员修改余票）：用差值而不是直接赋值，同时进行的订票不会被覆盖
+    void adjust(int flightId, int delta)
+    {
+        if (flightId > 0 && !inChunks(flightId)) {
+            QMutexLocker locker(&m_overflowMutex);
+            auto it = m_overflow.find(flightId);
+            if (it != m_overflow.end())
+                *it += delta;
+            return;
+        }
+        QAtomicInt* counter = counterOf(flightId, false);
+        if (counter && counter->loadAcquire() != Unknown)
+            counter->fetchAndAddOrdered(delta);
+    }
+
+    // 当前余票；管理员把余票调低的同时有人订票时计数器可能短暂为负，对外按0显示
+    bool remaining(int flightId, int& seats) const
+    {
+        if (flightId > 0 && !inChunks(flightId)) {
+            QMutexLocker locker(&m_overflowMutex);
+            auto it = m_overflow.constFind(flightId);
+            if (it == m_overflow.constEnd())
+                return false;
+            seats = qMax(0, *it);
+            return true;
+        }
+        QAtomicInt* counter = counterOf(flightId, false);
+        if (!counter)
+            return false;
+        const int value = counter->loadAcquire();
+        if (value == Unknown)
+            return false;
+        seats = qMax(0, value);
+        return true;
+    }
+
+    int flightCount() const { return m_flights.loadRelaxed(); }
+
+private:
+    static constexpr int ChunkBits = 12;
+    static constexpr int ChunkSize = 1 << ChunkBits;
+    static constexpr int MaxChunks = 1024;      // 分块数组中最大的id约为400万，更大的放在m_overflow
+    static constexpr int Unknown = std::numeric_limits<int>::min();
+
+    struct Chunk {
+        QAtomicInt seats[ChunkSize];
+        Chunk()
+        {
+            for (QAtomicInt& value : seats)
+                value.storeRelaxed(Unknown);
+        }
+    };
+
+    static bool inChunks(int flightId) { return (flightId >> ChunkBits) < MaxChunks; }
+
+    QAtomicInt* counterOf(int flightId, bool create) const
+    {
+        if (flightId <= 0 || !inChunks(flightId))
+            return nullptr;
+        QAtomicPointer<Chunk>& slot = m_chunks[flightId >> ChunkBits];
+        Chunk* chunk = slot.loadAcquire();
+        if (!chunk && create) {
+            QMutexLocker locker(&m_growMutex);
+            chunk = slot.loadAcquire();
+            if (!chunk) {
+                chunk = new Chunk;
+                slot.storeRelease(chunk);
+            }
+        }
+        return chunk ? &chunk->seats[flightId & (ChunkSize - 1)] : nullptr;
+    }
+
+    mutable QAtomicPointer<Chunk> m_chunks[MaxChunks];
+    mutable QMutex m_growMutex;
+    mutable QMutex m_overflowMutex;
+    QHash<int, int> m_overflow;                 // 超出分块数组的航班
+    QAtomicInt m_flights{0};
+};
+
+#endif // SEAT_INVENTORY_H
@@ -0,0 +1,300 @@
+/*
+该文件定义服务器的运行参数
+在main.cpp中调用ServerConfig::fromArguments()解析命令行，得到的配置再交给TcpServer等模块使用。
+新增参数时：在结构体里加字段（带默认值），再在fromArguments()里加对应的命令行选项。
+*/
+#ifndef SERVER_CONFIG_H
+#define SERVER_CONFIG_H
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include "async_logger.h"
+#include "transport.h"
+#include "database_manager.h"
+
+struct ServerConfig {
+    quint16 port{12345};
+
+    // 业务处理线程数，0 表示在事件循环线程中同步处理（原有行为）
+    int workerThreads{0};
+
+    // I/O线程（Reactor）数，每个Reactor拥有自己的事件循环和一部分连接
+    int reactorThreads{1};
+
+    // 单帧最大长度（字节），超过的连接会被直接断开；0 表示不限制
+    quint32 maxFrameSize{1024 * 1024};
+
+    // 发送缓冲水位线（字节）：待发送数据超过高水位时暂停读取该连接，降到低水位以下再恢复；高水位为 0 表示不限制
+    qint64 writeHighWatermark{4 * 1024 * 1024};
+    qint64 writeLowWatermark{1024 * 1024};
+
+    // 响应压缩阈值（字节）：编码后不小于该值的响应会被压缩（客户端在握手时同意才生效）；0 表示不压缩
+    int compressThreshold{1024};
+
+    // 超时（毫秒），0 表示不限制
+    int handshakeTimeoutMs{5000};   // 连接后必须在该时间内完成tag注册
+    int idleTimeoutMs{300000};      // 超过该时间没有收到任何数据的连接会被断开
+    int requestTimeoutMs{30000};    // 线程池处理一条请求的期限，超时先回复错误（仅线程池模式）
+
+    // 限流：每个客户端tag、每个登录用户每秒允许的请求数（同一IP为其4倍），0 表示该类不限流
+    int rateQueryPerSec{20};        // 查航班、查订单、订阅
+    int rateBookingPerSec{2};       // 订票、退票
+    int rateAccountPerSec{1};       // 注册、登录、修改资料
+
+    // 线程池前面的排队（仅线程池模式）：每个优先级最多排队的请求数，以及排队期限（毫秒），0 表示不限制
+    int queueCapacity{512};
+    int queueWaitMs{3000};
+
+    // 写操作组提交（仅线程池模式）：每批最多的写请求数（0为不开启），以及拿到第一条后再等多久凑批次（毫秒）
+    int groupCommitBatch{64};
+    int groupCommitWindowMs{0};
+
+    // 传输层：qt（QTcpSocket）或 epoll（仅Linux）
+    Transport::Kind transport{Transport::Kind::Qt};
+
+    // 日志级别：debug会打印每条请求和响应，只在排查问题时使用
+    LogLevel logLevel{LogLevel::Info};
+
+    // 请求追踪：指定文件后开启，每traceSampleEvery条请求采样一条写入该文件（Chrome trace-event格式）
+    QString traceFile;
+    int traceSampleEvery{1000};
+
+    // SQLite参数组合：fast（WAL + synchronous=NORMAL）、durable（WAL + FULL）或 legacy（SQLite默认）
+    DatabaseProfile dbProfile{DatabaseProfile::fast()};
+
+    static ServerConfig fromArguments(const QCoreApplication& app)
+    {
+        ServerConfig config;
+
+        QCommandLineParser parser;
+        parser.setApplicationDescription("Ticketing System server");
+        parser.addHelpOption();
+
+        QCommandLineOption portOption("port", "监听端口", "port", QString::number(config.port));
+        QCommandLineOption workersOption("workers", "业务处理线程数（0为同步处理）", "n",
+                                         QString::number(config.workerThreads));
+        QCommandLineOption reactorsOption("reactors", "I/O线程数（每个线程负责一部分连接）", "n",
+                                          QString::number(config.reactorThreads));
+        QCommandLineOption maxFrameOption("max-frame", "单帧最大字节数（0为不限制）", "bytes",
+                                          QString::number(config.maxFrameSize));
+        QCommandLineOption writeHighOption("write-high", "发送缓冲高水位（字节，0为不限制）", "bytes",
+                                           QString::number(config.writeHighWatermark));
+        QCommandLineOption writeLowOption("write-low", "发送缓冲低水位（字节）", "bytes",
+                                          QString::number(config.writeLowWatermark));
+        QCommandLineOption compressOption("compress-threshold", "响应压缩阈值（字节，0为不压缩）", "bytes",
+                                          QString::number(config.compressThreshold));
+        QCommandLineOption handshakeTimeoutOption("handshake-timeout", "tag注册期限（毫秒，0为不限制）", "ms",
+                                                  QString::number(config.handshakeTimeoutMs));
+        QCommandLineOption idleTimeoutOption("idle-timeout", "空闲连接回收时间（毫秒，0为不回收）", "ms",
+                                             QString::number(config.idleTimeoutMs));
+        QCommandLineOption requestTimeoutOption("request-timeout", "请求处理期限（毫秒，0为不限制）", "ms",
+                                                QString::number(config.requestTimeoutMs));
+        QCommandLineOption rateQueryOption("rate-query", "查询类请求每秒预算（0为不限流）", "n",
+                                           QString::number(config.rateQueryPerSec));
+        QCommandLineOption rateBookingOption("rate-booking", "订票/退票每秒预算（0为不限流）", "n",
+                                             QString::number(config.rateBookingPerSec));
+        QCommandLineOption rateAccountOption("rate-account", "注册/登录/修改资料每秒预算（0为不限流）", "n",
+                                             QString::number(config.rateAccountPerSec));
+        QCommandLineOption queueLimitOption("queue-limit", "每个优先级最多排队的请求数（0为不限制）", "n",
+                                            QString::number(config.queueCapacity));
+        QCommandLineOption queueWaitOption("queue-wait", "排队期限（毫秒，0为不限制）", "ms",
+                                           QString::number(config.queueWaitMs));
+        QCommandLineOption groupCommitOption("group-commit", "写操作组提交每批最多的请求数（0为不开启）", "n",
+                                             QString::number(config.groupCommitBatch));
+        QCommandLineOption commitWindowOption("commit-window", "组提交凑批次的等待时间（毫秒）", "ms",
+                                              QString::number(config.groupCommitWindowMs));
+        QCommandLineOption transportOption("transport", "传输层实现（qt 或 epoll，epoll仅Linux可用）", "name",
+                                           Transport::kindName(config.transport));
+        QCommandLineOption logLevelOption("log-level", "日志级别（debug、info、warning、critical 或 off）", "level",
+                                          AsyncLogger::levelName(config.logLevel));
+        QCommandLineOption traceFileOption("trace-file", "请求追踪输出文件（不指定则不追踪）", "path");
+        QCommandLineOption traceSampleOption("trace-sample", "每多少条请求追踪一条", "n",
+                                             QString::number(config.traceSampleEvery));
+        QCommandLineOption dbProfileOption("db-profile", "数据库参数组合（fast、durable 或 legacy）", "name",
+                                           config.dbProfile.name);
+        parser.addOption(portOption);
+        parser.addOption(workersOption);
+        parser.addOption(reactorsOption);
+        parser.addOption(maxFrameOption);
+        parser.addOption(writeHighOption);
+        parser.addOption(writeLowOption);
+        parser.addOption(compressOption);
+        parser.addOption(handshakeTimeoutOption);
+        parser.addOption(idleTimeoutOption);
+        parser.addOption(requestTimeoutOption);
+        parser.addOption(rateQueryOption);
+        parser.addOption(rateBookingOption);
+        parser.addOption(rateAccountOption);
+        parser.addOption(queueLimitOption);
+        parser.addOption(queueWaitOption);
+        parser.addOption(groupCommitOption);
+        parser.addOption(commitWindowOption);
+        parser.addOption(transportOption);
+        parser.addOption(logLevelOption);
+        parser.addOption(traceFileOption);
+        parser.addOption(traceSampleOption);
+        parser.addOption(dbProfileOption);
+
+        parser.process(app);
+
+        bool ok = false;
+        int port = parser.value(portOption).toInt(&ok);
+        if (ok && port > 0 && port <= 65535) {
+            config.port = static_cast<quint16>(port);
+        } else {
+            LOG_WARN() << "无效的端口参数，使用默认值:" << config.port;
+        }
+
+        int workers = parser.value(workersOption).toInt(&ok);
+        if (ok && workers >= 0) {
+            config.workerThreads = workers;
+        } else {
+            LOG_WARN() << "无效的线程数参数，使用同步处理";
+        }
+
+        int reactors = parser.value(reactorsOption).toInt(&ok);
+        if (ok && reactors >= 1) {
+            config.reactorThreads = reactors;
+        } else {
+            LOG_WARN() << "无效的I/O线程数参数，使用默认值:" << config.reactorThreads;
+        }
+
+        uint maxFrame = parser.value(maxFrameOption).toUInt(&ok);
+        if (ok) {
+            config.maxFrameSize = maxFrame;
+        } else {
+            LOG_WARN() << "无效的单帧长度参数，使用默认值:" << config.maxFrameSize;
+        }
+
+        qint64 writeHigh = parser.value(writeHighOption).toLongLong(&ok);
+        if (ok && writeHigh >= 0) {
+            config.writeHighWatermark = writeHigh;
+        } else {
+            LOG_WARN() << "无效的高水位参数，使用默认值:" << config.writeHighWatermark;
+        }
+
+        qint64 writeLow = parser.value(writeLowOption).toLongLong(&ok);
+        if (ok && writeLow >= 0) {
+            config.writeLowWatermark = writeLow;
+        } else {
+            LOG_WARN() << "无效的低水位参数，使用默认值:" << config.writeLowWatermark;
+        }
+
+        int compress = parser.value(compressOption).toInt(&ok);
+        if (ok && compress >= 0) {
+            config.compressThreshold = compress;
+        } else {
+            LOG_WARN() << "无效的压缩阈值参数，使用默认值:" << config.compressThreshold;
+        }
+
+        int handshakeTimeout = parser.value(handshakeTimeoutOption).toInt(&ok);
+        if (ok && handshakeTimeout >= 0) {
+            config.handshakeTimeoutMs = handshakeTimeout;
+        } else {
+            LOG_WARN() << "无效的tag注册期限参数，使用默认值:" << config.handshakeTimeoutMs;
+        }
+
+        int idleTimeout = parser.value(idleTimeoutOption).toInt(&ok);
+        if (ok && idleTimeout >= 0) {
+            config.idleTimeoutMs = idleTimeout;
+        } else {
+            LOG_WARN() << "无效的空闲回收参数，使用默认值:" << config.idleTimeoutMs;
+        }
+
+        int requestTimeout = parser.value(requestTimeoutOption).toInt(&ok);
+        if (ok && requestTimeout >= 0) {
+            config.requestTimeoutMs = requestTimeout;
+        } else {
+            LOG_WARN() << "无效的请求期限参数，使用默认值:" << config.requestTimeoutMs;
+        }
+
+        int rateQuery = parser.value(rateQueryOption).toInt(&ok);
+        if (ok && rateQuery >= 0) {
+            config.rateQueryPerSec = rateQuery;
+        } else {
+            LOG_WARN() << "无效的查询限流参数，使用默认值:" << config.rateQueryPerSec;
+        }
+
+        int rateBooking = parser.value(rateBookingOption).toInt(&ok);
+        if (ok && rateBooking >= 0) {
+            config.rateBookingPerSec = rateBooking;
+        } else {
+            LOG_WARN() << "无效的订票限流参数，使用默认值:" << config.rateBookingPerSec;
+        }
+
+        int rateAccount = parser.value(rateAccountOption).toInt(&ok);
+        if (ok && rateAccount >= 0) {
+            config.rateAccountPerSec = rateAccount;
+        } else {
+            LOG_WARN() << "无效的账户限流参数，使用默认值:" << config.rateAccountPerSec;
+        }
+
+        int queueLimit = parser.value(queueLimitOption).toInt(&ok);
+        if (ok && queueLimit >= 0) {
+            config.queueCapacity = queueLimit;
+        } else {
+            LOG_WARN() << "无效的排队上限参数，使用默认值:" << config.queueCapacity;
+        }
+
+        int queueWait = parser.value(queueWaitOption).toInt(&ok);
+        if (ok && queueWait >= 0) {
+            config.queueWaitMs = queueWait;
+        } else {
+            LOG_WARN() << "无效的排队期限参数，使用默认值:" << config.queueWaitMs;
+        }
+
+        int groupCommit = parser.value(groupCommitOption).toInt(&ok);
+        if (ok && groupCommit >= 0) {
+            config.groupCommitBatch = groupCommit;
+        } else {
+            LOG_WARN() << "无效的组提交参数，使用默认值:" << config.groupCommitBatch;
+        }
+
+        int commitWindow = parser.value(commitWindowOption).toInt(&ok);
+        if (ok && commitWindow >= 0) {
+            config.groupCommitWindowMs = commitWindow;
+        } else {
+            LOG_WARN() << "无效的凑批等待参数，使用默认值:" << config.groupCommitWindowMs;
+        }
+
+        Transport::Kind transport;
+        if (Transport::kindFromName(parser.value(transportOption), transport)) {
+            config.transport = transport;
+        } else {
+            LOG_WARN() << "无效的传输层参数，使用默认值:" << Transport::kindName(config.transport);
+        }
+
+        LogLevel logLevel;
+        if (AsyncLogger::levelFromName(parser.value(logLevelOption), logLevel)) {
+            config.logLevel = logLevel;
+        } else {
+            LOG_WARN() << "无效的日志级别参数，使用默认值:" << AsyncLogger::levelName(config.logLevel);
+        }
+
+        config.traceFile = parser.value(traceFileOption);
+        int traceSample = parser.value(traceSampleOption).toInt(&ok);
+        if (ok && traceSample >= 1) {
+            config.traceSampleEvery = traceSample;
+        } else {
+            LOG_WARN() << "无效的追踪采样参数，使用默认值:" << config.traceSampleEvery;
+        }
+
+        DatabaseProfile dbProfile;
+        if (DatabaseProfile::fromName(parser.value(dbProfileOption), dbProfile)) {
+            config.dbProfile = dbProfile;
+        } else {
+            LOG_WARN() << "无效的数据库参数组合，使用默认值:" << config.dbProfile.name;
+        }
+
+        // 低水位必须低于高水位，否则暂停后永远无法恢复
+        if (config.writeHighWatermark > 0 && config.writeLowWatermark >= config.writeHighWatermark) {
+            config.writeLowWatermark = config.writeHighWatermark / 2;
+            LOG_WARN() << "低水位不低于高水位，调整为:" << config.writeLowWatermark;
+        }
+
+        return config;
+    }
+};
+
+#endif // SERVER_CONFIG_H
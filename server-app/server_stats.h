@@ -0,0 +1,81 @@
+/*
+该文件定义服务器按action统计的耗时与流量
+每个action（按ActionRegistry的下标）一组计数器和四个耗时直方图，对应一条请求经过的四个阶段：
+  parse     ：Reactor解码一帧（解压、JSON/CBOR解析）
+  db        ：处理函数本身（主要是数据库访问），在工作线程或同步模式下的Reactor线程中
+  serialize ：Reactor把响应编码（压缩）进发送缓冲
+  write     ：响应从放进发送缓冲到交给传输层写出（包括等待本轮事件循环结束的时间）
+另有一组不属于任何已注册action的统计（tag注册、推送、未知action等）。
+action表在启动时就确定了，之后只会原子地累加计数，任意线程都可以无锁地记录和读取。
+管理员接口 admin_get_server_stats 返回这些数据。
+*/
+#ifndef SERVER_STATS_H
+#define SERVER_STATS_H
+
+#include <QtGlobal>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <memory>
+#include "latency_histogram.h"
+
+class ServerStats
+{
+public:
+    enum class Phase {
+        Parse,
+        Db,
+        Serialize,
+        Write
+    };
+    static constexpr int PhaseCount = 4;
+
+    static const char* phaseName(Phase phase)
+    {
+        static const char* const names[PhaseCount] = {"parse", "db", "serialize", "write"};
+        return names[static_cast<int>(phase)];
+    }
+
+    struct ActionStats {
+        QAtomicInteger<quint64> requests{0};    // 已回复的请求数
+        QAtomicInteger<quint64> errors{0};      // 其中status为error的
+        QAtomicInteger<quint64> bytesIn{0};     // 请求帧的字节数（含长度头）
+        QAtomicInteger<quint64> bytesOut{0};    // 响应帧的字节数（含长度头，压缩后）
+        LatencyHistogram phases[PhaseCount];
+
+        LatencyHistogram& phase(Phase p) { return phases[static_cast<int>(p)]; }
+        const LatencyHistogram& phase(Phase p) const { return phases[static_cast<int>(p)]; }
+    };
+
+    // 按action数量分配统计（只能在启动阶段、action全部登记之后调用一次）
+    void init(int actionCount)
+    {
+        m_actionCount = actionCount;
+        m_actions.reset(new ActionStats[actionCount + 1]);
+        m_clock.start();
+    }
+
+    int actionCount() const { return m_actionCount; }
+
+    // actionIndex为ActionRegistry的下标，-1（未注册的action）记到“其他”
+    ActionStats& of(int actionIndex)
+    {
+        return m_actions[actionIndex >= 0 && actionIndex < m_actionCount ? actionIndex : m_actionCount];
+    }
+
+    const ActionStats& at(int actionIndex) const { return m_actions[actionIndex]; }
+    const ActionStats& other() const { return m_actions[m_actionCount]; }
+
+    void record(int actionIndex, Phase phase, qint64 elapsedUs)
+    {
+        of(actionIndex).phase(phase).record(static_cast<quint64>(qMax<qint64>(0, elapsedUs)));
+    }
+
+    qint64 uptimeMs() const { return m_clock.elapsed(); }
+
+private:
+    std::unique_ptr<ActionStats[]> m_actions;
+    int m_actionCount{0};
+    QElapsedTimer m_clock;
+};
+
+#endif // SERVER_STATS_H
@@ -0,0 +1,148 @@
+#include "sql_statements.h"
+
+// 航班查询四条语句的公共部分：日期范围和cursor总是存在（不需要时绑定整个范围），LIMIT多取一行用来判断是否还有下一页
+#define SEARCH_FLIGHTS_SELECT \
+    "SELECT flight_id, flight_number, model, origin, destination," \
+    "       departure_time, arrival_time, departure_epoch," \
+    "       price, remaining_seats, total_seats" \
+    " FROM Flight" \
+    " WHERE is_deleted = 0"
+#define SEARCH_FLIGHTS_RANGE \
+    " AND departure_epoch >= :day_begin AND departure_epoch < :day_end" \
+    " AND (departure_epoch, flight_id) > (:after_epoch, :after_id)" \
+    " ORDER BY departure_epoch ASC, flight_id ASC" \
+    " LIMIT :limit"
+
+// 顺序必须与Sql中的编号一致
+static const char* const s_texts[] = {
+    // InventoryLoad：已删除的航班也加载（和原来一样，删除不影响已有订单的退票）
+    "SELECT flight_id, remaining_seats FROM Flight",
+    // BookingMaxId
+    "SELECT COALESCE(MAX(booking_id), 0) FROM Booking",
+
+    // Register
+    "INSERT INTO User (username, password) VALUES (:username, :password)",
+    // Login
+    "SELECT user_id, is_admin FROM User WHERE username = :user AND password = :pass",
+    // UpdateProfile：不修改的字段绑定NULL
+    "UPDATE User SET username = COALESCE(:username, username),"
+    "                password = COALESCE(:password, password)"
+    " WHERE user_id = :user_id",
+
+    // SearchFlights：idx_flight_departure_epoch
+    SEARCH_FLIGHTS_SELECT SEARCH_FLIGHTS_RANGE,
+    // SearchFlightsFrom：idx_flight_route_epoch的前缀（跨多个目的地，结果需要再排序）
+    SEARCH_FLIGHTS_SELECT " AND origin = :origin" SEARCH_FLIGHTS_RANGE,
+    // SearchFlightsTo：idx_flight_departure_epoch，再按目的地过滤
+    SEARCH_FLIGHTS_SELECT " AND destination = :destination" SEARCH_FLIGHTS_RANGE,
+    // SearchFlightsRoute：idx_flight_route_epoch
+    SEARCH_FLIGHTS_SELECT " AND origin = :origin AND destination = :destination" SEARCH_FLIGHTS_RANGE,
+
+    // CancelSelectBooking
+    "SELECT flight_id, status FROM Booking WHERE booking_id = :booking_id",
+    // JournalInsertBooking：订单号由内存分配；重放时已经写回过的订单被忽略（影响行数为0）
+    "INSERT OR IGNORE INTO Booking (booking_id, user_id, flight_id, booking_time, status)"
+    " VALUES (:booking_id, :user_id, :flight_id, :booking_time, 'confirmed')",
+    // JournalTakeSeat（是否超卖已经由内存库存判断过，这里只同步计数）
+    "UPDATE Flight SET remaining_seats = remaining_seats - 1 WHERE flight_id = :flight_id",
+    // JournalCancelBooking：只取消confirmed的订单，重放时影响行数为0
+    "UPDATE Booking SET status = 'cancelled' WHERE booking_id = :booking_id AND status = 'confirmed'",
+    // JournalReturnSeat
+    "UPDATE Flight SET remaining_seats = remaining_seats + 1 WHERE flight_id = :flight_id",
+    // JournalSavepoint、JournalRelease、JournalRollbackTo：每条记录的订单行和余票在一个保存点里写回
+    "SAVEPOINT journal_entry",
+    "RELEASE journal_entry",
+    "ROLLBACK TO journal_entry",
+
+    // UserIsAdmin
+    "SELECT is_admin FROM User WHERE user_id = :user_id",
+    // OrdersOfUser：按 (booking_time, booking_id) 倒序，第一页的cursor比所有订单都大
+    "SELECT b.booking_id, b.flight_id, b.status, b.booking_time,"
+    "       f.flight_number, f.origin, f.destination,"
+    "       f.departure_time, f.arrival_time, f.price, f.is_deleted"
+    " FROM Booking b"
+    " JOIN Flight f ON b.flight_id = f.flight_id"
+    " WHERE b.user_id = :user_id"
+    "   AND (b.booking_time, b.booking_id) < (:after_time, :after_id)"
+    " ORDER BY b.booking_time DESC, b.booking_id DESC"
+    " LIMIT :limit",
+    // PendingBookingDetails：订单日志中还没写回的订单，补上查询订单接口需要的用户和航班信息
+    "SELECT u.username,"
+    "       f.flight_number, f.model, f.origin, f.destination,"
+    "       f.departure_time, f.arrival_time, f.price, f.is_deleted"
+    " FROM Flight f"
+    " JOIN User u ON u.user_id = :user_id"
+    " WHERE f.flight_id = :flight_id",
+    // SubscribeSeats：:ids为航班id的JSON数组
+    "SELECT flight_id, remaining_seats FROM Flight"
+    " WHERE is_deleted = 0 AND flight_id IN (SELECT value FROM json_each(:ids))",
+
+    // AdminAddFlight
+    "INSERT INTO Flight ("
+    "    flight_number, model, origin, destination,"
+    "    departure_time, arrival_time,"
+    "    total_seats, remaining_seats, price"
+    ") VALUES ("
+    "    :flight_number, :model, :origin, :destination,"
+    "    :departure_time, :arrival_time,"
+    "    :total_seats, :remaining_seats, :price"
+    ")",
+    // AdminSelectFlightSeats
+    "SELECT total_seats, remaining_seats FROM Flight WHERE flight_id = :flight_id",
+    // AdminUpdateFlight：余票按差值修改，和订单日志里还没写回的加减互不覆盖
+    "UPDATE Flight SET"
+    "    flight_number   = :flight_number,"
+    "    origin          = :origin,"
+    "    destination     = :destination,"
+    "    departure_time  = :departure_time,"
+    "    arrival_time    = :arrival_time,"
+    "    price           = :price,"
+    "    total_seats     = :total_seats,"
+    "    remaining_seats = remaining_seats + :seat_delta"
+    " WHERE flight_id = :flight_id",
+    // AdminSelectFlightDeleted
+    "SELECT flight_id, is_deleted FROM Flight WHERE flight_id = :flight_id",
+    // AdminDeleteFlight（软删除）
+    "UPDATE Flight SET is_deleted = 1 WHERE flight_id = :flight_id",
+    // AdminAllUsers：按user_id，第一页的cursor为0
+    "SELECT user_id, username, is_admin, created_at"
+    " FROM User"
+    " WHERE user_id > :after_id"
+    " ORDER BY user_id ASC"
+    " LIMIT :limit",
+    // AdminAllBookings：按 (booking_time, booking_id) 倒序
+    "SELECT b.booking_id, b.user_id, b.flight_id, b.status, b.booking_time,"
+    "       u.username,"
+    "       f.flight_number, f.model, f.origin, f.destination,"
+    "       f.departure_time, f.arrival_time, f.price, f.is_deleted"
+    " FROM Booking b"
+    " JOIN User   u ON b.user_id  = u.user_id"
+    " JOIN Flight f ON b.flight_id = f.flight_id"
+    " WHERE (b.booking_time, b.booking_id) < (:after_time, :after_id)"
+    " ORDER BY b.booking_time DESC, b.booking_id DESC"
+    " LIMIT :limit",
+    // AdminAllFlights：按 (departure_time, flight_id)，第一页的cursor为 ('', 0)
+    "SELECT flight_id, flight_number, model, origin, destination,"
+    "       departure_time, arrival_time,"
+    "       total_seats, remaining_seats, price, is_deleted"
+    " FROM Flight"
+    " WHERE (departure_time, flight_id) > (:after_time, :after_id)"
+    " ORDER BY departure_time ASC, flight_id ASC"
+    " LIMIT :limit",
+
+    // SavepointRequest、ReleaseRequest、RollbackToRequest
+    "SAVEPOINT request",
+    "RELEASE request",
+    "ROLLBACK TO request",
+};
+
+#undef SEARCH_FLIGHTS_SELECT
+#undef SEARCH_FLIGHTS_RANGE
+
+static_assert(sizeof(s_texts) / sizeof(s_texts[0]) == SqlCount, "s_texts必须与Sql一一对应");
+
+const char* sqlText(Sql id)
+{
+    const int index = static_cast<int>(id);
+    return index >= 0 && index < SqlCount ? s_texts[index] : nullptr;
+}
@@ -0,0 +1,74 @@
+/*
+该文件登记服务器用到的所有SQL语句
+处理函数不再自己拼SQL字符串，而是用这里的编号向DatabaseManager要一条预编译好的语句：
+  CachedQuery query(Sql::Login);
+  query->bindValue(":user", username);
+  query->exec();
+每个线程（每个数据库连接）第一次用到某条语句时prepare一次，之后直接重新绑定参数执行，SQLite不需要重复解析和生成执行计划。
+可选条件不再拼进SQL，而是归并成固定的几条语句：
+  - 翻页cursor：第一页也带cursor条件，参数用比所有数据都小（或都大）的值；
+  - 日期范围：不指定日期时用整个整数范围；
+  - 不定长的id列表：用 json_each(:ids) 展开一个JSON数组参数；
+  - 可选的更新字段：用 COALESCE(:x, x)，不更新的字段绑定NULL。
+只有会改变索引选择的条件（航班查询是否给出起降地）才分成不同的语句。
+新增语句时：在Sql里加编号，再在sql_statements.cpp的表中按同样的顺序加SQL。
+*/
+#ifndef SQL_STATEMENTS_H
+#define SQL_STATEMENTS_H
+
+enum class Sql : int {
+    // 内存库存与订单日志的启动加载
+    InventoryLoad,
+    BookingMaxId,
+
+    // 通用
+    Register,
+    Login,
+    UpdateProfile,
+
+    // 航班查询：按是否给出起降地分成四条，各自走最合适的索引
+    SearchFlights,
+    SearchFlightsFrom,
+    SearchFlightsTo,
+    SearchFlightsRoute,
+
+    // 订票、退票：请求里只查订单，修改由订单日志在后台写回（见booking_journal.h）
+    CancelSelectBooking,
+    JournalInsertBooking,
+    JournalTakeSeat,
+    JournalCancelBooking,
+    JournalReturnSeat,
+    JournalSavepoint,
+    JournalRelease,
+    JournalRollbackTo,
+
+    // 订单、订阅
+    UserIsAdmin,
+    OrdersOfUser,
+    PendingBookingDetails,
+    SubscribeSeats,
+
+    // 管理员
+    AdminAddFlight,
+    AdminSelectFlightSeats,
+    AdminUpdateFlight,
+    AdminSelectFlightDeleted,
+    AdminDeleteFlight,
+    AdminAllUsers,
+    AdminAllBookings,
+    AdminAllFlights,
+
+    // 组提交：每条请求一个保存点（见group_commit.h）
+    SavepointRequest,
+    ReleaseRequest,
+    RollbackToRequest,
+
+    Count
+};
+
+constexpr int SqlCount = static_cast<int>(Sql::Count);
+
+// 语句的SQL文本（编号不合法时返回nullptr）
+const char* sqlText(Sql id);
+
+#endif // SQL_STATEMENTS_H
@@ -1,220 +1,545 @@
 #include "tcp_server.h"
+#include "async_logger.h"
 #include <QSqlQuery>
+#include <QStringList>
+#include <QDate>
+#include <QTime>
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+/// 以下为列表接口的分页辅助函数
+// 列表接口使用keyset分页：请求带page_size和上一页返回的cursor，响应带next_cursor（没有更多数据时为null）。
+// cursor是上一页最后一行排序键的编码（对客户端不透明），下一页用 (排序键) > (cursor) 直接在索引上定位，不使用OFFSET。
+
+// 读取每页行数，缺省或超出范围时使用MAX_RETURN_ROWS
+static int pageSizeOf(const QJsonObject& data)
+{
+    const int pageSize = data.value("page_size").toInt(MAX_RETURN_ROWS);
+    return (pageSize <= 0 || pageSize > MAX_RETURN_ROWS) ? MAX_RETURN_ROWS : pageSize;
+}
+
+// 把排序键编码为cursor
+static QString encodeCursor(const QJsonArray& key)
+{
+    return QString::fromLatin1(QJsonDocument(key).toJson(QJsonDocument::Compact)
+                                   .toBase64(QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals));
+}
+
+// 解析请求中的cursor：没有cursor时key为空并返回true；格式不对（或键的个数不符）时返回false
+static bool decodeCursor(const QJsonObject& data, int keySize, QJsonArray& key)
+{
+    key = QJsonArray();
+    const QString cursor = data.value("cursor").toString();
+    if (cursor.isEmpty())
+        return true;
+
+    auto decoded = QByteArray::fromBase64Encoding(cursor.toLatin1(),
+                                                  QByteArray::Base64UrlEncoding | QByteArray::AbortOnBase64DecodingErrors);
+    if (!decoded)
+        return false;
+
+    QJsonDocument doc = QJsonDocument::fromJson(*decoded);
+    if (!doc.isArray() || doc.array().size() != keySize)
+        return false;
+
+    key = doc.array();
+    return true;
+}
+
+static QJsonObject invalidCursorResponse()
+{
+    return {
+        {"status", "error"},
+        {"message", "cursor 无效"},
+        {"data", QJsonValue()}
+    };
+}
+
+// 一页数据的成功响应
+static QJsonObject pageResponse(const QString& message, const QJsonArray& rows, const QString& nextCursor)
+{
+    return {
+        {"status", "success"},
+        {"message", message},
+        {"data", rows},
+        {"next_cursor", nextCursor.isEmpty() ? QJsonValue() : QJsonValue(nextCursor)}
+    };
+}
+
+// 把订单日志中还没写回数据库的订单合并进一页订单（排序键 (booking_time, booking_id) 倒序）：
+// rows是数据库中cursor之后的最多pageSize+1行，pending要在查询数据库之前取出（见BookingJournal::pendingBookings）。
+// 已经在rows里的订单只用内存中的状态修正status；还没写回的订单按同样的cursor条件筛选、排序，
+// 只有排在最前面的pageSize+1张可能进入这一页，只为它们查询航班和用户信息，补进来之后再排序截取一页。
+// userId大于0时只补该用户的订单，withUser为true时补上user_id、username和model（管理员接口的列）。返回下一页的cursor
+static QString mergePendingBookings(QList<QJsonObject>& rows, const QList<BookingJournal::PendingBooking>& pending,
+                                    int userId, bool withUser, const QJsonArray& after, int pageSize)
+{
+    QHash<int, const BookingJournal::PendingBooking*> byId;
+    for (const BookingJournal::PendingBooking& booking : pending)
+        byId.insert(booking.bookingId, &booking);
+
+    for (QJsonObject& row : rows) {
+        const BookingJournal::PendingBooking* booking = byId.take(row.value("booking_id").toInt());
+        if (booking && booking->cancelled)
+            row["status"] = "cancelled";
+    }
+
+    QList<const BookingJournal::PendingBooking*> candidates;
+    for (const BookingJournal::PendingBooking* booking : std::as_const(byId)) {
+        // 只有退票没写回的订单已经在数据库里，不在rows中说明它不属于这一页
+        if (booking->bookingTime.isEmpty() || (userId > 0 && booking->userId != userId))
+            continue;
+        if (!after.isEmpty() && std::make_pair(booking->bookingTime, booking->bookingId)
+                                    >= std::make_pair(after.at(0).toString(), after.at(1).toInt()))
+            continue;
+        candidates.append(booking);
+    }
+    const qsizetype keep = qMin<qsizetype>(candidates.size(), pageSize + 1);
+    std::partial_sort(candidates.begin(), candidates.begin() + keep, candidates.end(),
+                      [](const BookingJournal::PendingBooking* a, const BookingJournal::PendingBooking* b) {
+        return std::make_pair(a->bookingTime, a->bookingId) > std::make_pair(b->bookingTime, b->bookingId);
+    });
+    candidates.resize(keep);
+
+    bool added = false;
+    for (const BookingJournal::PendingBooking* booking : std::as_const(candidates)) {
+        CachedQuery details(Sql::PendingBookingDetails);
+        details->bindValue(":user_id", booking->userId);
+        details->bindValue(":flight_id", booking->flightId);
+        if (!details->exec() || !details->next())
+            continue;
+
+        QJsonObject row;
+        row["booking_id"]     = booking->bookingId;
+        row["flight_id"]      = booking->flightId;
+        row["status"]         = booking->cancelled ? "cancelled" : "confirmed";
+        row["booking_time"]   = booking->bookingTime;
+        row["flight_number"]  = details->value("flight_number").toString();
+        row["origin"]         = details->value("origin").toString();
+        row["destination"]    = details->value("destination").toString();
+        row["departure_time"] = details->value("departure_time").toString();
+        row["arrival_time"]   = details->value("arrival_time").toString();
+        row["price"]          = details->value("price").toDouble();
+        row["is_deleted"]     = details->value("is_deleted").toInt();
+        if (withUser) {
+            row["user_id"]    = booking->userId;
+            row["username"]   = details->value("username").toString();
+            row["model"]      = details->value("model").toString();
+        }
+        rows.append(row);
+        added = true;
+    }
+
+    if (added) {
+        std::sort(rows.begin(), rows.end(), [](const QJsonObject& a, const QJsonObject& b) {
+            return std::make_pair(a.value("booking_time").toString(), a.value("booking_id").toInt())
+                 > std::make_pair(b.value("booking_time").toString(), b.value("booking_id").toInt());
+        });
+    }
+
+    if (rows.size() <= pageSize)
+        return {};
+    rows.resize(pageSize);
+    const QJsonObject& last = rows.last();
+    return encodeCursor({last["booking_time"], last["booking_id"]});
+}
+
+/// 以下为航班时间的校验
+// 起降时间统一存成 'YYYY-MM-DD HH:MM:SS'：departure_epoch由触发器用strftime换算，换算不了的时间得到NULL，
+// 这样的航班在任何航班查询里都查不到。接受日期和时间之间是空格或T、省略秒的写法，不做时区转换；格式不对时返回false
+static bool normalizeFlightTime(const QString& text, QString& normalized)
+{
+    const QString value = text.trimmed();
+    if (value.size() < 16 || (value.at(10) != u' ' && value.at(10) != u'T'))
+        return false;
+
+    const QDate date = QDate::fromString(value.left(10), "yyyy-MM-dd");
+    const QString clock = value.mid(11);
+    QTime time = QTime::fromString(clock, "HH:mm:ss");
+    if (!time.isValid())
+        time = QTime::fromString(clock, "HH:mm");
+    if (!date.isValid() || !time.isValid())
+        return false;
+
+    normalized = date.toString("yyyy-MM-dd") + u' ' + time.toString("HH:mm:ss");
+    return true;
+}
 
 /// 以下为服务器正常启动与处理连接的功能实现
 
 TcpServer::TcpServer(QObject *parent) : QObject(parent)
 {
-    m_server = new QTcpServer(this);
-    // 当有新客户端连接时，触发 onNewConnection
-    connect(m_server, &QTcpServer::newConnection, this, &TcpServer::onNewConnection);
+    m_server = new ConnectionListener(this);
+    // 当有新客户端连接时，触发 onConnectionAccepted
+    connect(m_server, &ConnectionListener::connectionAccepted, this, &TcpServer::onConnectionAccepted);
+
+    m_seatTimer = new QTimer(this);
+    m_seatTimer->setInterval(SEAT_PUSH_INTERVAL_MS);
+    connect(m_seatTimer, &QTimer::timeout, this, &TcpServer::flushSeatChanges);
+
+    m_traceTimer = new QTimer(this);
+    m_traceTimer->setInterval(TRACE_FLUSH_INTERVAL_MS);
+    connect(m_traceTimer, &QTimer::timeout, this, []() { RequestTracer::instance().flush(); });
+
+    registerActions();
+    m_stats.init(m_actions.size());
 }
 
-void TcpServer::startServer(quint16 port)
+TcpServer::~TcpServer()
 {
-    if (m_server->listen(QHostAddress::Any, port)) {
-        qInfo() << "服务器已启动，监听端口:" << port;
-    } else {
-        qCritical() << "服务器启动失败:" << m_server->errorString();
+    m_server->close();
+
+    // 写线程先处理完已经排队的写请求（响应投递给Reactor，Reactor此时还在）
+    if (m_groupCommit) {
+        m_groupCommit->stop();
+        delete m_groupCommit;
+        m_groupCommit = nullptr;
+    }
+
+    // 等待线程池中的请求处理完，避免工作线程访问已销毁的对象
+    if (m_workerPool)
+        m_workerPool->waitForDone();
+
+    // 多Reactor模式：Reactor随线程结束一起销毁（见startServer中的deleteLater）
+    for (QThread *thread : std::as_const(m_reactorThreads)) {
+        thread->quit();
+        thread->wait();
     }
+    // 单Reactor模式：Reactor在主线程，直接销毁
+    if (m_reactorThreads.isEmpty())
+        qDeleteAll(m_reactors);
+
+    // 不会再有新的订票、退票了，把订单日志全部写回数据库
+    m_journal.close();
+
+    // 所有请求都结束了，写出剩下的span
+    if (m_traceTimer->isActive())
+        RequestTracer::instance().close();
 }
 
-// 处理新的客户端连接
-void TcpServer::onNewConnection()
+void TcpServer::setWorkerThreads(int count)
 {
-    QTcpSocket *clientSocket = m_server->nextPendingConnection(); // 获取客户端 Socket
-    qInfo() << "新客户端连接:" << clientSocket->peerAddress().toString();
-
-    // 利用Qt的信息与槽机制，在客户端连接后持续监听用户是否发了数据/断开连接
-    connect(clientSocket, &QTcpSocket::readyRead, this, &TcpServer::onReadyRead);
-    connect(clientSocket, &QTcpSocket::disconnected, this, &TcpServer::onDisconnected);
-    
-    // 设置5秒超时，如果客户端没有发送tag，则断开连接
-    QTimer::singleShot(5000, clientSocket, [clientSocket]() {
-        if (clientSocket->state() == QTcpSocket::ConnectedState && !clientSocket->property("tag_registered").toBool()) {
-            qWarning() << "客户端未在5秒内发送tag，断开连接:" << clientSocket->peerAddress().toString();
-            clientSocket->disconnectFromHost();
-        }
-    });
+    if (count <= 0) {
+        LOG_INFO() << "业务请求在事件循环线程中同步处理";
+        return;
+    }
+
+    if (!m_workerPool)
+        m_workerPool = new QThreadPool(this);
+    m_workerPool->setMaxThreadCount(count);
+    // 工作线程不回收：每个线程都绑定了自己的数据库连接
+    m_workerPool->setExpiryTimeout(-1);
+    m_dispatchQueue.setPool(m_workerPool);
+    LOG_INFO() << "业务线程池已开启，线程数:" << count;
 }
 
-// 处理客户端发送的数据
-void TcpServer::onReadyRead()
+void TcpServer::setReactorCount(int count)
 {
-    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
-    if (!socket) return;
-
-    ClientInfo &info = clients[socket];
-
-    // 追加收到的数据到缓冲
-    info.recvBuf.append(socket->readAll());
-
-    // 循环解析，可能一次解析多条消息
-    while (true) {
-        // 还没读到长度前缀
-        if (info.expectedLen == 0) {
-            if (info.recvBuf.size() < static_cast<int>(sizeof(quint32)))
-                break;
-            quint32 len = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(info.recvBuf.constData()));
-            info.expectedLen = len;
-            info.recvBuf.remove(0, sizeof(quint32));
-        }
+    m_reactorCount = qMax(1, count);
+}
 
-        // 数据不够一帧
-        if (info.recvBuf.size() < info.expectedLen)
-            break;
+void TcpServer::setConnectionLimits(quint32 maxFrameSize, qint64 writeHighWatermark, qint64 writeLowWatermark)
+{
+    m_maxFrameSize = maxFrameSize;
+    m_writeHighWatermark = writeHighWatermark;
+    m_writeLowWatermark = writeLowWatermark;
+    LOG_INFO() << "单帧上限:" << maxFrameSize << "发送缓冲水位:" << writeLowWatermark << "/" << writeHighWatermark;
+}
 
-        // 取出完整帧
-        QByteArray frame = info.recvBuf.left(info.expectedLen);
-        info.recvBuf.remove(0, info.expectedLen);
-        info.expectedLen = 0;
+void TcpServer::setTimeouts(int handshakeMs, int idleMs, int requestMs)
+{
+    m_handshakeTimeoutMs = qMax(0, handshakeMs);
+    m_idleTimeoutMs = qMax(0, idleMs);
+    m_requestTimeoutMs = qMax(0, requestMs);
+    LOG_INFO() << "超时设置(ms) tag注册:" << m_handshakeTimeoutMs << "空闲:" << m_idleTimeoutMs << "请求:" << m_requestTimeoutMs;
+}
 
-        qDebug() << "收到原始数据:" << frame;
+void TcpServer::setRateLimits(int queryPerSec, int bookingPerSec, int accountPerSec)
+{
+    using Rate = ActionSpec::RateClass;
+    // 桶容量（允许的突发）取每秒预算的2倍，至少能连续发几个请求
+    auto budgetOf = [](int perSec) {
+        return RateLimiter::Budget{static_cast<double>(qMax(0, perSec)), qMax(2.0, perSec * 2.0)};
+    };
+    m_rateLimiter.setBudget(Rate::Query,   budgetOf(queryPerSec));
+    m_rateLimiter.setBudget(Rate::Booking, budgetOf(bookingPerSec));
+    m_rateLimiter.setBudget(Rate::Account, budgetOf(accountPerSec));
+    LOG_INFO() << "限流(每秒) 查询:" << queryPerSec << "订票:" << bookingPerSec << "账户:" << accountPerSec;
+}
 
-        // JSON解析
-        QJsonDocument jsonDoc = QJsonDocument::fromJson(frame);
-        if (jsonDoc.isNull() || !jsonDoc.isObject()) {
-            qWarning() << "收到无效的JSON格式";
-            QJsonObject error{{"status", "error"}, {"message", "Invalid JSON format"}};
-            sendJsonResponse(socket, error);
-            continue; // 继续处理后续帧
-        }
+void TcpServer::setQueueLimits(int capacity, int maxWaitMs)
+{
+    m_dispatchQueue.setLimits(capacity, maxWaitMs);
+    LOG_INFO() << "排队上限(每个优先级):" << m_dispatchQueue.capacity() << "排队期限(ms):" << m_dispatchQueue.maxWaitMs();
+}
 
-        QJsonObject request = jsonDoc.object();
-        qDebug() << "解析JSON请求:" << request;
-
-        // 首次解析tag
-        if (clients[socket].tag.isEmpty())
-        {
-            if (!request.contains("tag") || !request["tag"].isString()) {
-                QJsonObject error{{"status", "error"}, {"message", "Missing or invalid tag"}};
-                sendJsonResponse(socket, error);
-                socket->disconnectFromHost();
-                continue;
-            }
+void TcpServer::setTransport(Transport::Kind kind)
+{
+    if (!Transport::isSupported(kind)) {
+        LOG_WARN() << "当前平台不支持传输层" << Transport::kindName(kind) << "，改用qt";
+        kind = Transport::Kind::Qt;
+    }
+    m_transportKind = kind;
+    LOG_INFO() << "传输层:" << Transport::kindName(m_transportKind);
+}
+
+void TcpServer::setTracing(const QString& path, int sampleEvery)
+{
+    if (path.isEmpty() || sampleEvery <= 0)
+        return;
+    if (RequestTracer::instance().open(path, sampleEvery))
+        m_traceTimer->start();
+}
 
-            QString tag = request["tag"].toString();
+void TcpServer::setGroupCommit(int maxBatch, int windowMs)
+{
+    m_groupCommitBatch = qMax(0, maxBatch);
+    m_groupCommitWindowMs = qMax(0, windowMs);
+}
 
-            // 检查 tag 是否重复
-            for (auto it = clients.begin(); it != clients.end(); ++it) {
-                if (it.value().tag == tag && it.key() != socket) {
-                    QJsonObject error{{"status", "error"}, {"message", "Tag already in use"}};
-                    sendJsonResponse(socket, error);
-                    socket->disconnectFromHost();
-                    goto next_frame;
-                }
-            }
+bool TcpServer::isWriteAction(const QString& action) const
+{
+    const int index = m_actions.indexOf(action);
+    return index >= 0 && m_actions.at(index).access == ActionSpec::Access::Write;
+}
 
-            // 绑定 tag
-            clients[socket].tag = tag;
-            socket->setProperty("tag_registered", true);
-            qInfo() << "客户端注册tag成功:" << tag;
+DispatchQueue::Priority TcpServer::priorityOf(const QString& action) const
+{
+    const int index = m_actions.indexOf(action);
+    if (index < 0)
+        return DispatchQueue::Priority::Normal;
+
+    // 会修改数据的请求（订票、退票等）优先；管理员的其他接口都是报表或运维操作，排在最后
+    const ActionSpec& spec = m_actions.at(index);
+    if (spec.access == ActionSpec::Access::Write || spec.access == ActionSpec::Access::Journal)
+        return DispatchQueue::Priority::High;
+    if (spec.requiresAdmin)
+        return DispatchQueue::Priority::Low;
+    return DispatchQueue::Priority::Normal;
+}
 
-            // 回复注册成功
-            QJsonObject success{{"status", "success"}, {"message", "Tag registered"}};
-            sendJsonResponse(socket, success);
-            goto next_frame;
+void TcpServer::startServer(quint16 port)
+{
+    // 先重放上次没有写回的订单日志，数据库里的余票才是准的，再加载到内存库存
+    DatabaseManager& database = DatabaseManager::instance();
+    // 被数据库拒绝的订票、退票：撤销它们在内存库存上的修改
+    m_journal.setOnRejected([this](int flightId, int seatDelta) {
+        m_inventory.adjust(flightId, seatDelta);
+        markSeatsChanged(flightId);
+    });
+    if (!m_journal.open(database.databasePath() + ".bookings", database.profile().synchronous == "FULL"))
+        LOG_CRITICAL() << "订单日志不可用，订票、退票都会失败";
+    {
+        DatabaseLease lease(DatabaseManager::Role::Write);
+        CachedQuery query(Sql::InventoryLoad);
+        if (query->exec()) {
+            while (query->next()) {
+                const int flightId = query->value(0).toInt();
+                if (!m_inventory.set(flightId, query->value(1).toInt()))
+                    LOG_WARN() << "航班id不合法，无法加载到内存库存:" << query->value(0).toString();
+            }
+            LOG_INFO() << "余票已加载到内存，航班数:" << m_inventory.flightCount();
+        } else {
+            LOG_CRITICAL() << "加载余票失败:" << query->lastError().text();
         }
+    }
 
-        // 解析正常业务
-        {
-            QJsonObject response = handleRequest(request);
-            sendJsonResponse(socket, response);
+    // 创建Reactor：只有一个时直接使用主线程的事件循环，多个时每个Reactor独占一个线程
+    for (int i = 0; i < m_reactorCount; ++i) {
+        ClientReactor *reactor = new ClientReactor(this, i);
+        if (m_reactorCount > 1) {
+            QThread *thread = new QThread(this);
+            thread->setObjectName(QString("reactor-%1").arg(i));
+            reactor->moveToThread(thread);
+            connect(thread, &QThread::finished, reactor, &QObject::deleteLater);
+            thread->start();
+            m_reactorThreads.append(thread);
         }
-    next_frame:
-        continue;
+        m_reactors.append(reactor);
+    }
+
+    // 组提交只在线程池模式下开启：同步模式本来就在一个线程里按顺序执行，每条请求单独提交
+    if (m_workerPool && m_groupCommitBatch > 0 && !m_groupCommit) {
+        m_groupCommit = new GroupCommitWriter(m_groupCommitBatch, m_groupCommitWindowMs);
+        // 在写线程中调用：批次提交成功后才修改内存库存、推送这批请求改过的余票
+        m_groupCommit->setAfterCommit([this](bool committed) {
+            if (committed) {
+                for (const std::function<void()>& action : std::as_const(m_batchAfterCommit))
+                    action();
+                QMutexLocker locker(&m_seatMutex);
+                m_dirtyFlights.unite(m_batchDirtyFlights);
+            }
+            m_batchAfterCommit.clear();
+            m_batchDirtyFlights.clear();
+        });
+        m_groupCommit->start();
+    }
+
+    m_seatTimer->start();
+
+    if (m_server->listen(QHostAddress::Any, port)) {
+        LOG_INFO() << "服务器已启动，监听端口:" << port << "Reactor数:" << m_reactorCount;
+    } else {
+        LOG_CRITICAL() << "服务器启动失败:" << m_server->errorString();
     }
 }
 
-// 当客户端断开连接时
-void TcpServer::onDisconnected()
+// 处理新的客户端连接：按轮询交给某个Reactor
+void TcpServer::onConnectionAccepted(qintptr socketDescriptor)
 {
-    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
-    if (!socket) return;
+    if (m_reactors.isEmpty())
+        return;
+
+    ClientReactor *reactor = m_reactors.at(m_nextReactor);
+    m_nextReactor = (m_nextReactor + 1) % m_reactors.size();
 
-    if (clients.contains(socket)) {
-        qInfo() << "客户端断开连接: " << clients[socket].tag;
-        clients.remove(socket);
+    // QTcpSocket必须在Reactor所在线程中创建，所以通过事件投递过去
+    QMetaObject::invokeMethod(reactor, [reactor, socketDescriptor]() {
+        reactor->addConnection(socketDescriptor);
+    }, Qt::AutoConnection);
+}
+
+void TcpServer::markSeatsChanged(int flightId)
+{
+    if (DatabaseManager::inGroupCommit()) {
+        m_batchDirtyFlights.insert(flightId);
+        return;
     }
+    QMutexLocker locker(&m_seatMutex);
+    m_dirtyFlights.insert(flightId);
+}
+
+int TcpServer::remainingSeatsOf(int flightId, int stored) const
+{
+    int remaining = stored;
+    m_inventory.remaining(flightId, remaining);
+    return remaining;
+}
 
-    socket->deleteLater();
+void TcpServer::runAfterCommit(std::function<void()> action)
+{
+    if (DatabaseManager::inGroupCommit())
+        m_batchAfterCommit.append(std::move(action));
+    else
+        action();
 }
 
-// 用来发送JSON响应的辅助函数，此处返回的是QByteArray
-void TcpServer::sendJsonResponse(QTcpSocket* socket, const QJsonObject& response)
+// 在主线程中定时执行：从内存库存取出所有变化航班的最新余票，交给每个Reactor推送给订阅者
+void TcpServer::flushSeatChanges()
 {
-    QJsonDocument doc(response);
-    QByteArray payload = doc.toJson(QJsonDocument::Compact);
+    QSet<int> dirty;
+    {
+        QMutexLocker locker(&m_seatMutex);
+        if (m_dirtyFlights.isEmpty())
+            return;
+        dirty.swap(m_dirtyFlights);
+    }
 
-    quint32 len = payload.size();
-    QByteArray block;
-    block.resize(sizeof(quint32));
-    qToBigEndian(len, reinterpret_cast<uchar*>(block.data()));
-    block.append(payload);
+    QHash<int, int> seats;
+    for (int flightId : std::as_const(dirty)) {
+        int remaining = 0;
+        if (m_inventory.remaining(flightId, remaining))
+            seats.insert(flightId, remaining);
+    }
+    if (seats.isEmpty())
+        return;
 
-    socket->write(block);
-    qDebug() << "发送JSON响应:" << response;
+    for (ClientReactor *reactor : std::as_const(m_reactors)) {
+        QMetaObject::invokeMethod(reactor, [reactor, seats]() {
+            reactor->pushSeatUpdates(seats);
+        }, Qt::AutoConnection);
+    }
 }
 
 /// 以下为服务器具体业务需求功能实现
 
-// 请求分发路由器
-QJsonObject TcpServer::handleRequest(const QJsonObject& request)
+// 登记所有action：名字、处理函数、读/写、是否需要管理员权限、限流类别
+void TcpServer::registerActions()
+{
+    using Access = ActionSpec::Access;
+    using Rate = ActionSpec::RateClass;
+
+    // 通用
+    m_actions.add({"register",               &TcpServer::handleRegister,            Access::Write, false, Rate::Account});
+    m_actions.add({"login",                  &TcpServer::handleLogin,               Access::Read,  false, Rate::Account});
+    m_actions.add({"update_profile",         &TcpServer::handleUpdateProfile,       Access::Write, false, Rate::Account});
+    // 客户端
+    m_actions.add({"search_flights",         &TcpServer::handleSearchFlights,       Access::Read,  false, Rate::Query});
+    m_actions.add({"book_flight",            &TcpServer::handleBookFlight,          Access::Journal, false, Rate::Booking});
+    m_actions.add({"get_my_orders",          &TcpServer::handleGetMyOrders,         Access::Read,  false, Rate::Query});
+    m_actions.add({"cancel_order",           &TcpServer::handleCancelOrder,         Access::Journal, false, Rate::Booking});
+    m_actions.add({"subscribe_flights",      &TcpServer::handleSubscribeFlights,    Access::Read,  false, Rate::Query});
+    // 管理员端
+    m_actions.add({"admin_add_flight",       &TcpServer::handleAdminAddFlight,      Access::Write, true,  Rate::Unlimited});
+    m_actions.add({"admin_delete_flight",    &TcpServer::handleAdminDeleteFlight,   Access::Write, true,  Rate::Unlimited});
+    m_actions.add({"admin_update_flight",    &TcpServer::handleAdminUpdateFlight,   Access::Write, true,  Rate::Unlimited});
+    m_actions.add({"admin_get_all_users",    &TcpServer::handleAdminGetAllUsers,    Access::Read,  true,  Rate::Unlimited});
+    m_actions.add({"admin_get_all_bookings", &TcpServer::handleAdminGetAllBookings, Access::Read,  true,  Rate::Unlimited});
+    m_actions.add({"admin_get_all_flights",  &TcpServer::handleAdminGetAllFlights,  Access::Read,  true,  Rate::Unlimited});
+    m_actions.add({"admin_get_action_stats", &TcpServer::handleAdminGetActionStats, Access::Read,  true,  Rate::Unlimited});
+    m_actions.add({"admin_get_connections",  &TcpServer::handleAdminGetConnections, Access::Read,  true,  Rate::Unlimited});
+    m_actions.add({"admin_get_top_connections", &TcpServer::handleAdminGetTopConnections, Access::Read, true, Rate::Unlimited});
+    m_actions.add({"admin_get_queue_stats",  &TcpServer::handleAdminGetQueueStats,  Access::Read,  true,  Rate::Unlimited});
+    m_actions.add({"admin_get_server_stats", &TcpServer::handleAdminGetServerStats, Access::Read,  true,  Rate::Unlimited});
+    m_actions.add({"admin_set_log_level",    &TcpServer::handleAdminSetLogLevel,    Access::Memory, true, Rate::Unlimited});
+
+    // 如果后续还需要添加其他功能，在这里登记一行即可
+    // 记得一定要添加相对应的handle函数！！！
+}
+
+// 处理一条业务请求，并在响应中回显action与request_id，客户端据此匹配响应
+QJsonObject TcpServer::handleRequest(const QJsonObject& request, const SessionInfo& session)
 {
     QString action = request["action"].toString();
     QJsonObject data = request["data"].toObject();
 
-    if (action == "register") {
-        return handleRegister(data);
-    }
-    if (action == "login") {
-        return handleLogin(data);
-    }
-    if (action == "update_profile") {
-        return handleUpdateProfile(data);
-    }
-    if (action == "search_flights") {
-        return handleSearchFlights(data);
-    }
-    if (action == "book_flight") {
-        return handleBookFlight(data);
-    }
-    if (action == "get_my_orders") {
-        return handleGetMyOrders(data);
-    }
-    if (action == "cancel_order") {
-        return handleCancelOrder(data);
-    }
-    if (action == "admin_add_flight") {
-        return handleAdminAddFlight(data);
-    }
-    if (action == "admin_delete_flight") {
-        return handleAdminDeleteFlight(data);
-    }
-    if (action == "admin_update_flight") {
-        return handleAdminUpdateFlight(data);
-    }
-    if (action == "admin_get_all_users") {
-        return handleAdminGetAllUsers();
-    }
-    if (action == "admin_get_all_bookings") {
-        return handleAdminGetAllBookings();
+    // 处理函数的耗时记为db阶段（解码、编码、写出由Reactor记录）
+    QElapsedTimer timer;
+    timer.start();
+    TraceSpan span("handler");
+    QJsonObject response = routeAction(action, data, session);
+    span.end();
+    m_stats.record(m_actions.indexOf(action), ServerStats::Phase::Db, timer.nsecsElapsed() / 1000);
+    response["action"] = action;
+    if (request.contains("request_id"))
+        response["request_id"] = request["request_id"];
+    return response;
+}
+
+// 请求分发路由器
+QJsonObject TcpServer::routeAction(const QString& action, const QJsonObject& data, const SessionInfo& session)
+{
+    const int index = m_actions.indexOf(action);
+    if (index < 0) {
+        // 处理未知 action
+        return {
+            {"status", "error"},
+            {"message", "未知的 action: " + action}
+        };
     }
-    if (action == "admin_get_all_flights") {
-        return handleAdminGetAllFlights();
+
+    m_actions.recordHit(index);
+    const ActionSpec& spec = m_actions.at(index);
+
+    if (spec.requiresAdmin && !session.isAdmin) {
+        return {
+            {"status", "error"},
+            {"message", "该操作需要管理员权限，请先以管理员身份登录"},
+            {"data", QJsonValue()}
+        };
     }
 
-    // 如果后续还需要添加其他查询功能，按照下面的方式写
-    // 记得一定要添加相对应的handle函数！！！
-    // if (action == "admin_add_flight") {
-    //     return handleAdminAddFlight(data);
-    // }
+    // 不访问数据库的操作不借租约
+    if (spec.access == ActionSpec::Access::Memory)
+        return (this->*spec.handler)(data);
 
-    // 处理未知 action
-    return {
-        {"status", "error"},
-        {"message", "未知的 action: " + action}
-    };
+    // 写操作独占写连接（在这里排队），读操作在自己线程的只读连接上按快照并行执行；
+    // 订票、退票（Journal）不写数据库，只需要读连接，而且不开快照：退票要和内存中的订单对照最新的数据库状态
+    DatabaseLease lease(spec.access == ActionSpec::Access::Write ? DatabaseManager::Role::Write
+                                                                 : DatabaseManager::Role::Read,
+                        spec.access == ActionSpec::Access::Read);
+    return (this->*spec.handler)(data);
 }
 
 // 处理注册
@@ -233,18 +558,16 @@ QJsonObject TcpServer::handleRegister(const QJsonObject& data)
         };
     }
 
-    // 2. 准备 SQL
-    QSqlQuery query(DatabaseManager::instance().database());
-    query.prepare("INSERT INTO User (username, password) VALUES (?, ?)");
-
-    query.addBindValue(username);
-    query.addBindValue(password);
+    // 2. 绑定参数
+    CachedQuery query(Sql::Register);
+    query->bindValue(":username", username);
+    query->bindValue(":password", password);
 
     // 3. 执行 SQL
-    if (!query.exec()) {
+    if (!query->exec()) {
 
         // SQLite UNIQUE 约束错误码是 19
-        if (query.lastError().nativeErrorCode() == "19") {
+        if (query->lastError().nativeErrorCode() == "19") {
             return {
                 {"status", "error"},
                 {"message", QString("用户名 '%1' 已存在").arg(username)},
@@ -255,7 +578,7 @@ QJsonObject TcpServer::handleRegister(const QJsonObject& data)
         // 其他数据库错误
         return {
             {"status", "error"},
-            {"message", "数据库错误：" + query.lastError().text()},
+            {"message", "数据库错误：" + query->lastError().text()},
             {"data", QJsonValue()}
         };
     }
@@ -274,26 +597,25 @@ QJsonObject TcpServer::handleLogin(const QJsonObject& data)
     QString username = data["username"].toString();
     QString password = data["password"].toString();
 
-    QSqlQuery query(DatabaseManager::instance().database());
-    query.prepare("SELECT user_id, is_admin FROM User WHERE username = :user AND password = :pass");
-    query.bindValue(":user", username);
-    query.bindValue(":pass", password);
+    CachedQuery query(Sql::Login);
+    query->bindValue(":user", username);
+    query->bindValue(":pass", password);
 
-    if (!query.exec()) {
+    if (!query->exec()) {
         return {
             {"status", "error"},
-            {"message", "数据库查询失败: " + query.lastError().text()}
+            {"message", "数据库查询失败: " + query->lastError().text()}
         };
     }
 
-    if (query.next()) { // 找到用户信息
+    if (query->next()) { // 找到用户信息
         return {
             {"status", "success"},
             {"message", "登录成功"},
             {"data", QJsonObject{
-                         {"user_id", query.value("user_id").toInt()},
+                         {"user_id", query->value("user_id").toInt()},
                          {"username", username},
-                         {"is_admin", query.value("is_admin").toInt()}
+                         {"is_admin", query->value("is_admin").toInt()}
                      }}
         };
     } else { // 没找到用户信息
@@ -319,21 +641,7 @@ QJsonObject TcpServer::handleUpdateProfile(const QJsonObject &data)
         };
     }
 
-    // 动态构造 SQL
-    QString sql = "UPDATE User SET ";
-    QList<QString> sets;
-    QList<QVariant> binds;
-
-    if (!username.isEmpty()) {
-        sets.append("username = ?");
-        binds.append(username);
-    }
-    if (!password.isEmpty()) {
-        sets.append("password = ?");
-        binds.append(password);
-    }
-
-    if (sets.isEmpty()) {
+    if (username.isEmpty() && password.isEmpty()) {
         return {
             {"status", "error"},
             {"message", "无任何可更新字段"},
@@ -341,20 +649,15 @@ QJsonObject TcpServer::handleUpdateProfile(const QJsonObject &data)
         };
     }
 
-    sql += sets.join(", ");
-    sql += " WHERE user_id = ?";
-
-    binds.append(userId);
+    // 不修改的字段绑定NULL，语句中用 COALESCE 保留原值
+    CachedQuery query(Sql::UpdateProfile);
+    query->bindValue(":username", username.isEmpty() ? QVariant() : QVariant(username));
+    query->bindValue(":password", password.isEmpty() ? QVariant() : QVariant(password));
+    query->bindValue(":user_id", userId);
 
-    QSqlQuery query(DatabaseManager::instance().database());
-    query.prepare(sql);
-
-    for (const QVariant& v : binds)
-        query.addBindValue(v);
-
-    if (!query.exec()) {
+    if (!query->exec()) {
         // 处理 UNIQUE 冲突 (用户名已存在)
-        if (query.lastError().nativeErrorCode() == "19") {
+        if (query->lastError().nativeErrorCode() == "19") {
             return {
                 {"status", "error"},
                 {"message", QString("用户名 '%1' 已存在").arg(username)},
@@ -364,7 +667,7 @@ QJsonObject TcpServer::handleUpdateProfile(const QJsonObject &data)
 
         return {
             {"status", "error"},
-            {"message", "数据库更新失败：" + query.lastError().text()},
+            {"message", "数据库更新失败：" + query->lastError().text()},
             {"data", QJsonValue()}
         };
     }
@@ -383,82 +686,86 @@ QJsonObject TcpServer::handleSearchFlights(const QJsonObject& data)
     QString destination = data.value("destination").toString();
     QString date        = data.value("date").toString();     // YYYY-MM-DD
 
-    // 构建 SQL
-    QString sql = R"(
-        SELECT flight_id, flight_number, model, origin, destination,
-               departure_time, arrival_time, price, remaining_seats, total_seats
-        FROM Flight
-    )";
-
-    QStringList where;
-    QMap<QString, QVariant> binds;
+    // 分页：排序键为 (departure_epoch, flight_id)
+    const int pageSize = pageSizeOf(data);
+    QJsonArray after;
+    if (!decodeCursor(data, 2, after) || (!after.isEmpty() && !after.at(0).isDouble()))
+        return invalidCursorResponse();
 
-    where << "is_deleted = 0";
-
-    if (!origin.isEmpty()) {
-        where << "origin = :origin";
-        binds[":origin"] = origin;
-    }
-    if (!destination.isEmpty()) {
-        where << "destination = :destination";
-        binds[":destination"] = destination;
-    }
+    // 日期换算为 [当天0点, 次日0点) 的整数秒范围，与数据库中departure_epoch的换算方式一致（都当作UTC）
+    // 不指定日期时范围为全部整数，这样所有组合都能用同一条预编译语句
+    qint64 dayBegin = std::numeric_limits<qint64>::min();
+    qint64 dayEnd = std::numeric_limits<qint64>::max();
     if (!date.isEmpty()) {
-        where << "departure_time LIKE :date";  // departure_time LIKE '2025-12-05%'
-        binds[":date"] = date + "%";
-    }
-
-    if (!where.isEmpty()) {
-        sql += " WHERE " + where.join(" AND ");
-    }
-
-    sql += " ORDER BY departure_time ASC LIMIT " + QString::number(MAX_RETURN_ROWS);
-
-    QSqlQuery query(DatabaseManager::instance().database());
-    if (!query.prepare(sql)) {
-        return {
-            {"status", "error"},
-            {"message", "数据库 prepare 失败：" + query.lastError().text()},
-            {"data", QJsonValue()}
-        };
-    }
-
-    for (auto it = binds.begin(); it != binds.end(); ++it) {
-        query.bindValue(it.key(), it.value());
+        const QDate day = QDate::fromString(date, Qt::ISODate);
+        if (!day.isValid()) {
+            return {
+                {"status", "error"},
+                {"message", "日期格式无效，应为 YYYY-MM-DD"},
+                {"data", QJsonValue()}
+            };
+        }
+        dayBegin = day.startOfDay(Qt::UTC).toSecsSinceEpoch();
+        dayEnd = dayBegin + 24 * 60 * 60;
     }
 
-
-    if (!query.exec()) {
+    // 起降地都给出时走 idx_flight_route_epoch，否则走 idx_flight_departure_epoch，都是范围定位且不需要排序
+    static const Sql variants[2][2] = {
+        {Sql::SearchFlights,     Sql::SearchFlightsTo},
+        {Sql::SearchFlightsFrom, Sql::SearchFlightsRoute}
+    };
+    CachedQuery query(variants[!origin.isEmpty()][!destination.isEmpty()]);
+
+    if (!origin.isEmpty())
+        query->bindValue(":origin", origin);
+    if (!destination.isEmpty())
+        query->bindValue(":destination", destination);
+    query->bindValue(":day_begin", dayBegin);
+    query->bindValue(":day_end", dayEnd);
+    // 第一页的cursor比所有航班都小
+    query->bindValue(":after_epoch", after.isEmpty() ? std::numeric_limits<qint64>::min()
+                                                     : static_cast<qint64>(after.at(0).toDouble()));
+    query->bindValue(":after_id", after.isEmpty() ? 0 : after.at(1).toInt());
+    // 多取一行，用来判断是否还有下一页
+    query->bindValue(":limit", pageSize + 1);
+
+    TraceSpan step("search_flights.query");
+    if (!query->exec()) {
         return {
             {"status", "error"},
-            {"message", "数据库查询失败：" + query.lastError().text()},
+            {"message", "数据库查询失败：" + query->lastError().text()},
             {"data", QJsonValue()}
         };
     }
 
+    step.next("search_flights.fetch_rows");
     QJsonArray flights;
+    QString nextCursor;
+
+    qint64 lastEpoch = 0;
+    while (query->next()) {
+        if (flights.size() == pageSize) {
+            nextCursor = encodeCursor({lastEpoch, flights.last().toObject().value("flight_id")});
+            break;
+        }
+        lastEpoch = query->value("departure_epoch").toLongLong();
 
-    while (query.next()) {
         QJsonObject f;
-        f["flight_id"]       = query.value("flight_id").toInt();
-        f["flight_number"]   = query.value("flight_number").toString();
-        f["model"]           = query.value("model").toString();
-        f["origin"]          = query.value("origin").toString();
-        f["destination"]     = query.value("destination").toString();
-        f["departure_time"]  = query.value("departure_time").toString();
-        f["arrival_time"]    = query.value("arrival_time").toString();
-        f["price"]           = query.value("price").toDouble();
-        f["total_seats"]     = query.value("total_seats").toInt();
-        f["remaining_seats"] = query.value("remaining_seats").toInt();
+        f["flight_id"]       = query->value("flight_id").toInt();
+        f["flight_number"]   = query->value("flight_number").toString();
+        f["model"]           = query->value("model").toString();
+        f["origin"]          = query->value("origin").toString();
+        f["destination"]     = query->value("destination").toString();
+        f["departure_time"]  = query->value("departure_time").toString();
+        f["arrival_time"]    = query->value("arrival_time").toString();
+        f["price"]           = query->value("price").toDouble();
+        f["total_seats"]     = query->value("total_seats").toInt();
+        f["remaining_seats"] = remainingSeatsOf(f["flight_id"].toInt(), query->value("remaining_seats").toInt());
 
         flights.append(f);
     }
 
-    return {
-        {"status", "success"},
-        {"message", "查询成功"},
-        {"data", flights}
-    };
+    return pageResponse("查询成功", flights, nextCursor);
 }
 
 
@@ -476,64 +783,42 @@ QJsonObject TcpServer::handleBookFlight(const QJsonObject& data)
         };
     }
 
-    QSqlDatabase db = DatabaseManager::instance().database();
-    if (!db.transaction()) {
-        return {
-            {"status", "error"},
-            {"message", "无法开启事务：" + db.lastError().text()},
-            {"data", QJsonValue()}
-        };
-    }
-
-    // 1. 检查航班是否存在并读取剩余座位
-    QSqlQuery q1(db);
-    q1.prepare(R"(
-        SELECT remaining_seats
-        FROM Flight
-        WHERE flight_id = :flight_id
-    )");
-    q1.bindValue(":flight_id", flightId);
+    // 1. 检查用户是否存在（订单在后台写回时才会检查外键，这里先挡住无效的用户）
+    // 被采样追踪时记录每一步的耗时
+    TraceSpan step("book_flight.check_user");
+    {
+        CachedQuery user(Sql::UserIsAdmin);
+        user->bindValue(":user_id", userId);
 
-    if (!q1.exec() || !q1.next()) {
-        db.rollback();
-        return {
-            {"status", "error"},
-            {"message", "航班不存在或查询失败：" + q1.lastError().text()},
-            {"data", QJsonValue()}
-        };
-    }
+        if (!user->exec()) {
+            return {
+                {"status", "error"},
+                {"message", "查询用户失败：" + user->lastError().text()},
+                {"data", QJsonValue()}
+            };
+        }
 
-    int remaining = q1.value("remaining_seats").toInt();
-    if (remaining <= 0) {
-        db.rollback();
-        return {
-            {"status", "error"},
-            {"message", "票已售罄"},
-            {"data", QJsonValue()}
-        };
+        if (!user->next()) {
+            return {
+                {"status", "error"},
+                {"message", "用户不存在"},
+                {"data", QJsonValue()}
+            };
+        }
     }
 
-    // 2. 扣减剩余座位（并发安全：必须 remaining_seats > 0 才扣）
-    QSqlQuery q2(db);
-    q2.prepare(R"(
-        UPDATE Flight
-        SET remaining_seats = remaining_seats - 1
-        WHERE flight_id = :flight_id
-          AND remaining_seats > 0
-    )");
-    q2.bindValue(":flight_id", flightId);
-
-    if (!q2.exec()) {
-        db.rollback();
+    // 2. 在内存库存上扣减一个座位（原子操作：余票为0时失败，不会超卖）
+    step.next("book_flight.reserve");
+    const SeatInventory::Reserve reserved = m_inventory.reserve(flightId);
+    if (reserved == SeatInventory::Reserve::UnknownFlight) {
         return {
             {"status", "error"},
-            {"message", "扣减座位失败：" + q2.lastError().text()},
+            {"message", "航班不存在"},
             {"data", QJsonValue()}
         };
     }
 
-    if (q2.numRowsAffected() == 0) {
-        db.rollback();
+    if (reserved == SeatInventory::Reserve::SoldOut) {
         return {
             {"status", "error"},
             {"message", "票已售罄"},
@@ -541,34 +826,20 @@ QJsonObject TcpServer::handleBookFlight(const QJsonObject& data)
         };
     }
 
-    // 3. 插入订单（状态：confirmed）
-    QSqlQuery q3(db);
-    q3.prepare(R"(
-        INSERT INTO Booking (user_id, flight_id, status)
-        VALUES (:user_id, :flight_id, 'confirmed')
-    )");
-    q3.bindValue(":user_id", userId);
-    q3.bindValue(":flight_id", flightId);
-
-    if (!q3.exec()) {
-        db.rollback();
+    // 3. 追加到订单日志（订单号在这里分配），之后由后台写回数据库
+    step.next("book_flight.journal");
+    const int bookingId = m_journal.book(userId, flightId);
+    if (bookingId <= 0) {
+        m_inventory.release(flightId);
         return {
             {"status", "error"},
-            {"message", "订单创建失败：" + q3.lastError().text()},
+            {"message", "订单创建失败：订单日志不可用"},
             {"data", QJsonValue()}
         };
     }
 
-    int bookingId = q3.lastInsertId().toInt();
-
-    if (!db.commit()) {
-        db.rollback();
-        return {
-            {"status", "error"},
-            {"message", "提交事务失败：" + db.lastError().text()},
-            {"data", QJsonValue()}
-        };
-    }
+    step.end();
+    markSeatsChanged(flightId);
 
     // 返回订单基础信息
     QJsonObject info;
@@ -598,16 +869,15 @@ QJsonObject TcpServer::handleGetMyOrders(const QJsonObject& data)
         };
     }
 
+    // 还没写回数据库的订单从订单日志取，不等待写回
+    // 必须在第一条查询之前：读事务的快照是在第一次读的时候才建立的
+    const QList<BookingJournal::PendingBooking> pending = m_journal.pendingBookings();
+
     // 1. 判断是否为管理员
-    QSqlQuery userQuery(DatabaseManager::instance().database());
-    userQuery.prepare(R"(
-        SELECT is_admin
-        FROM User
-        WHERE user_id = :user_id
-    )");
-    userQuery.bindValue(":user_id", userId);
-
-    if (!userQuery.exec() || !userQuery.next()) {
+    CachedQuery userQuery(Sql::UserIsAdmin);
+    userQuery->bindValue(":user_id", userId);
+
+    if (!userQuery->exec() || !userQuery->next()) {
         return {
             {"status", "error"},
             {"message", "用户不存在"},
@@ -615,7 +885,7 @@ QJsonObject TcpServer::handleGetMyOrders(const QJsonObject& data)
         };
     }
 
-    bool isAdmin = userQuery.value("is_admin").toInt() == 1;
+    bool isAdmin = userQuery->value("is_admin").toInt() == 1;
 
     // 2. 决定最终查询的用户ID
     int queryUserId = userId;
@@ -633,63 +903,52 @@ QJsonObject TcpServer::handleGetMyOrders(const QJsonObject& data)
         };
     }
 
-    // 3. 查询订单
-    QSqlQuery query(DatabaseManager::instance().database());
-    query.prepare(R"(
-        SELECT
-            b.booking_id,
-            b.flight_id,
-            b.status,
-            b.booking_time,
-            f.flight_number,
-            f.origin,
-            f.destination,
-            f.departure_time,
-            f.arrival_time,
-            f.price,
-            f.is_deleted
-        FROM Booking b
-        JOIN Flight f ON b.flight_id = f.flight_id
-        WHERE b.user_id = :user_id
-        ORDER BY b.booking_time DESC
-        LIMIT :limit
-    )");
-
-    query.bindValue(":user_id", userId);
-    query.bindValue(":limit", MAX_RETURN_ROWS);
-
-    if (!query.exec()) {
+    // 3. 查询订单（分页：按 (booking_time, booking_id) 倒序）
+    const int pageSize = pageSizeOf(data);
+    QJsonArray after;
+    if (!decodeCursor(data, 2, after))
+        return invalidCursorResponse();
+
+    // 第一页的cursor比所有订单都大
+    CachedQuery query(Sql::OrdersOfUser);
+    query->bindValue(":user_id", queryUserId);
+    query->bindValue(":after_time", after.isEmpty() ? QStringLiteral("9999-12-31 23:59:59") : after.at(0).toString());
+    query->bindValue(":after_id", after.isEmpty() ? std::numeric_limits<qint64>::max() : after.at(1).toInt());
+    query->bindValue(":limit", pageSize + 1); // 多取一行，用来判断是否还有下一页
+
+    if (!query->exec()) {
         return {
             {"status", "error"},
-            {"message", "查询失败：" + query.lastError().text()},
+            {"message", "查询失败：" + query->lastError().text()},
             {"data", QJsonValue()}
         };
     }
 
-    QJsonArray arr;
+    QList<QJsonObject> rows;
 
-    while (query.next()) {
+    while (query->next()) {
         QJsonObject item;
-        item["booking_id"]     = query.value("booking_id").toInt();
-        item["flight_id"]      = query.value("flight_id").toInt();
-        item["status"]         = query.value("status").toString();
-        item["booking_time"]   = query.value("booking_time").toString();
-        item["flight_number"]  = query.value("flight_number").toString();
-        item["origin"]         = query.value("origin").toString();
-        item["destination"]    = query.value("destination").toString();
-        item["departure_time"] = query.value("departure_time").toString();
-        item["arrival_time"]   = query.value("arrival_time").toString();
-        item["price"]          = query.value("price").toDouble();
-        item["is_deleted"]     = query.value("is_deleted").toInt();
-
+        item["booking_id"]     = query->value("booking_id").toInt();
+        item["flight_id"]      = query->value("flight_id").toInt();
+        item["status"]         = query->value("status").toString();
+        item["booking_time"]   = query->value("booking_time").toString();
+        item["flight_number"]  = query->value("flight_number").toString();
+        item["origin"]         = query->value("origin").toString();
+        item["destination"]    = query->value("destination").toString();
+        item["departure_time"] = query->value("departure_time").toString();
+        item["arrival_time"]   = query->value("arrival_time").toString();
+        item["price"]          = query->value("price").toDouble();
+        item["is_deleted"]     = query->value("is_deleted").toInt();
+
+        rows.append(item);
+    }
+
+    const QString nextCursor = mergePendingBookings(rows, pending, queryUserId, false, after, pageSize);
+    QJsonArray arr;
+    for (const QJsonObject& item : std::as_const(rows))
         arr.append(item);
-    }
 
-    return {
-        {"status", "success"},
-        {"message", "查询成功"},
-        {"data", arr}
-    };
+    return pageResponse("查询成功", arr, nextCursor);
 }
 
 // 取消订单
@@ -705,104 +964,109 @@ QJsonObject TcpServer::handleCancelOrder(const QJsonObject& data)
         };
     }
 
-    QSqlDatabase db = DatabaseManager::instance().database();
-    if (!db.transaction()) {
+    // 订单日志负责判断订单状态（还没写回的订单在内存里）并追加退票记录
+    TraceSpan step("cancel_order.journal");
+    int flightId = 0;
+    QString error;
+    switch (m_journal.cancel(bookingId, flightId, error)) {
+    case BookingJournal::CancelResult::NotFound:
         return {
             {"status", "error"},
-            {"message", "无法开启事务：" + db.lastError().text()},
+            {"message", "订单不存在"},
             {"data", QJsonValue()}
         };
-    }
-
-    // 1. 查询订单状态与 flight_id
-    QSqlQuery q1(db);
-    q1.prepare(R"(
-        SELECT flight_id, status
-        FROM Booking
-        WHERE booking_id = :booking_id
-    )");
-    q1.bindValue(":booking_id", bookingId);
-
-    if (!q1.exec()) {
-        db.rollback();
+    // 已取消不可重复取消
+    case BookingJournal::CancelResult::AlreadyCancelled:
         return {
             {"status", "error"},
-            {"message", "订单查询失败：" + q1.lastError().text()},
+            {"message", "订单已取消"},
             {"data", QJsonValue()}
         };
-    }
-
-    if (!q1.next()) {
-        db.rollback();
+    case BookingJournal::CancelResult::Failed:
         return {
             {"status", "error"},
-            {"message", "订单不存在"},
+            {"message", "取消订单失败：" + error},
             {"data", QJsonValue()}
         };
+    case BookingJournal::CancelResult::Ok:
+        break;
     }
 
-    int flightId = q1.value("flight_id").toInt();
-    QString status = q1.value("status").toString();
+    // 恢复航班剩余座位
+    step.end();
+    m_inventory.release(flightId);
+    markSeatsChanged(flightId);
 
-    // 已取消不可重复取消
-    if (status == "cancelled") {
-        db.rollback();
+    return {
+        {"status", "success"},
+        {"message", "订单取消成功"},
+        {"data", QJsonValue()}
+    };
+}
+
+// 订阅航班余票：data.flight_ids为航班id列表，替换该连接之前的订阅（空列表表示取消订阅）
+// 订阅本身由Reactor在收到成功响应后记录，这里只负责校验并返回这些航班当前的余票
+QJsonObject TcpServer::handleSubscribeFlights(const QJsonObject& data)
+{
+    const QJsonArray requested = data.value("flight_ids").toArray();
+    if (requested.size() > MAX_SUBSCRIBED_FLIGHTS) {
         return {
             {"status", "error"},
-            {"message", "订单已取消"},
+            {"message", QString("一次最多订阅 %1 个航班").arg(MAX_SUBSCRIBED_FLIGHTS)},
             {"data", QJsonValue()}
         };
     }
 
-    // 2. 将订单状态改为取消
-    QSqlQuery q2(db);
-    q2.prepare(R"(
-        UPDATE Booking
-        SET status = 'cancelled'
-        WHERE booking_id = :booking_id
-    )");
-    q2.bindValue(":booking_id", bookingId);
-
-    if (!q2.exec()) {
-        db.rollback();
-        return {
-            {"status", "error"},
-            {"message", "更新订单状态失败：" + q2.lastError().text()},
-            {"data", QJsonValue()}
-        };
+    QList<int> flightIds;
+    for (const QJsonValue& value : requested) {
+        const int flightId = value.toInt();
+        if (flightId <= 0) {
+            return {
+                {"status", "error"},
+                {"message", "flight_ids 中包含无效的航班id"},
+                {"data", QJsonValue()}
+            };
+        }
+        if (!flightIds.contains(flightId))
+            flightIds.append(flightId);
     }
 
-    // 3. 恢复航班剩余座位
-    QSqlQuery q3(db);
-    q3.prepare(R"(
-        UPDATE Flight
-        SET remaining_seats = remaining_seats + 1
-        WHERE flight_id = :flight_id
-    )");
-    q3.bindValue(":flight_id", flightId);
+    QJsonArray ids;
+    QJsonArray flights;
+    if (!flightIds.isEmpty()) {
+        QJsonArray requestedIds;
+        for (int flightId : std::as_const(flightIds))
+            requestedIds.append(flightId);
 
-    if (!q3.exec()) {
-        db.rollback();
-        return {
-            {"status", "error"},
-            {"message", "恢复座位失败：" + q3.lastError().text()},
-            {"data", QJsonValue()}
-        };
-    }
+        CachedQuery query(Sql::SubscribeSeats);
+        query->bindValue(":ids", QString::fromUtf8(QJsonDocument(requestedIds).toJson(QJsonDocument::Compact)));
 
-    if (!db.commit()) {
-        db.rollback();
-        return {
-            {"status", "error"},
-            {"message", "提交事务失败：" + db.lastError().text()},
-            {"data", QJsonValue()}
-        };
+        if (!query->exec()) {
+            return {
+                {"status", "error"},
+                {"message", "查询失败：" + query->lastError().text()},
+                {"data", QJsonValue()}
+            };
+        }
+
+        // 只订阅存在的航班
+        while (query->next()) {
+            QJsonObject obj;
+            obj["flight_id"]       = query->value(0).toInt();
+            obj["remaining_seats"] = remainingSeatsOf(obj["flight_id"].toInt(), query->value(1).toInt());
+            ids.append(obj["flight_id"]);
+            flights.append(obj);
+        }
     }
 
+    QJsonObject result;
+    result["flight_ids"] = ids;
+    result["flights"]    = flights;
+
     return {
         {"status", "success"},
-        {"message", "订单取消成功"},
-        {"data", QJsonValue()}
+        {"message", ids.isEmpty() ? "已取消订阅" : "订阅成功"},
+        {"data", result}
     };
 }
 
@@ -831,37 +1095,40 @@ QJsonObject TcpServer::handleAdminAddFlight(const QJsonObject& data)
         };
     }
 
-    QSqlQuery query(DatabaseManager::instance().database());
-    query.prepare(R"(
-        INSERT INTO Flight (
-            flight_number, model, origin, destination,
-            departure_time, arrival_time,
-            total_seats, remaining_seats, price
-        ) VALUES (
-            :flight_number, :model, :origin, :destination,
-            :departure_time, :arrival_time,
-            :total_seats, :remaining_seats, :price
-        )
-    )");
-
-    query.bindValue(":flight_number",   flightNumber);
-    query.bindValue(":model",           model);
-    query.bindValue(":origin",          origin);
-    query.bindValue(":destination",     destination);
-    query.bindValue(":departure_time",  departureTime);
-    query.bindValue(":arrival_time",    arrivalTime);
-    query.bindValue(":total_seats",     totalSeats);
-    query.bindValue(":remaining_seats", totalSeats);
-    query.bindValue(":price",           price);
-
-    if (!query.exec()) {
+    if (!normalizeFlightTime(departureTime, departureTime) || !normalizeFlightTime(arrivalTime, arrivalTime)) {
+        return {
+            {"status", "error"},
+            {"message", "departure_time 和 arrival_time 的格式应为 YYYY-MM-DD HH:MM:SS"},
+            {"data", QJsonValue()}
+        };
+    }
+
+    CachedQuery query(Sql::AdminAddFlight);
+    query->bindValue(":flight_number",   flightNumber);
+    query->bindValue(":model",           model);
+    query->bindValue(":origin",          origin);
+    query->bindValue(":destination",     destination);
+    query->bindValue(":departure_time",  departureTime);
+    query->bindValue(":arrival_time",    arrivalTime);
+    query->bindValue(":total_seats",     totalSeats);
+    query->bindValue(":remaining_seats", totalSeats);
+    query->bindValue(":price",           price);
+
+    if (!query->exec()) {
         return {
             {"status", "error"},
-            {"message", "数据库插入失败：" + query.lastError().text()},
+            {"message", "数据库插入失败：" + query->lastError().text()},
             {"data", QJsonValue()}
         };
     }
 
+    // 新航班加入内存库存之后才能订票
+    const int flightId = query->lastInsertId().toInt();
+    runAfterCommit([this, flightId, totalSeats]() {
+        if (!m_inventory.set(flightId, totalSeats))
+            LOG_WARN() << "新航班无法加入内存库存:" << flightId;
+    });
+
     return {
         {"status", "success"},
         {"message", "航班添加成功"},
@@ -896,24 +1163,26 @@ QJsonObject TcpServer::handleAdminUpdateFlight(const QJsonObject& data)
         };
     }
 
-    QSqlQuery q1(DatabaseManager::instance().database());
-    q1.prepare(R"(
-        SELECT total_seats, remaining_seats
-        FROM Flight
-        WHERE flight_id = :flight_id
-    )");
+    if (!normalizeFlightTime(departureTime, departureTime) || !normalizeFlightTime(arrivalTime, arrivalTime)) {
+        return {
+            {"status", "error"},
+            {"message", "departure_time 和 arrival_time 的格式应为 YYYY-MM-DD HH:MM:SS"},
+            {"data", QJsonValue()}
+        };
+    }
 
-    q1.bindValue(":flight_id", flightId);
+    CachedQuery q1(Sql::AdminSelectFlightSeats);
+    q1->bindValue(":flight_id", flightId);
 
-    if (!q1.exec()) {
+    if (!q1->exec()) {
         return {
             {"status", "error"},
-            {"message", "查询失败：" + q1.lastError().text()},
+            {"message", "查询失败：" + q1->lastError().text()},
             {"data", QJsonValue()}
         };
     }
 
-    if (!q1.next()) {
+    if (!q1->next()) {
         return {
             {"status", "error"},
             {"message", "航班不存在"},
@@ -921,8 +1190,9 @@ QJsonObject TcpServer::handleAdminUpdateFlight(const QJsonObject& data)
         };
     }
 
-    int oldTotalSeats     = q1.value("total_seats").toInt();
-    int oldRemainingSeats = q1.value("remaining_seats").toInt();
+    int oldTotalSeats     = q1->value("total_seats").toInt();
+    // 余票以内存库存为准：数据库里的值可能还没包含订单日志中最近的订票、退票
+    int oldRemainingSeats = remainingSeatsOf(flightId, q1->value("remaining_seats").toInt());
 
     // 剩余票数不能 > 总票数
     if (remainingSeats > totalSeats) {
@@ -943,39 +1213,34 @@ QJsonObject TcpServer::handleAdminUpdateFlight(const QJsonObject& data)
         };
     }
 
-    // 更新航班
-    QSqlQuery q2(DatabaseManager::instance().database());
-    q2.prepare(R"(
-        UPDATE Flight SET
-            flight_number   = :flight_number,
-            origin          = :origin,
-            destination     = :destination,
-            departure_time  = :departure_time,
-            arrival_time    = :arrival_time,
-            price           = :price,
-            total_seats     = :total_seats,
-            remaining_seats = :remaining_seats
-        WHERE flight_id = :flight_id
-    )");
-
-    q2.bindValue(":flight_number",   flightNumber);
-    q2.bindValue(":origin",          origin);
-    q2.bindValue(":destination",     destination);
-    q2.bindValue(":departure_time",  departureTime);
-    q2.bindValue(":arrival_time",    arrivalTime);
-    q2.bindValue(":price",           price);
-    q2.bindValue(":total_seats",     totalSeats);
-    q2.bindValue(":remaining_seats", remainingSeats);
-    q2.bindValue(":flight_id",       flightId);
-
-    if (!q2.exec()) {
+    // 更新航班：余票按差值修改，内存库存和数据库都不会覆盖同时进行的订票、退票
+    const int seatDelta = remainingSeats - oldRemainingSeats;
+    CachedQuery q2(Sql::AdminUpdateFlight);
+    q2->bindValue(":flight_number",   flightNumber);
+    q2->bindValue(":origin",          origin);
+    q2->bindValue(":destination",     destination);
+    q2->bindValue(":departure_time",  departureTime);
+    q2->bindValue(":arrival_time",    arrivalTime);
+    q2->bindValue(":price",           price);
+    q2->bindValue(":total_seats",     totalSeats);
+    q2->bindValue(":seat_delta",      seatDelta);
+    q2->bindValue(":flight_id",       flightId);
+
+    if (!q2->exec()) {
         return {
             {"status", "error"},
-            {"message", "数据库更新失败：" + q2.lastError().text()},
+            {"message", "数据库更新失败：" + q2->lastError().text()},
             {"data", QJsonValue()}
         };
     }
 
+    if (seatDelta != 0) {
+        runAfterCommit([this, flightId, seatDelta]() {
+            m_inventory.adjust(flightId, seatDelta);
+            markSeatsChanged(flightId);
+        });
+    }
+
     return {
         {"status", "success"},
         {"message", "航班更新成功"},
@@ -997,23 +1262,18 @@ QJsonObject TcpServer::handleAdminDeleteFlight(const QJsonObject& data)
     }
 
     // 检查航班是否存在
-    QSqlQuery q1(DatabaseManager::instance().database());
-    q1.prepare(R"(
-        SELECT flight_id, is_deleted
-        FROM Flight
-        WHERE flight_id = :flight_id
-    )");
-    q1.bindValue(":flight_id", flightId);
-
-    if (!q1.exec()) {
+    CachedQuery q1(Sql::AdminSelectFlightDeleted);
+    q1->bindValue(":flight_id", flightId);
+
+    if (!q1->exec()) {
         return {
             {"status", "error"},
-            {"message", "查询失败：" + q1.lastError().text()},
+            {"message", "查询失败：" + q1->lastError().text()},
             {"data", QJsonValue()}
         };
     }
 
-    if (!q1.next()) {
+    if (!q1->next()) {
         return {
             {"status", "error"},
             {"message", "航班不存在"},
@@ -1022,7 +1282,7 @@ QJsonObject TcpServer::handleAdminDeleteFlight(const QJsonObject& data)
     }
 
     // 已删除的航班不重复删除
-    if (q1.value("is_deleted").toInt() == 1) {
+    if (q1->value("is_deleted").toInt() == 1) {
         return {
             {"status", "error"},
             {"message", "航班已删除，无需重复操作"},
@@ -1031,18 +1291,13 @@ QJsonObject TcpServer::handleAdminDeleteFlight(const QJsonObject& data)
     }
 
     // 软删除：设置 is_deleted = 1
-    QSqlQuery q2(DatabaseManager::instance().database());
-    q2.prepare(R"(
-        UPDATE Flight
-        SET is_deleted = 1
-        WHERE flight_id = :flight_id
-    )");
-    q2.bindValue(":flight_id", flightId);
-
-    if (!q2.exec()) {
+    CachedQuery q2(Sql::AdminDeleteFlight);
+    q2->bindValue(":flight_id", flightId);
+
+    if (!q2->exec()) {
         return {
             {"status", "error"},
-            {"message", "删除航班失败：" + q2.lastError().text()},
+            {"message", "删除航班失败：" + q2->lastError().text()},
             {"data", QJsonValue()}
         };
     }
@@ -1055,173 +1310,429 @@ QJsonObject TcpServer::handleAdminDeleteFlight(const QJsonObject& data)
 }
 
 // 管理员-获取所有用户
-QJsonObject TcpServer::handleAdminGetAllUsers()
+QJsonObject TcpServer::handleAdminGetAllUsers(const QJsonObject& data)
 {
-    QString sql = QString(R"(
-        SELECT
-            user_id,
-            username,
-            is_admin,
-            created_at
-        FROM User
-        ORDER BY user_id ASC
-        LIMIT %1
-    )").arg(MAX_RETURN_ROWS);
-
-    QSqlQuery query(DatabaseManager::instance().database());
-
-    if (!query.exec(sql)) {
+    // 分页：排序键为 user_id（主键）
+    const int pageSize = pageSizeOf(data);
+    QJsonArray after;
+    if (!decodeCursor(data, 1, after))
+        return invalidCursorResponse();
+
+    // 第一页的cursor为0（比所有user_id都小）
+    CachedQuery query(Sql::AdminAllUsers);
+    query->bindValue(":after_id", after.isEmpty() ? 0 : after.at(0).toInt());
+    query->bindValue(":limit", pageSize + 1);
+
+    if (!query->exec()) {
         return {
             {"status", "error"},
-            {"message", "查询用户失败：" + query.lastError().text()},
+            {"message", "查询用户失败：" + query->lastError().text()},
             {"data", QJsonValue()}
         };
     }
 
     QJsonArray users;
+    QString nextCursor;
+
+    while (query->next()) {
+        if (users.size() == pageSize) {
+            nextCursor = encodeCursor({users.last().toObject()["user_id"]});
+            break;
+        }
 
-    while (query.next()) {
         QJsonObject obj;
-        obj["user_id"]    = query.value("user_id").toInt();
-        obj["username"]   = query.value("username").toString();
-        obj["is_admin"]   = query.value("is_admin").toInt();
-        obj["created_at"] = query.value("created_at").toString();
+        obj["user_id"]    = query->value("user_id").toInt();
+        obj["username"]   = query->value("username").toString();
+        obj["is_admin"]   = query->value("is_admin").toInt();
+        obj["created_at"] = query->value("created_at").toString();
 
         users.append(obj);
     }
 
-    return {
-        {"status", "success"},
-        {"message", users.size() >= MAX_RETURN_ROWS
-                        ? "查询用户成功（结果已限制为最多1000条）"
-                        : "查询用户成功"},
-        {"data", users}
-    };
+    return pageResponse("查询用户成功", users, nextCursor);
 }
 
 
 // 管理员-获取所有订单（含航班信息）
-QJsonObject TcpServer::handleAdminGetAllBookings()
+QJsonObject TcpServer::handleAdminGetAllBookings(const QJsonObject& data)
 {
-    QString sql = QString(R"(
-        SELECT
-            b.booking_id,
-            b.user_id,
-            b.flight_id,
-            b.status,
-            b.booking_time,
-
-            u.username,
-
-            f.flight_number,
-            f.model,
-            f.origin,
-            f.destination,
-            f.departure_time,
-            f.arrival_time,
-            f.price,
-            f.is_deleted
-        FROM Booking b
-        JOIN User   u ON b.user_id  = u.user_id
-        JOIN Flight f ON b.flight_id = f.flight_id
-        ORDER BY b.booking_time DESC
-        LIMIT %1
-    )").arg(MAX_RETURN_ROWS);
-
-    QSqlQuery query(DatabaseManager::instance().database());
-
-    if (!query.exec(sql)) {
+    // 分页：按 (booking_time, booking_id) 倒序
+    const int pageSize = pageSizeOf(data);
+    QJsonArray after;
+    if (!decodeCursor(data, 2, after))
+        return invalidCursorResponse();
+
+    // 和查询我的订单一样，合并订单日志中还没写回的订单
+    const QList<BookingJournal::PendingBooking> pending = m_journal.pendingBookings();
+
+    // 第一页的cursor比所有订单都大
+    CachedQuery query(Sql::AdminAllBookings);
+    query->bindValue(":after_time", after.isEmpty() ? QStringLiteral("9999-12-31 23:59:59") : after.at(0).toString());
+    query->bindValue(":after_id", after.isEmpty() ? std::numeric_limits<qint64>::max() : after.at(1).toInt());
+    query->bindValue(":limit", pageSize + 1);
+
+    if (!query->exec()) {
         return {
             {"status", "error"},
-            {"message", "查询订单失败：" + query.lastError().text()},
+            {"message", "查询订单失败：" + query->lastError().text()},
             {"data", QJsonValue()}
         };
     }
 
-    QJsonArray bookings;
+    QList<QJsonObject> rows;
 
-    while (query.next()) {
+    while (query->next()) {
         QJsonObject obj;
 
-        obj["booking_id"]      = query.value("booking_id").toInt();
-        obj["user_id"]         = query.value("user_id").toInt();
-        obj["flight_id"]       = query.value("flight_id").toInt();
-        obj["status"]          = query.value("status").toString();
-        obj["booking_time"]    = query.value("booking_time").toString();
+        obj["booking_id"]      = query->value("booking_id").toInt();
+        obj["user_id"]         = query->value("user_id").toInt();
+        obj["flight_id"]       = query->value("flight_id").toInt();
+        obj["status"]          = query->value("status").toString();
+        obj["booking_time"]    = query->value("booking_time").toString();
+
+        obj["username"]        = query->value("username").toString();
 
-        obj["username"]        = query.value("username").toString();
+        obj["flight_number"]   = query->value("flight_number").toString();
+        obj["model"]           = query->value("model").toString();
+        obj["origin"]          = query->value("origin").toString();
+        obj["destination"]     = query->value("destination").toString();
+        obj["departure_time"]  = query->value("departure_time").toString();
+        obj["arrival_time"]    = query->value("arrival_time").toString();
+        obj["price"]           = query->value("price").toDouble();
+        obj["is_deleted"]      = query->value("is_deleted").toInt();
 
-        obj["flight_number"]   = query.value("flight_number").toString();
-        obj["model"]           = query.value("model").toString();
-        obj["origin"]          = query.value("origin").toString();
-        obj["destination"]     = query.value("destination").toString();
-        obj["departure_time"]  = query.value("departure_time").toString();
-        obj["arrival_time"]    = query.value("arrival_time").toString();
-        obj["price"]           = query.value("price").toDouble();
-        obj["is_deleted"]      = query.value("is_deleted").toInt();
+        rows.append(obj);
+    }
 
+    const QString nextCursor = mergePendingBookings(rows, pending, 0, true, after, pageSize);
+    QJsonArray bookings;
+    for (const QJsonObject& obj : std::as_const(rows))
         bookings.append(obj);
+
+    return pageResponse("查询所有订单成功", bookings, nextCursor);
+}
+
+
+// 管理员-获取所有航班列表
+QJsonObject TcpServer::handleAdminGetAllFlights(const QJsonObject& data)
+{
+    // 分页：排序键为 (departure_time, flight_id)
+    const int pageSize = pageSizeOf(data);
+    QJsonArray after;
+    if (!decodeCursor(data, 2, after))
+        return invalidCursorResponse();
+
+    // 第一页的cursor为 ('', 0)，比所有航班都小
+    CachedQuery query(Sql::AdminAllFlights);
+    query->bindValue(":after_time", after.isEmpty() ? QString("") : after.at(0).toString());
+    query->bindValue(":after_id", after.isEmpty() ? 0 : after.at(1).toInt());
+    query->bindValue(":limit", pageSize + 1);
+
+    if (!query->exec()) {
+        return {
+            {"status", "error"},
+            {"message", "查询失败：" + query->lastError().text()},
+            {"data", QJsonValue()}
+        };
+    }
+
+    QJsonArray arr;
+    QString nextCursor;
+
+    while (query->next()) {
+        if (arr.size() == pageSize) {
+            const QJsonObject last = arr.last().toObject();
+            nextCursor = encodeCursor({last["departure_time"], last["flight_id"]});
+            break;
+        }
+
+        QJsonObject obj;
+        obj["flight_id"]       = query->value("flight_id").toInt();
+        obj["flight_number"]   = query->value("flight_number").toString();
+        obj["model"]           = query->value("model").toString();
+        obj["origin"]          = query->value("origin").toString();
+        obj["destination"]     = query->value("destination").toString();
+        obj["departure_time"]  = query->value("departure_time").toString();
+        obj["arrival_time"]    = query->value("arrival_time").toString();
+        obj["total_seats"]     = query->value("total_seats").toInt();
+        obj["remaining_seats"] = remainingSeatsOf(obj["flight_id"].toInt(), query->value("remaining_seats").toInt());
+        obj["price"]           = query->value("price").toDouble();
+        obj["is_deleted"]      = query->value("is_deleted").toInt();
+        arr.append(obj);
+    }
+
+    return pageResponse("查询成功", arr, nextCursor);
+}
+
+// 管理员-查看各action的调用次数
+QJsonObject TcpServer::handleAdminGetActionStats(const QJsonObject&)
+{
+    QJsonArray stats;
+    for (int i = 0; i < m_actions.size(); ++i) {
+        const ActionSpec& spec = m_actions.at(i);
+        QJsonObject obj;
+        obj["action"]         = spec.name;
+        obj["access"]         = spec.access == ActionSpec::Access::Write   ? "write"
+                              : spec.access == ActionSpec::Access::Journal ? "journal"
+                              : spec.access == ActionSpec::Access::Memory  ? "memory" : "read";
+        obj["requires_admin"] = spec.requiresAdmin;
+        obj["hits"]           = static_cast<qint64>(m_actions.hits(i));
+        stats.append(obj);
     }
 
     return {
         {"status", "success"},
-        {"message", bookings.size() >= MAX_RETURN_ROWS
-                        ? "查询所有订单成功（结果已限制为最多1000条）"
-                        : "查询所有订单成功"},
-        {"data", bookings}
+        {"message", "查询成功"},
+        {"data", stats}
     };
 }
 
+// 把一个连接的统计转换为JSON（管理员接口使用）
+static QJsonObject connectionToJson(const ConnectionRegistry& registry, const ConnectionRegistry::Gauges& gauges)
+{
+    const ConnectionRegistry::Identity identity = registry.identity(gauges);
+
+    QJsonObject obj;
+    obj["connection_id"]       = static_cast<qint64>(gauges->id);
+    obj["tag"]                 = identity.tag;
+    obj["user_id"]             = identity.userId;
+    obj["peer"]                = gauges->peer;
+    obj["reactor"]             = gauges->reactorIndex;
+    obj["inbound_bytes"]       = gauges->inboundBytes.loadRelaxed();
+    obj["outbound_bytes"]      = gauges->outboundBytes.loadRelaxed();
+    obj["peak_outbound_bytes"] = gauges->peakOutboundBytes.loadRelaxed();
+    obj["read_paused"]         = gauges->readPaused.loadRelaxed() != 0;
+    obj["pause_count"]         = gauges->pauseCount.loadRelaxed();
+    obj["rate_limited"]        = gauges->rateLimited.loadRelaxed();
+    obj["bytes_in"]            = gauges->bytesIn.loadRelaxed();
+    obj["bytes_out"]           = gauges->bytesOut.loadRelaxed();
+    obj["requests"]            = gauges->requests.loadRelaxed();
+    obj["avg_latency_us"]      = gauges->averageLatencyUs();
+    obj["last_activity"]       = QDateTime::fromMSecsSinceEpoch(gauges->lastActivityMs.loadRelaxed()).toString(Qt::ISODate);
+    return obj;
+}
 
-// 管理员-获取所有航班列表
-QJsonObject TcpServer::handleAdminGetAllFlights()
+// 管理员-查看当前连接：可以按tag、对端地址或用户id查找（走注册表的索引），都不带时返回所有连接
+QJsonObject TcpServer::handleAdminGetConnections(const QJsonObject& data)
 {
-    constexpr int MAX_RETURN_ROWS = 1000;
+    QList<ConnectionRegistry::Gauges> list;
+    if (data.contains("tag")) {
+        if (ConnectionRegistry::Gauges gauges = m_connections.findByTag(data.value("tag").toString()))
+            list.append(gauges);
+    } else if (data.contains("peer")) {
+        list = m_connections.findByPeer(data.value("peer").toString());
+    } else if (data.contains("user_id")) {
+        list = m_connections.findByUser(data.value("user_id").toInt());
+    } else {
+        list = m_connections.all();
+    }
+
+    QJsonArray connections;
+    for (const ConnectionRegistry::Gauges& gauges : std::as_const(list))
+        connections.append(connectionToJson(m_connections, gauges));
 
-    QString sql = QString(R"(
-        SELECT flight_id, flight_number, model, origin, destination,
-               departure_time, arrival_time,
-               total_seats, remaining_seats, price, is_deleted
-        FROM Flight
-        ORDER BY departure_time ASC
-        LIMIT %1
-    )").arg(MAX_RETURN_ROWS);
+    return {
+        {"status", "success"},
+        {"message", "查询成功"},
+        {"data", connections}
+    };
+}
 
-    QSqlQuery query(DatabaseManager::instance().database());
+// 管理员-按负载查看前N个连接：data.sort_by 为 bytes（默认）/requests/latency/outbound，data.limit 默认10
+QJsonObject TcpServer::handleAdminGetTopConnections(const QJsonObject& data)
+{
+    static const QHash<QString, ConnectionRegistry::LoadMetric> metrics{
+        {"bytes",    ConnectionRegistry::LoadMetric::Bytes},
+        {"requests", ConnectionRegistry::LoadMetric::Requests},
+        {"latency",  ConnectionRegistry::LoadMetric::Latency},
+        {"outbound", ConnectionRegistry::LoadMetric::Outbound}
+    };
 
-    if (!query.exec(sql)) {
+    const QString sortBy = data.value("sort_by").toString("bytes");
+    if (!metrics.contains(sortBy)) {
         return {
             {"status", "error"},
-            {"message", "查询失败：" + query.lastError().text()},
+            {"message", "sort_by 只能是 bytes、requests、latency 或 outbound"},
             {"data", QJsonValue()}
         };
     }
 
-    QJsonArray arr;
+    int limit = data.value("limit").toInt(10);
+    if (limit <= 0 || limit > MAX_RETURN_ROWS)
+        limit = 10;
+
+    QJsonArray connections;
+    const QList<ConnectionRegistry::Gauges> top = m_connections.top(metrics.value(sortBy), limit);
+    for (const ConnectionRegistry::Gauges& gauges : top)
+        connections.append(connectionToJson(m_connections, gauges));
 
-    while (query.next()) {
+    return {
+        {"status", "success"},
+        {"message", "查询成功"},
+        {"data", connections}
+    };
+}
+
+// 管理员-查看线程池前面的排队情况（每个优先级一项）
+QJsonObject TcpServer::handleAdminGetQueueStats(const QJsonObject&)
+{
+    if (!m_workerPool) {
+        return {
+            {"status", "error"},
+            {"message", "未开启线程池，请求不经过排队"},
+            {"data", QJsonValue()}
+        };
+    }
+
+    static const char* const names[DispatchQueue::PriorityCount] = {"high", "normal", "low"};
+
+    QJsonArray lanes;
+    for (int i = 0; i < DispatchQueue::PriorityCount; ++i) {
+        const DispatchQueue::Stats stats = m_dispatchQueue.stats(static_cast<DispatchQueue::Priority>(i));
         QJsonObject obj;
-        obj["flight_id"]       = query.value("flight_id").toInt();
-        obj["flight_number"]   = query.value("flight_number").toString();
-        obj["model"]           = query.value("model").toString();
-        obj["origin"]          = query.value("origin").toString();
-        obj["destination"]     = query.value("destination").toString();
-        obj["departure_time"]  = query.value("departure_time").toString();
-        obj["arrival_time"]    = query.value("arrival_time").toString();
-        obj["total_seats"]     = query.value("total_seats").toInt();
-        obj["remaining_seats"] = query.value("remaining_seats").toInt();
-        obj["price"]           = query.value("price").toDouble();
-        obj["is_deleted"]      = query.value("is_deleted").toInt();
-        arr.append(obj);
+        obj["priority"]    = names[i];
+        obj["depth"]       = stats.depth;
+        obj["peak_depth"]  = stats.peakDepth;
+        obj["accepted"]    = stats.accepted;
+        obj["rejected"]    = stats.rejected;
+        obj["shed"]        = stats.shed;
+        obj["avg_wait_us"] = stats.avgWaitUs;
+        lanes.append(obj);
+    }
+
+    QJsonObject result;
+    result["lanes"]          = lanes;
+    result["capacity"]       = m_dispatchQueue.capacity();
+    result["max_wait_ms"]    = m_dispatchQueue.maxWaitMs();
+    result["avg_service_us"] = m_dispatchQueue.avgServiceUs();
+    result["threads"]        = m_workerPool->maxThreadCount();
+    result["active_threads"] = m_workerPool->activeThreadCount();
+
+    return {
+        {"status", "success"},
+        {"message", "查询成功"},
+        {"data", result}
+    };
+}
+
+// 把一个耗时直方图转换为JSON（微秒）
+static QJsonObject histogramToJson(const LatencyHistogram& histogram)
+{
+    const LatencyHistogram::Snapshot snapshot = histogram.snapshot();
+    QJsonObject obj;
+    obj["count"]   = static_cast<qint64>(snapshot.count);
+    obj["mean_us"] = static_cast<qint64>(snapshot.meanUs());
+    obj["p50_us"]  = static_cast<qint64>(snapshot.percentileUs(50));
+    obj["p90_us"]  = static_cast<qint64>(snapshot.percentileUs(90));
+    obj["p99_us"]  = static_cast<qint64>(snapshot.percentileUs(99));
+    obj["p999_us"] = static_cast<qint64>(snapshot.percentileUs(99.9));
+    obj["max_us"]  = static_cast<qint64>(snapshot.maxUs);
+    return obj;
+}
+
+static QJsonObject actionStatsToJson(const QString& name, const ServerStats::ActionStats& stats)
+{
+    QJsonObject obj;
+    obj["action"]    = name;
+    obj["requests"]  = static_cast<qint64>(stats.requests.loadRelaxed());
+    obj["errors"]    = static_cast<qint64>(stats.errors.loadRelaxed());
+    obj["bytes_in"]  = static_cast<qint64>(stats.bytesIn.loadRelaxed());
+    obj["bytes_out"] = static_cast<qint64>(stats.bytesOut.loadRelaxed());
+    for (int p = 0; p < ServerStats::PhaseCount; ++p) {
+        const ServerStats::Phase phase = static_cast<ServerStats::Phase>(p);
+        obj[ServerStats::phaseName(phase)] = histogramToJson(stats.phase(phase));
+    }
+    return obj;
+}
+
+// 管理员-查看各action的请求数、错误数、流量，以及解码/处理/编码/写出各阶段的耗时分布
+QJsonObject TcpServer::handleAdminGetServerStats(const QJsonObject& data)
+{
+    // 可选：只看某一个action
+    const QString filter = data.value("action").toString();
+
+    qint64 requests = 0, errors = 0, bytesIn = 0, bytesOut = 0;
+    QJsonArray actions;
+    auto append = [&](const QString& name, const ServerStats::ActionStats& stats) {
+        requests += stats.requests.loadRelaxed();
+        errors   += stats.errors.loadRelaxed();
+        bytesIn  += stats.bytesIn.loadRelaxed();
+        bytesOut += stats.bytesOut.loadRelaxed();
+        // 没有任何流量的action不列出
+        if (stats.requests.loadRelaxed() == 0 && stats.bytesIn.loadRelaxed() == 0)
+            return;
+        if (!filter.isEmpty() && filter != name)
+            return;
+        actions.append(actionStatsToJson(name, stats));
+    };
+
+    for (int i = 0; i < m_stats.actionCount(); ++i)
+        append(m_actions.at(i).name, m_stats.at(i));
+    // tag注册、余票推送、未知action等
+    append(QStringLiteral("(other)"), m_stats.other());
+
+    QJsonObject result;
+    result["uptime_ms"] = m_stats.uptimeMs();
+    result["requests"]  = requests;
+    result["errors"]    = errors;
+    result["bytes_in"]  = bytesIn;
+    result["bytes_out"] = bytesOut;
+    result["actions"]   = actions;
+    // 预编译语句缓存：misses即prepare的次数，预热后应当不再增长
+    result["statement_cache"] = QJsonObject{
+        {"hits",   static_cast<qint64>(DatabaseManager::instance().statementHits())},
+        {"misses", static_cast<qint64>(DatabaseManager::instance().statementMisses())}
+    };
+    // 写请求等待写租约的次数与累计时间，持续增长说明写操作在排队
+    result["write_lease"] = QJsonObject{
+        {"waits",   static_cast<qint64>(DatabaseManager::instance().writeLeaseWaits())},
+        {"wait_us", static_cast<qint64>(DatabaseManager::instance().writeLeaseWaitUs())}
+    };
+    // 订单日志：appended - applied 为还没写回数据库的记录数
+    result["booking_journal"] = QJsonObject{
+        {"appended", static_cast<qint64>(m_journal.appended())},
+        {"applied",  static_cast<qint64>(m_journal.applied())},
+        {"batches",  static_cast<qint64>(m_journal.batches())}
+    };
+    result["inventory_flights"] = m_inventory.flightCount();
+    // 组提交：requests/batches即平均每次提交（落盘）分摊到的写请求数
+    if (m_groupCommit) {
+        result["group_commit"] = QJsonObject{
+            {"batches",   static_cast<qint64>(m_groupCommit->batches())},
+            {"requests",  static_cast<qint64>(m_groupCommit->committedTasks())},
+            {"max_batch", m_groupCommit->largestBatch()}
+        };
     }
 
     return {
         {"status", "success"},
-        {"message", arr.size() >= MAX_RETURN_ROWS
-                        ? "查询成功（结果已限制为最多1000条）"
-                        : "查询成功"},
-        {"data", arr}
+        {"message", "查询成功"},
+        {"data", result}
     };
 }
 
+// 管理员-运行时修改日志级别（不访问数据库：不借租约，也不经过组提交的写线程）
+QJsonObject TcpServer::handleAdminSetLogLevel(const QJsonObject& data)
+{
+    LogLevel level;
+    if (!AsyncLogger::levelFromName(data.value("level").toString(), level)) {
+        return {
+            {"status", "error"},
+            {"message", "level 只能是 debug、info、warning、critical 或 off"},
+            {"data", QJsonValue()}
+        };
+    }
 
+    AsyncLogger::setLevel(level);
+    LOG_WARN() << "日志级别已修改为:" << AsyncLogger::levelName(level);
+
+    QJsonObject result;
+    result["level"]        = AsyncLogger::levelName(level);
+    result["dropped_logs"] = static_cast<qint64>(AsyncLogger::instance().dropped());
+
+    return {
+        {"status", "success"},
+        {"message", "修改成功"},
+        {"data", result}
+    };
+}
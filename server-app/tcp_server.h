@@ -1,5 +1,10 @@
 /*
 用来监视tcp请求
+TcpServer只负责accept，连接按轮询分给若干个ClientReactor（每个Reactor一个I/O线程），
+由Reactor负责收发与拆帧；如果通过setWorkerThreads()开启了线程池，
+业务请求会交给工作线程处理，处理结果再投递回所属Reactor发送给客户端；
+余票在内存库存（seat_inventory.h）中扣减，订票、退票追加到订单日志（booking_journal.h）后由后台写回数据库；
+线程池模式下还可以开启组提交（setGroupCommit()），写操作改为交给唯一的写线程按批提交（见group_commit.h）。
 */
 
 #ifndef TCPSERVER_H
@@ -13,10 +18,57 @@
 #include <QJsonArray>
 #include <QTimer>
 #include <QtEndian>
+#include <QThreadPool>
+#include <QThread>
+#include <QMutex>
+#include <QSet>
+#include <QSharedPointer>
 #include "database_manager.h"
+#include "action_registry.h"
+#include "connection_registry.h"
+#include "rate_limiter.h"
+#include "dispatch_queue.h"
+#include "server_stats.h"
+#include "request_tracer.h"
+#include "group_commit.h"
+#include "seat_inventory.h"
+#include "booking_journal.h"
+#include "client_reactor.h"
 
+// 列表接口每页最多返回的行数（请求中的page_size缺省或超出时使用该值）
 constexpr int MAX_RETURN_ROWS = 1000;
 
+// 每个连接最多订阅的航班数
+constexpr int MAX_SUBSCRIBED_FLIGHTS = 200;
+// 余票推送的合并周期（毫秒）：这段时间内同一航班的多次变化只推送一次最新值
+constexpr int SEAT_PUSH_INTERVAL_MS = 100;
+// 采样到的trace span写入文件的间隔（毫秒）
+constexpr int TRACE_FLUSH_INTERVAL_MS = 1000;
+
+// 每个连接的登录状态：由Reactor在登录成功后记录，处理请求时按值传给handleRequest
+struct SessionInfo {
+    int userId{0};
+    bool isAdmin{false};
+};
+
+// 监听socket：只负责accept，把描述符交给TcpServer分配到各个Reactor
+class ConnectionListener : public QTcpServer
+{
+    Q_OBJECT
+
+public:
+    using QTcpServer::QTcpServer;
+
+signals:
+    void connectionAccepted(qintptr socketDescriptor);
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override
+    {
+        emit connectionAccepted(socketDescriptor);
+    }
+};
+
 class TcpServer : public QObject
 {
     Q_OBJECT
@@ -24,29 +76,117 @@ class TcpServer : public QObject
 
 public:
     explicit TcpServer(QObject *parent = nullptr);
+    ~TcpServer();
     void startServer(quint16 port);
+    // 设置业务处理线程数，0 表示在事件循环线程中同步处理
+    void setWorkerThreads(int count);
+    // 设置I/O线程（Reactor）数，必须在startServer之前调用；1 表示所有连接都在主线程处理
+    void setReactorCount(int count);
+    // 设置单帧上限与发送缓冲水位线，必须在startServer之前调用
+    void setConnectionLimits(quint32 maxFrameSize, qint64 writeHighWatermark, qint64 writeLowWatermark);
+    // 设置压缩阈值：响应编码后不小于该字节数时压缩（仅对协商了压缩的连接），0 表示不压缩
+    void setCompressThreshold(int bytes) { m_compressThreshold = qMax(0, bytes); }
+    // 设置各种超时（毫秒）：tag注册期限、空闲回收、请求处理期限，0 表示不限制；必须在startServer之前调用
+    void setTimeouts(int handshakeMs, int idleMs, int requestMs);
+    // 设置每个客户端（tag/用户）各类请求的每秒预算，0 表示该类不限流；必须在startServer之前调用
+    void setRateLimits(int queryPerSec, int bookingPerSec, int accountPerSec);
+    // 设置线程池前面的排队上限（每个优先级）与排队期限（毫秒），0 表示不限制；仅线程池模式有效
+    void setQueueLimits(int capacity, int maxWaitMs);
+    // 选择Reactor使用的传输层实现，必须在startServer之前调用；当前平台不支持时退回qt
+    void setTransport(Transport::Kind kind);
+    // 开启请求追踪：每sampleEvery条请求采样一条，span定时追加到path（Chrome trace-event格式）；path为空时不追踪
+    void setTracing(const QString& path, int sampleEvery);
+    // 设置写操作的组提交：每批最多maxBatch条，凑批窗口windowMs毫秒，maxBatch为0表示不开启；仅线程池模式有效，必须在startServer之前调用
+    void setGroupCommit(int maxBatch, int windowMs);
+
+    // 以下接口供ClientReactor调用
+    QThreadPool* workerPool() const { return m_workerPool; }
+    // 所有连接的注册表（线程安全）：tag查重、按tag/地址/用户查找、管理员接口的统计
+    ConnectionRegistry& connections() { return m_connections; }
+    // action注册表（只读）：Reactor据此找到请求的限流类别
+    const ActionRegistry& actions() const { return m_actions; }
+    RateLimiter& rateLimiter() { return m_rateLimiter; }
+    // 开启线程池时，请求经过这个队列交给工作线程
+    DispatchQueue& dispatchQueue() { return m_dispatchQueue; }
+    // 按action统计的各阶段耗时与流量（线程安全），下标与actions()一致
+    ServerStats& stats() { return m_stats; }
+    // 请求的排队优先级：写操作 > 普通查询 > 管理员报表
+    DispatchQueue::Priority priorityOf(const QString& action) const;
+    // 会修改数据的action（按注册表中的读写类型）
+    bool isWriteAction(const QString& action) const;
+    // 开启组提交时，写请求交给这里而不是线程池；未开启时为空
+    GroupCommitWriter* groupCommit() const { return m_groupCommit; }
+
+    quint32 maxFrameSize() const { return m_maxFrameSize; }
+    qint64 writeHighWatermark() const { return m_writeHighWatermark; }
+    qint64 writeLowWatermark() const { return m_writeLowWatermark; }
+    int compressThreshold() const { return m_compressThreshold; }
+    int handshakeTimeoutMs() const { return m_handshakeTimeoutMs; }
+    int idleTimeoutMs() const { return m_idleTimeoutMs; }
+    int requestTimeoutMs() const { return m_requestTimeoutMs; }
+    Transport::Kind transportKind() const { return m_transportKind; }
 
 private slots:
-    void onNewConnection();
+    void onConnectionAccepted(qintptr socketDescriptor);
     // 当有新客户端连接时，就用这个函数
-    void onReadyRead();
-    // 客户端发来数据，调用这个
-    void onDisconnected();
-    // 客户端断开连接，调用这个
+    void flushSeatChanges();
+    // 定时把这段时间内余票有变化的航班查出来，推送给各个Reactor
 
 private:
-    QTcpServer *m_server;
+    friend class ClientReactor;
+
+    ConnectionListener *m_server;
+    QThreadPool *m_workerPool{nullptr}; // 为空时同步处理
+
+    int m_reactorCount{1};
+    QList<ClientReactor*> m_reactors;
+    QList<QThread*> m_reactorThreads;  // 只有多Reactor模式下才有
+    int m_nextReactor{0};              // 轮询分配连接
+
+    quint32 m_maxFrameSize{0};
+    qint64 m_writeHighWatermark{0};
+    qint64 m_writeLowWatermark{0};
+    int m_compressThreshold{0};
+    int m_handshakeTimeoutMs{5000};
+    int m_idleTimeoutMs{0};
+    int m_requestTimeoutMs{0};
+    Transport::Kind m_transportKind{Transport::Kind::Qt};
 
-    struct ClientInfo {
-        QString tag;
-        QByteArray recvBuf;   // 接收缓冲
-        quint32 expectedLen{0}; // 下一帧期望长度
-    };
+    ConnectionRegistry m_connections;  // 所有Reactor中的连接
+    RateLimiter m_rateLimiter;
+    DispatchQueue m_dispatchQueue;
+    ServerStats m_stats;
 
-    QHash<QTcpSocket*, ClientInfo> clients;
+    int m_groupCommitBatch{0};
+    int m_groupCommitWindowMs{0};
+    GroupCommitWriter *m_groupCommit{nullptr};
 
-    // 这是功能分发函数，看其中的action内容来决定调用哪个具体函数
-    QJsonObject handleRequest(const QJsonObject& request);
+    QMutex m_seatMutex;
+    QSet<int> m_dirtyFlights;          // 余票有变化、等待推送的航班
+    QSet<int> m_batchDirtyFlights;     // 只由写线程访问：当前批次中余票有变化的航班，提交成功后才并入m_dirtyFlights
+    QList<std::function<void()>> m_batchAfterCommit; // 只由写线程访问：当前批次提交成功后要执行的操作
+    QTimer *m_seatTimer;
+    QTimer *m_traceTimer;              // 定时把采样到的span写进trace文件
+
+    // 记录某个航班的余票发生了变化（线程安全），由写操作的handle函数在提交成功后调用；
+    // 在组提交的批次中先记在批次里，等整批提交之后再推送
+    // 这里只记下航班id，推送时再从内存库存读取最新值，避免并发修改时旧值覆盖新值
+    void markSeatsChanged(int flightId);
+    // 数据库修改提交之后才执行action（修改内存库存等）：在组提交的批次中等整批提交成功，否则立即执行
+    void runAfterCommit(std::function<void()> action);
+    // 航班的余票：优先取内存库存，库存里没有时用数据库中的值stored
+    int remainingSeatsOf(int flightId, int stored) const;
+
+    SeatInventory m_inventory;         // 每个航班的余票（线程安全），订票、退票、查询余票都以它为准
+    BookingJournal m_journal;          // 订票、退票的日志，后台按顺序写回数据库
+
+    ActionRegistry m_actions;          // 构造时登记，之后只读
+    void registerActions();
+
+    // 这是功能分发函数，在注册表中查找action并调用对应的handle函数
+    // 注意：handle系列函数会在Reactor线程或工作线程中并发执行，不要在里面访问非线程安全的成员
+    QJsonObject handleRequest(const QJsonObject& request, const SessionInfo& session);
+    QJsonObject routeAction(const QString& action, const QJsonObject& data, const SessionInfo& session);
     // 以下为具体功能处理函数
     // 通用函数
     QJsonObject handleRegister(const QJsonObject& data);
@@ -57,18 +197,22 @@ private:
     QJsonObject handleBookFlight(const QJsonObject& data);
     QJsonObject handleGetMyOrders(const QJsonObject& data);
     QJsonObject handleCancelOrder(const QJsonObject& data);
+    QJsonObject handleSubscribeFlights(const QJsonObject& data);
     // 管理员端
     QJsonObject handleAdminAddFlight(const QJsonObject& data);
     QJsonObject handleAdminUpdateFlight(const QJsonObject& data);
     QJsonObject handleAdminDeleteFlight(const QJsonObject& data);
-    QJsonObject handleAdminGetAllFlights();
-    QJsonObject handleAdminGetAllUsers();
-    QJsonObject handleAdminGetAllBookings();
-
-    // 注意，每一个action或者说每一个具体功能都需要一个handle函数！！！！
+    QJsonObject handleAdminGetAllFlights(const QJsonObject& data);
+    QJsonObject handleAdminGetAllUsers(const QJsonObject& data);
+    QJsonObject handleAdminGetAllBookings(const QJsonObject& data);
+    QJsonObject handleAdminGetActionStats(const QJsonObject& data);
+    QJsonObject handleAdminGetConnections(const QJsonObject& data);
+    QJsonObject handleAdminGetTopConnections(const QJsonObject& data);
+    QJsonObject handleAdminGetQueueStats(const QJsonObject& data);
+    QJsonObject handleAdminGetServerStats(const QJsonObject& data);
+    QJsonObject handleAdminSetLogLevel(const QJsonObject& data);
 
-    // 辅助函数，将JSON响应发回客户端
-    void sendJsonResponse(QTcpSocket* socket, const QJsonObject& response);
+    // 注意，每一个action或者说每一个具体功能都需要一个handle函数，并在registerActions()中登记！！！！
 };
 
 #endif // TCPSERVER_H
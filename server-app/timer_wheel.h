@@ -0,0 +1,157 @@
+/*
+该文件实现哈希时间轮（Hashed Timer Wheel），用于连接的各种超时（tag注册期限、空闲回收、请求处理期限）
+时间被切成固定长度的tick，轮子上有slotCount个槽，每个定时器挂在“到期tick % slotCount”对应的槽里，
+超过一圈的定时器记录还要转几圈（rounds）。外部每个tick调用一次advance()，只检查当前槽里的定时器。
+arm()/cancel()都是O(1)：定时器存放在数组里，用下标串成每个槽的双向链表，取消时直接摘链。
+TimerId里带有代数（generation），定时器触发或取消后旧的TimerId自动失效，重复cancel是安全的。
+不是线程安全的：每个ClientReactor在自己的线程里持有一个时间轮。
+*/
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <QtGlobal>
+#include <QVarLengthArray>
+#include <vector>
+
+template <typename T>
+class TimerWheel
+{
+public:
+    using TimerId = quint64;
+    static constexpr TimerId InvalidTimer = 0;
+
+    TimerWheel(int slotCount, int tickMs)
+        : m_slots(static_cast<size_t>(qMax(1, slotCount)), -1), m_tickMs(qMax(1, tickMs)) {}
+
+    int tickMs() const { return m_tickMs; }
+    // 当前挂在轮子上的定时器个数
+    int size() const { return m_active; }
+
+    // 在delayMs毫秒后（向上取整到tick）触发，返回可用于cancel的id
+    TimerId arm(qint64 delayMs, const T &payload)
+    {
+        const qint64 slotCount = static_cast<qint64>(m_slots.size());
+        const qint64 ticks = qMax<qint64>(1, (delayMs + m_tickMs - 1) / m_tickMs);
+
+        const int index = allocate();
+        Entry &entry = m_entries[index];
+        entry.payload = payload;
+        entry.rounds = (ticks - 1) / slotCount;
+        entry.slot = static_cast<int>((m_cursor + ticks) % slotCount);
+        link(index);
+        ++m_active;
+        return (static_cast<TimerId>(entry.generation) << 32) | static_cast<quint32>(index + 1);
+    }
+
+    // 取消定时器；已经触发、已经取消或无效的id返回false
+    bool cancel(TimerId id)
+    {
+        if (id == InvalidTimer)
+            return false;
+
+        const int index = static_cast<int>(id & 0xFFFFFFFFu) - 1;
+        const quint32 generation = static_cast<quint32>(id >> 32);
+        if (index < 0 || index >= static_cast<int>(m_entries.size()))
+            return false;
+
+        Entry &entry = m_entries[index];
+        if (!entry.active || entry.generation != generation)
+            return false;
+
+        unlink(index);
+        release(index);
+        return true;
+    }
+
+    // 前进一个tick，对所有到期的定时器调用onExpire(payload)
+    // 到期的定时器先全部摘下再回调，回调里可以放心地arm/cancel
+    template <typename F>
+    void advance(F &&onExpire)
+    {
+        m_cursor = (m_cursor + 1) % static_cast<int>(m_slots.size());
+
+        QVarLengthArray<T, 32> expired;
+        int index = m_slots[m_cursor];
+        while (index != -1) {
+            Entry &entry = m_entries[index];
+            const int next = entry.next;
+            if (entry.rounds > 0) {
+                --entry.rounds;
+            } else {
+                expired.append(entry.payload);
+                unlink(index);
+                release(index);
+            }
+            index = next;
+        }
+
+        for (const T &payload : expired)
+            onExpire(payload);
+    }
+
+private:
+    struct Entry {
+        T payload{};
+        int prev{-1};
+        int next{-1};
+        int slot{-1};
+        qint64 rounds{0};
+        quint32 generation{1};
+        bool active{false};
+    };
+
+    std::vector<Entry> m_entries;
+    std::vector<int> m_free;     // 空闲的Entry下标
+    std::vector<int> m_slots;    // 每个槽链表的头结点下标，-1表示空
+    int m_cursor{0};
+    int m_tickMs;
+    int m_active{0};
+
+    int allocate()
+    {
+        int index;
+        if (!m_free.empty()) {
+            index = m_free.back();
+            m_free.pop_back();
+        } else {
+            index = static_cast<int>(m_entries.size());
+            m_entries.emplace_back();
+        }
+        m_entries[index].active = true;
+        return index;
+    }
+
+    void release(int index)
+    {
+        Entry &entry = m_entries[index];
+        entry.active = false;
+        entry.payload = T{};
+        ++entry.generation; // 让旧的TimerId失效
+        m_free.push_back(index);
+        --m_active;
+    }
+
+    void link(int index)
+    {
+        Entry &entry = m_entries[index];
+        entry.prev = -1;
+        entry.next = m_slots[entry.slot];
+        if (entry.next != -1)
+            m_entries[entry.next].prev = index;
+        m_slots[entry.slot] = index;
+    }
+
+    void unlink(int index)
+    {
+        Entry &entry = m_entries[index];
+        if (entry.prev != -1)
+            m_entries[entry.prev].next = entry.next;
+        else
+            m_slots[entry.slot] = entry.next;
+        if (entry.next != -1)
+            m_entries[entry.next].prev = entry.prev;
+        entry.prev = entry.next = -1;
+    }
+};
+
+#endif // TIMER_WHEEL_H
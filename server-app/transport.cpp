@@ -0,0 +1,31 @@
+#include "transport.h"
+#include "qt_transport.h"
+#include "epoll_transport.h"
+#include "async_logger.h"
+
+bool Transport::isSupported(Kind kind)
+{
+#ifdef Q_OS_LINUX
+    Q_UNUSED(kind);
+    return true;
+#else
+    return kind == Kind::Qt;
+#endif
+}
+
+Transport* Transport::create(Kind kind, ConnectionHandler* handler, QObject* parent)
+{
+#ifdef Q_OS_LINUX
+    if (kind == Kind::Epoll) {
+        EpollTransport* transport = new EpollTransport(handler, parent);
+        if (transport->isValid())
+            return transport;
+        delete transport;
+        LOG_WARN() << "无法创建epoll传输层，改用qt";
+    }
+#else
+    if (kind == Kind::Epoll)
+        LOG_WARN() << "当前平台不支持epoll传输层，改用qt";
+#endif
+    return new QtTransport(handler, parent);
+}
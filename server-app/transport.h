@@ -0,0 +1,91 @@
+/*
+该文件定义Reactor使用的传输层接口
+ClientReactor不直接使用QTcpSocket，而是通过Transport接管accept得到的描述符，得到Connection，
+再通过Connection读写数据；连接上的事件（可读、写出了数据、断开）直接回调ConnectionHandler，不经过信号槽。
+目前有两种实现，启动时用 --transport 选择，方便用同一个压测程序对比：
+  qt    ：QTcpSocket（默认，所有平台可用）
+  epoll ：Linux原生epoll（每个Reactor一个epoll实例，挂在Reactor事件循环的一个QSocketNotifier上）
+业务处理、JSON/CBOR编解码都在Reactor之上，不受传输层影响。
+Transport和Connection只能在所属Reactor的线程中使用。
+*/
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QHostAddress>
+#include <QString>
+
+class Connection;
+
+// 连接事件的接收方（ClientReactor）
+class ConnectionHandler
+{
+public:
+    virtual ~ConnectionHandler() = default;
+    // 有新数据可读（暂停读取期间不会回调）
+    virtual void onConnectionReadable(Connection* connection) = 0;
+    // 之前交给write()的数据有一部分写进了内核，可以检查是否恢复读取
+    virtual void onConnectionWritten(Connection* connection) = 0;
+    // 对端断开、出错，或close()完成；之后不会再有任何回调，接收方负责deleteLater()
+    virtual void onConnectionClosed(Connection* connection) = 0;
+};
+
+// 一个客户端连接
+// 继承QObject只是为了能用QPointer判断连接是否还在、用deleteLater()延迟释放，连接本身不发信号
+class Connection : public QObject
+{
+public:
+    using QObject::QObject;
+
+    // 读出当前能读到的所有数据
+    virtual QByteArray readAll() = 0;
+    // 已经在用户态缓冲、还没被readAll()取走的字节数
+    virtual qint64 bytesAvailable() const = 0;
+    // 写出数据：写不完的部分由连接自己缓冲，之后自动写出
+    virtual void write(const QByteArray& data) = 0;
+    // 还没写进内核的字节数
+    virtual qint64 bytesToWrite() const = 0;
+    // 暂停/恢复读取：暂停期间数据留在内核缓冲里，由TCP流控限制对端继续发送
+    virtual void setReadPaused(bool paused) = 0;
+    virtual QHostAddress peerAddress() const = 0;
+    // 写完缓冲中的数据后关闭连接，关闭后回调onConnectionClosed
+    virtual void close() = 0;
+};
+
+class Transport : public QObject
+{
+public:
+    enum class Kind {
+        Qt,
+        Epoll
+    };
+
+    using QObject::QObject;
+
+    // 接管一个已经accept的描述符，失败时返回nullptr（描述符会被关闭）
+    virtual Connection* adopt(qintptr socketDescriptor) = 0;
+
+    static QString kindName(Kind kind) { return kind == Kind::Epoll ? QStringLiteral("epoll") : QStringLiteral("qt"); }
+
+    static bool kindFromName(const QString& name, Kind& kind)
+    {
+        if (name == QLatin1String("qt")) {
+            kind = Kind::Qt;
+            return true;
+        }
+        if (name == QLatin1String("epoll")) {
+            kind = Kind::Epoll;
+            return true;
+        }
+        return false;
+    }
+
+    // 当前平台是否支持该实现
+    static bool isSupported(Kind kind);
+
+    // 在当前线程中创建传输层，parent一般是所属的ClientReactor；不支持的实现退回qt
+    static Transport* create(Kind kind, ConnectionHandler* handler, QObject* parent);
+};
+
+#endif // TRANSPORT_H